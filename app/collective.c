@@ -13,20 +13,9 @@ timeval_diff(struct timeval *tv0, struct timeval *tv1){
   return (tv1->tv_sec - tv0->tv_sec) + (tv1->tv_usec - tv0->tv_usec) * 1e-6;
 }
 
-static void
-wait_messages(dlfree_comm_node_t comm_node, int count){
-  int src_id;
-  void* buff;
-  int buffsize;
-
-  for(; count > 0; --count){
-    dlfree_comm_node_recv_any_data(comm_node, &src_id, &buff, &buffsize);
-    free(buff);
-  }
-}
-
 /**
-   This is for reduction. All nodes send the a message to a single node.
+   This is reduction. All nodes send a message to a single node, which
+   sums them up as vectors of doubles.
    This is a collective operation for all GXP nodes.
 
    \param man       GXP instance
@@ -49,22 +38,17 @@ send_all2one(gxp_man_t man, dlfree_comm_node_t comm_node, int dst_idx, long len,
     printf("send_all2one: %ld [B] from dst_idx: %d\n", len, dst_idx);fflush(stdout);
   }
 
+  /* zeros, so that the sums stay finite over the iterations */
   buff = calloc(len, sizeof(char));
-  sprintf(buff, "%d:%s says hello!", myidx, gxp_man_hostname(man));
 
   for(it = 0; it < iter; it++){
-    gxp_man_sync(man);
+    dlfree_coll_barrier(comm_node, DLFREE_GROUP_ALL);
     assert(gettimeofday(&tv0, NULL) == 0);
 
-    // everyone except 1 node sends to 1 node
-    if(myidx != dst_idx){
-      dlfree_comm_node_send_data(comm_node, dst_idx, buff, len);
-    }
-    else{
-      wait_messages(comm_node, numpeers - 1);
-    }
+    // everyone's vector is reduced to 1 node
+    dlfree_coll_reduce(comm_node, DLFREE_GROUP_ALL, dst_idx, buff, len / sizeof(double), sizeof(double), dlfree_op_sum_double);
     
-    gxp_man_sync(man);
+    dlfree_coll_barrier(comm_node, DLFREE_GROUP_ALL);
     assert(gettimeofday(&tv2, NULL) == 0);
     dt = timeval_diff(&tv0, &tv2);
 
@@ -81,6 +65,7 @@ send_all2one(gxp_man_t man, dlfree_comm_node_t comm_node, int dst_idx, long len,
 /**
    This is broadcast. One node sends a message to all other nodes.
    This is a collective operation for all GXP nodes.
+   The message is multicast along the routes, once per link.
    
    \param man       GXP instance
    \param comm_node node instance
@@ -91,7 +76,7 @@ send_all2one(gxp_man_t man, dlfree_comm_node_t comm_node, int dst_idx, long len,
 void
 send_one2all(gxp_man_t man, dlfree_comm_node_t comm_node, int src_idx, long len, int iter){
   void *buff;
-  int it, idx;
+  int it;
   struct timeval tv0, tv2;
   double dt;
 
@@ -106,23 +91,13 @@ send_one2all(gxp_man_t man, dlfree_comm_node_t comm_node, int src_idx, long len,
   sprintf(buff, "%d:%s says hello!", myidx, gxp_man_hostname(man));
 
   for(it = 0; it < iter; it++){
-    gxp_man_sync(man);
+    dlfree_coll_barrier(comm_node, DLFREE_GROUP_ALL);
     assert(gettimeofday(&tv0, NULL) == 0);
 
     // only 1 node sends to all
-    if(myidx == src_idx){
-      for(idx = 0; idx < numpeers; idx++){
-	if(idx == myidx)
-	  continue;
-	
-	dlfree_comm_node_send_data(comm_node, idx, buff, len);
-      }
-    }
-    else{
-      wait_messages(comm_node, 1);
-    }
+    dlfree_coll_bcast(comm_node, DLFREE_GROUP_ALL, src_idx, buff, len);
     
-    gxp_man_sync(man);
+    dlfree_coll_barrier(comm_node, DLFREE_GROUP_ALL);
     assert(gettimeofday(&tv2, NULL) == 0);
     dt = timeval_diff(&tv0, &tv2);
 
@@ -139,6 +114,7 @@ send_one2all(gxp_man_t man, dlfree_comm_node_t comm_node, int src_idx, long len,
 /**
    This is for all-to-all broadcast. All nodes send the a message to all other nodes.
    This is a collective operation for all GXP nodes.
+   Messages go in the phases of a schedule that keeps them off each other's links.
 
    \param man       GXP instance
    \param comm_node node instance
@@ -147,11 +123,10 @@ send_one2all(gxp_man_t man, dlfree_comm_node_t comm_node, int src_idx, long len,
 */
 void
 send_all2all(gxp_man_t man, dlfree_comm_node_t comm_node, long len, int iter){
-  void *buff;
-  int i, it, idx;
+  void *sendbuff, *recvbuff;
+  int i, it;
   struct timeval tv0, tv2;
   double dt;
-  int *ord;
 
   int myidx = gxp_man_peer_id(man);
   int numpeers = gxp_man_num_peers(man);
@@ -160,28 +135,18 @@ send_all2all(gxp_man_t man, dlfree_comm_node_t comm_node, long len, int iter){
     printf("send_all2all: %ld [B]\n", len);fflush(stdout);
   }
 
-  buff = calloc(len, sizeof(char));
-  sprintf(buff, "%d:%s says hello!", myidx, gxp_man_hostname(man));
-
-  ord = (int*)malloc(sizeof(int) * numpeers);
+  sendbuff = calloc(len * numpeers, sizeof(char));
+  recvbuff = malloc(len * numpeers);
   for(i = 0; i < numpeers; i++){
-    ord[i] = (i + myidx) % numpeers;
+    snprintf((char*)sendbuff + len * i, len, "%d:%s says hello!", myidx, gxp_man_hostname(man));
   }
 
   for(it = 0; it < iter; it++){
-    gxp_man_sync(man);
+    dlfree_coll_barrier(comm_node, DLFREE_GROUP_ALL);
     assert(gettimeofday(&tv0, NULL) == 0);
-    for(i = 0; i < numpeers; i++){
-      idx = ord[i];
-      if(idx == myidx)
-	continue;
-      
-      dlfree_comm_node_send_data(comm_node, idx, buff, len);
-    }
+    dlfree_coll_alltoall(comm_node, DLFREE_GROUP_ALL, sendbuff, recvbuff, len);
     
-    wait_messages(comm_node, numpeers - 1);
-    
-    gxp_man_sync(man);
+    dlfree_coll_barrier(comm_node, DLFREE_GROUP_ALL);
     assert(gettimeofday(&tv2, NULL) == 0);
     dt = timeval_diff(&tv0, &tv2);
 
@@ -192,6 +157,6 @@ send_all2all(gxp_man_t man, dlfree_comm_node_t comm_node, long len, int iter){
     }
   }
 
-  free(buff);
-  free(ord);
+  free(sendbuff);
+  free(recvbuff);
 }
@@ -10,12 +10,12 @@
 static void
 myabort(char** argv, const char *msg){
   fprintf(stderr, "%s\n", msg);
-  fprintf(stderr, "usage: %s <xml> <density/alpha/ngates> <size[MB]> <rt-type> [<iter:10> [<seed:1>]]\n", argv[0]);
+  fprintf(stderr, "usage: %s <xml> <density/alpha/ngates> <size[MB]> <rt-type> [<iter:10> [<seed:1> [<streams:1>]]]\n", argv[0]);
   exit(1);
 }
 
 static void
-parseopt(int argc, char** argv, char *filename, float *overlay_param, float *size, int *rttype, int *iter, int *seed){
+parseopt(int argc, char** argv, char *filename, float *overlay_param, float *size, int *rttype, int *iter, int *seed, int *streams){
   if(argc < 5)
     myabort(argv, "too few arguments");
   if(sscanf(argv[1], "%s", filename) != 1)
@@ -57,6 +57,12 @@ parseopt(int argc, char** argv, char *filename, float *overlay_param, float *siz
   }else{
     *seed = 1;
   }
+  if(argc > 7){
+    if(sscanf(argv[7], "%d", streams) != 1 || *streams < 1)
+      myabort(argv, "invalid streams value");
+  }else{
+    *streams = 1;
+  }
 }
 
 int
@@ -65,10 +71,10 @@ main(int argc, char** argv){
   dlfree_comm_node_t comm_node;
   char filename[100];
 
-  int iter, rttype, seed;
+  int iter, rttype, seed, streams;
   float topology_param, size;
 
-  parseopt(argc, argv, filename, &topology_param, &size, &rttype, &iter, &seed);
+  parseopt(argc, argv, filename, &topology_param, &size, &rttype, &iter, &seed, &streams);
 
   gxp = gxp_man_create();
   comm_node = dlfree_comm_node_create(gxp_man_peer_id(gxp));
@@ -100,6 +106,13 @@ main(int argc, char** argv){
 #error specify connection scheme
 #endif
 
+  /* size socket buffers from link bandwidth */
+  gxp_man_set_link_widths(gxp, comm_node, filename);
+
+  /* open parallel streams on links with a large bandwidth-delay product */
+  if(streams > 1)
+    gxp_man_connect_streams(gxp, comm_node, filename, streams);
+
   /* compute dlfree routing table */
   
   gxp_man_compute_rt(gxp, comm_node, filename, rttype, seed);
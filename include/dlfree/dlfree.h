@@ -3,13 +3,60 @@
 
 typedef void* dlfree_comm_node_t;
 
+/* combine count elements of in into inout, element by element */
+typedef void (*dlfree_op_t)(void* inout, const void* in, int count);
+
+#define DLFREE_IO_SELECT (0)
+#define DLFREE_IO_URING  (1)
+
+#define DLFREE_CHUNK_FIXED    (0)
+#define DLFREE_CHUNK_WIDTH    (1)
+#define DLFREE_CHUNK_ADAPTIVE (2)
+
+#define DLFREE_PRIO_LOW    (0)
+#define DLFREE_PRIO_NORMAL (1)
+#define DLFREE_PRIO_HIGH   (2)
+
+#define DLFREE_GROUP_ALL (0)
+
 dlfree_comm_node_t dlfree_comm_node_create(int node_id);
+dlfree_comm_node_t dlfree_comm_node_create_with_io(int node_id, int io_backend);
 void dlfree_comm_node_destroy(dlfree_comm_node_t node);
+void dlfree_comm_node_set_zerocopy(dlfree_comm_node_t node, int on);
+void dlfree_comm_node_set_aggregation(dlfree_comm_node_t node, int on);
+void dlfree_comm_node_flush(dlfree_comm_node_t node);
+void dlfree_comm_node_set_chunk_policy(dlfree_comm_node_t node, int policy);
 int dlfree_comm_node_listen_port(dlfree_comm_node_t node);
 unsigned long dlfree_comm_node_async_connect(dlfree_comm_node_t node, const char* addr, int port);
+unsigned long dlfree_comm_node_async_connect_stream(dlfree_comm_node_t node, int dst_id, const char* addr, int port);
+unsigned long dlfree_comm_node_async_connect_lane(dlfree_comm_node_t node, int dst_id, int lane, const char* addr, int port);
 int dlfree_comm_node_connect_wait(dlfree_comm_node_t node, unsigned long handle, int* dst_id);
+int dlfree_comm_node_join(dlfree_comm_node_t node);
+void dlfree_comm_node_leave(dlfree_comm_node_t node);
 double dlfree_comm_node_peer_rtt(dlfree_comm_node_t node, int dst_id);
 void dlfree_comm_node_send_data(dlfree_comm_node_t node, int dst_id, const void *buff, int buffsize);
+void dlfree_comm_node_send_data_prio(dlfree_comm_node_t node, int dst_id, const void *buff, int buffsize, int prio);
+int dlfree_comm_node_group_create(dlfree_comm_node_t node, const int* members, int n);
+void dlfree_comm_node_mcast_data(dlfree_comm_node_t node, int gid, const void *buff, int buffsize);
+extern const dlfree_op_t dlfree_op_sum_int;
+extern const dlfree_op_t dlfree_op_sum_long;
+extern const dlfree_op_t dlfree_op_sum_float;
+extern const dlfree_op_t dlfree_op_sum_double;
+extern const dlfree_op_t dlfree_op_max_double;
+extern const dlfree_op_t dlfree_op_min_double;
+
+void dlfree_coll_barrier(dlfree_comm_node_t node, int gid);
+void dlfree_coll_bcast(dlfree_comm_node_t node, int gid, int root_id, void* buff, int buffsize);
+void dlfree_coll_reduce(dlfree_comm_node_t node, int gid, int root_id, void* buff, int count, int elem_size, dlfree_op_t op);
+void dlfree_coll_allreduce(dlfree_comm_node_t node, int gid, void* buff, int count, int elem_size, dlfree_op_t op);
+void dlfree_coll_reduce_scatter(dlfree_comm_node_t node, int gid, void* buff, int count, int elem_size, dlfree_op_t op);
+void dlfree_coll_block(dlfree_comm_node_t node, int gid, int member_id, int count, int* off, int* n);
+void dlfree_coll_allgather(dlfree_comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int buffsize);
+void dlfree_coll_alltoall(dlfree_comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int buffsize);
+int dlfree_coll_hier_create(dlfree_comm_node_t node, int gid, const int* clusters, int nclusters, const int* leaders);
+void dlfree_coll_hier_bcast(dlfree_comm_node_t node, int gid, int root_id, void* buff, int buffsize);
+void dlfree_coll_hier_allreduce(dlfree_comm_node_t node, int gid, void* buff, int count, int elem_size, dlfree_op_t op);
+void dlfree_coll_hier_alltoall(dlfree_comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int buffsize);
 void dlfree_comm_node_recv_data(dlfree_comm_node_t node, int src_id, void **buff, int* buffsize);
 void dlfree_comm_node_recv_any_data(dlfree_comm_node_t node, int* src_id, void **buff, int* buffsize);
 
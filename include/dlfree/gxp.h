@@ -35,8 +35,15 @@ const int** gxp_man_connect_ring(gxp_man_t man, dlfree_comm_node_t comm);
 const int** gxp_man_connect_line(gxp_man_t man, dlfree_comm_node_t comm);
 const int** gxp_man_connect_with_gateway(gxp_man_t man, dlfree_comm_node_t comm, int prefix, int ngates, float p, int seed);
 const int** gxp_man_connect_locality_aware(gxp_man_t man, dlfree_comm_node_t comm, const char* filename, int alpha, int seed);
+void gxp_man_set_link_widths(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filename);
+void gxp_man_connect_streams(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filename, int max_streams);
+void gxp_man_connect_lanes(gxp_man_t man, dlfree_comm_node_t comm, int nlanes);
 
+void gxp_man_set_multipath(gxp_man_t man, int npaths);
 void gxp_man_compute_rt(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filename, int rttype, int seed);
+void gxp_man_hier_create(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filename);
+void gxp_man_measure_pairs(gxp_man_t man, const char* matrix_filename, long probe_len, int iter);
+void gxp_man_infer_topology(gxp_man_t man, const char* xml_filename, long probe_len, int iter);
   
 void gxp_man_ping_pong(gxp_man_t man, dlfree_comm_node_t comm, long len, int iter);
 
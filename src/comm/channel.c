@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <string.h>
+#include <stdlib.h>
 
 #include <std/std.h>
 #include <std/list.h>
@@ -11,6 +12,51 @@
 LIST_MAKE_TYPE_IMPLEMENTATION(channel);
 HASHMAP_MAKE_TYPE_IMPLEMENTATION(channel);
 
+/* data chunks are scheduled per flow, anything else is a control message */
+static int
+channel_is_data(msg_info_t minfo){
+  return minfo -> kind == MSG_TYPE_DATA || minfo -> kind == MSG_TYPE_AGGR || minfo -> kind == MSG_TYPE_MCAST;
+}
+
+/* send queue, with its bytes counted against the channel and node budgets, */
+/* and towards the bytes queued to the peer */
+static void
+channel_queue_push(channel_t chan, msg_buff_t buff, msg_info_t minfo){
+  if(channel_is_data(minfo))
+    sendq_push(chan -> sendq, buff, sendq_flow_key(minfo -> src_id, minfo -> dst_id, minfo -> prio), minfo -> prio);
+  else
+    sendq_push_control(chan -> sendq, buff);
+  if(chan -> budget != NULL)
+    __sync_fetch_and_add(&chan -> budget -> queued, msg_buff_len(buff));
+  if(chan -> link_queued != NULL)
+    __sync_fetch_and_add(chan -> link_queued, msg_buff_len(buff));
+}
+
+static msg_buff_t
+channel_queue_pop(channel_t chan){
+  msg_buff_t buff = sendq_pop(chan -> sendq);
+  if(chan -> budget != NULL)
+    __sync_fetch_and_sub(&chan -> budget -> queued, msg_buff_len(buff));
+  if(chan -> link_queued != NULL)
+    __sync_fetch_and_sub(chan -> link_queued, msg_buff_len(buff));
+  return buff;
+}
+
+/* whether a chunk of len bytes may be queued. */
+/* an empty queue always takes one, so like with a chunk-count limit, */
+/* every blocked chunk proceeds once the queue it waits on drains, */
+/* and each channel may go over the budgets by at most one chunk */
+static int
+channel_queue_admits(channel_t chan, int len){
+  if(sendq_size(chan -> sendq) == 0)
+    return 1;
+  if(sendq_bytes(chan -> sendq) + len > CHANNEL_QUEUE_BUDGET)
+    return 0;
+  if(chan -> budget != NULL && chan -> budget -> queued + len > chan -> budget -> cap)
+    return 0;
+  return 1;
+}
+
 static channel_t
 base_channel_create(sock_t sk){
   channel_t chan = std_malloc(sizeof(channel));
@@ -18,18 +64,38 @@ base_channel_create(sock_t sk){
   chan -> sk = sk;
   chan -> peer_id = CHANNEL_PEER_UNKNOWN;
   chan -> connect_state = CHANNEL_CONNECT_ESTABLISHED;
-  //memset(chan -> peer_hostname, 0, strlen(chan -> peer_hostname));
+  chan -> peer_hostname[0] = '\0';
 
   chan -> header_buff = std_malloc(CHANNEL_MSG_HEADERLEN);
   chan -> header_off = 0;
   chan -> msg_info = msg_info_create();
-  chan -> buff_queue = msg_buff_list_create();
+  chan -> sendq = sendq_create();
+  chan -> budget = NULL;
+  chan -> link_queued = NULL;
+  chan -> zc_pending = msg_buff_list_create();
   chan -> curr_buff = NULL;
 
   chan -> state = CHANNEL_INIT;
   chan -> next = NULL;
   chan -> prev = NULL;
   chan -> wait_queue = channel_list_create();
+  chan -> fanout = NULL;
+  chan -> nfanout = 0;
+  chan -> fanout_cap = 0;
+
+  chan -> stream_dst = CHANNEL_PEER_UNKNOWN;
+  chan -> stream_head = NULL;
+  chan -> streams = NULL;
+  chan -> nstreams = 0;
+  chan -> stream_rr = 0;
+
+  chan -> lane = 0;
+  chan -> lane_head = NULL;
+  memset(chan -> lanes, 0, sizeof(chan -> lanes));
+
+  chan -> sock_buff = 0;
+
+  chan -> shm_switch = NULL;
 
   chan -> rx_count = 0;
   chan -> tx_count = 0;
@@ -82,10 +148,17 @@ channel_print(channel_t chan){
 
 void
 channel_destroy(channel_t chan){
+  /* no I/O may still be in flight on the buffers freed below */
+  if(chan -> sk -> uring != NULL)
+    sock_uring_cancel(chan -> sk);
+
   /* destroy all pending messages */
-  while(msg_buff_list_size(chan -> buff_queue))
-    msg_buff_destroy(msg_buff_list_popleft(chan -> buff_queue));
-  msg_buff_list_destroy(chan -> buff_queue);
+  while(sendq_size(chan -> sendq))
+    msg_buff_destroy(channel_queue_pop(chan));
+  sendq_destroy(chan -> sendq);
+  while(msg_buff_list_size(chan -> zc_pending))
+    msg_buff_destroy(msg_buff_list_popleft(chan -> zc_pending));
+  msg_buff_list_destroy(chan -> zc_pending);
 
   std_free(chan -> header_buff);
   msg_info_destroy(chan -> msg_info);
@@ -94,6 +167,11 @@ channel_destroy(channel_t chan){
     msg_buff_destroy(chan -> curr_buff);
 
   channel_list_destroy(chan -> wait_queue);
+  if(chan -> fanout != NULL)
+    std_free(chan -> fanout);
+
+  if(chan -> streams != NULL)
+    std_free(chan -> streams);
 
   sock_destroy(chan -> sk);
   
@@ -118,7 +196,7 @@ channel_is_readable(channel_t chan){
 
 int
 channel_is_writable(channel_t chan){
-  return msg_buff_list_size(chan -> buff_queue) > 0
+  return (sendq_size(chan -> sendq) > 0 && !sock_is_tx_blocked(chan -> sk))
     || chan -> state == CHANNEL_SETUP;
 }
 
@@ -149,24 +227,289 @@ channel_is_established(channel_t chan){
   return chan -> connect_state == CHANNEL_CONNECT_ESTABLISHED;
 }
 
+/* must be set before anything is queued */
+void
+channel_set_budget(channel_t chan, channel_budget_t budget){
+  assert(sendq_size(chan -> sendq) == 0);
+  chan -> budget = budget;
+}
+
+/* count what is queued on chan, from now on, in the per-peer counter */
+/* other threads read. to be called by the thread owning the queue */
+void
+channel_set_link_counter(channel_t chan, long *link_queued){
+  assert(chan -> link_queued == NULL);
+  chan -> link_queued = link_queued;
+  __sync_fetch_and_add(link_queued, sendq_bytes(chan -> sendq));
+}
+
+long
+channel_queued_bytes(channel_t chan){
+  return sendq_bytes(chan -> sendq);
+}
+
+int
+channel_queued_chunks(channel_t chan){
+  return sendq_size(chan -> sendq);
+}
+
 /* pass on read chunk to next channel: */
 /* if the send buffer is NOT full, push the chunk onto it */
 /* if the send buffer is full, join the wait-queue block until current chunk can be pushed */
 int
 channel_pipeline_chunk(channel_t chan, channel_t next){
-  assert(chan -> curr_buff != NULL);
-  if(msg_buff_list_size(next -> buff_queue) < CHANNEL_MSG_QUEUE_LIMIT){
-    chan -> state = CHANNEL_ACTIVE;
-    msg_buff_list_append(next -> buff_queue, chan -> curr_buff);
+  channel_fanout_reset(chan);
+  channel_fanout_add(chan, next);
+  return channel_pipeline_fanout(chan);
+}
+
+/* next channels that the chunk being read is passed on to */
+void
+channel_fanout_reset(channel_t chan){
+  chan -> nfanout = 0;
+}
+
+void
+channel_fanout_add(channel_t chan, channel_t next){
+  if(chan -> nfanout == chan -> fanout_cap){
+    chan -> fanout_cap = chan -> fanout_cap ? 2 * chan -> fanout_cap : 4;
+    chan -> fanout = std_realloc(chan -> fanout, sizeof(channel_t) * chan -> fanout_cap);
+  }
+  chan -> fanout[chan -> nfanout ++] = next;
+}
+
+/* pass on read chunk to each of the next channels: all but the last take a share of it. */
+/* if a send queue is full, block on it as channel_pipeline_chunk() does, */
+/* and once unblocked go on with the channels left */
+int
+channel_pipeline_fanout(channel_t chan){
+  channel_t next;
+  msg_buff_t buff;
+
+  assert(chan -> curr_buff != NULL && chan -> nfanout > 0);
+  while(chan -> nfanout){
+    next = chan -> fanout[chan -> nfanout - 1];
+    if(!channel_queue_admits(next, msg_buff_len(chan -> curr_buff))){
+      chan -> state = CHANNEL_BLOCKING;
+      channel_list_append(next -> wait_queue, chan);
+      /* printf("BLOCKED %d -X-> %d (dst: %d)\n", chan -> peer_id, next -> peer_id, chan -> msg_info -> dst_id);fflush(stdout); */
+      return CHANNEL_PIPELINE_FAIL;
+    }
+    buff = chan -> nfanout > 1 ? msg_buff_share(chan -> curr_buff) : chan -> curr_buff;
+    channel_queue_push(next, buff, chan -> msg_info);
+    chan -> nfanout --;
+    /* printf("PIPELINE %d ---> %d (dst: %d) size: %d\n", chan -> peer_id, next -> peer_id, chan -> msg_info -> dst_id, sendq_size(next -> sendq));fflush(stdout); */
+  }
+  chan -> state = CHANNEL_ACTIVE;
+  chan -> curr_buff = NULL;
+  return CHANNEL_PIPELINE_OK;
+}
+
+/* queue a chunk taken off a failed link, beyond the budgets if need be: */
+/* it was admitted once already */
+void
+channel_requeue_chunk(channel_t chan, msg_buff_t buff, msg_info_t minfo){
+  channel_queue_push(chan, buff, minfo);
+}
+
+/* a channel going away gives up the data chunks it holds, rewound to resend whole: */
+/* those queued to be sent, and the one it is blocked passing on. */
+/* channels blocked on it are moved to waiters */
+void
+channel_salvage(channel_t chan, msg_buff_list_t chunks, channel_list_t waiters){
+  msg_buff_t buff;
+
+  /* no I/O may still be in flight on the buffers taken */
+  if(chan -> sk -> uring != NULL)
+    sock_uring_cancel(chan -> sk);
+
+  while(sendq_size(chan -> sendq)){
+    buff = channel_queue_pop(chan);
+    buff -> head = buff -> data;
+    msg_buff_list_append(chunks, buff);
+  }
+  if(chan -> state == CHANNEL_BLOCKING && chan -> msg_info -> kind != MSG_TYPE_MCAST){
+    msg_buff_list_append(chunks, chan -> curr_buff);
     chan -> curr_buff = NULL;
-    /* printf("PIPELINE %d ---> %d (dst: %d) size: %d\n", chan -> peer_id, next -> peer_id, chan -> msg_info -> dst_id, msg_buff_list_size(next -> buff_queue));fflush(stdout); */
-    return CHANNEL_PIPELINE_OK;
-  }else{
-    chan -> state = CHANNEL_BLOCKING;
-    channel_list_append(next -> wait_queue, chan);
-    /* printf("BLOCKED %d -X-> %d (dst: %d)\n", chan -> peer_id, next -> peer_id, chan -> msg_info -> dst_id);fflush(stdout); */
-    return CHANNEL_PIPELINE_FAIL;
   }
+  while(channel_list_size(chan -> wait_queue))
+    channel_list_append(waiters, channel_list_popleft(chan -> wait_queue));
+}
+
+/* forget a channel going away, that this one may be blocked on */
+void
+channel_forget(channel_t chan, channel_t gone){
+  channel_list_cell_t cell;
+  int i, n;
+
+  for(cell = channel_list_head(chan -> wait_queue); cell != channel_list_end(chan -> wait_queue);){
+    if(channel_list_cell_data(cell) == gone){
+      channel_list_remove(chan -> wait_queue, cell);
+      break;
+    }
+    cell = channel_list_cell_next(cell);
+  }
+  if(chan -> state != CHANNEL_BLOCKING)
+    return;
+  for(i = 0, n = 0; i < chan -> nfanout; i++)
+    if(chan -> fanout[i] != gone)
+      chan -> fanout[n ++] = chan -> fanout[i];
+  chan -> nfanout = n;
+}
+
+void
+channel_add_stream(channel_t head, channel_t stream){
+  assert(head -> stream_head == NULL);
+  head -> streams = std_realloc(head -> streams, sizeof(channel_t) * (head -> nstreams + 1));
+  head -> streams[head -> nstreams ++] = stream;
+  stream -> stream_head = head;
+}
+
+void
+channel_remove_stream(channel_t head, channel_t stream){
+  int i;
+  for(i = 0; i < head -> nstreams; i++){
+    if(head -> streams[i] == stream){
+      head -> streams[i] = head -> streams[-- head -> nstreams];
+      stream -> stream_head = NULL;
+      return;
+    }
+  }
+  assert(0); /* not a stream of head */
+}
+
+/* when the head channel dies, hand its extra streams and lanes to one of the streams. */
+/* without one, lanes are left detached */
+channel_t
+channel_promote_stream(channel_t head){
+  channel_t new_head = NULL;
+  int i;
+
+  if(head -> nstreams > 0){
+    new_head = head -> streams[0];
+    new_head -> stream_head = NULL;
+    for(i = 1; i < head -> nstreams; i++)
+      channel_add_stream(new_head, head -> streams[i]);
+    head -> nstreams = 0;
+  }
+
+  for(i = 1; i < CHANNEL_MAX_LANES; i++){
+    if(head -> lanes[i] == NULL)
+      continue;
+    head -> lanes[i] -> lane_head = NULL;
+    if(new_head != NULL)
+      channel_add_lane(new_head, head -> lanes[i]);
+    head -> lanes[i] = NULL;
+  }
+
+  return new_head;
+}
+
+void
+channel_add_lane(channel_t head, channel_t lane){
+  assert(head -> stream_head == NULL && head -> lane == 0);
+  assert(lane -> lane > 0 && lane -> lane < CHANNEL_MAX_LANES);
+  assert(head -> lanes[lane -> lane] == NULL);
+  head -> lanes[lane -> lane] = lane;
+  lane -> lane_head = head;
+}
+
+void
+channel_remove_lane(channel_t head, channel_t lane){
+  assert(head -> lanes[lane -> lane] == lane);
+  head -> lanes[lane -> lane] = NULL;
+  lane -> lane_head = NULL;
+}
+
+/* channel for a hop on the given virtual lane, NULL if that lane is gone: */
+/* taking another lane could close a cycle of waits the routes were made to avoid. */
+/* lane 0 is striped over the parallel streams of the link */
+channel_t
+channel_select_lane(channel_t head, int lane){
+  assert(lane >= 0 && lane < CHANNEL_MAX_LANES);
+  if(lane > 0)
+    return head -> lanes[lane];
+  return channel_select_stream(head);
+}
+
+/* choose the stream to which the next chunk is striped: */
+/* the one with the shortest send queue, starting round-robin to break ties */
+channel_t
+channel_select_stream(channel_t head){
+  channel_t chan, best = head;
+  int i, n = head -> nstreams + 1;
+  int start;
+  long size, best_size = -1;
+
+  if(head -> nstreams == 0)
+    return head;
+
+  start = head -> stream_rr ++;
+  for(i = 0; i < n; i++){
+    int k = (start + i) % n;
+    chan = (k == 0) ? head : head -> streams[k - 1];
+    size = sendq_bytes(chan -> sendq);
+    if(best_size == -1 || size < best_size){
+      best = chan;
+      best_size = size;
+    }
+  }
+  return best;
+}
+
+/* size socket buffers to twice the bandwidth-delay product of the link, */
+/* rtt in [s] and width in [Mbps], shared equally by its parallel streams. */
+/* links of unknown width (0) are left to kernel autotuning */
+void
+channel_tune_buffers(channel_t chan, double rtt, float width){
+  channel_t head = chan -> stream_head ? chan -> stream_head : chan;
+  double bdp = width * 1e6 / 8 * rtt / (head -> nstreams + 1);
+  int size = (int)(2 * bdp);
+
+  if(width <= 0)
+    return;
+
+  if(size < CHANNEL_MIN_SOCK_BUFF)
+    size = CHANNEL_MIN_SOCK_BUFF;
+  if(size > CHANNEL_MAX_SOCK_BUFF)
+    size = CHANNEL_MAX_SOCK_BUFF;
+
+  /* beyond what can be set explicitly, autotuning does better, */
+  /* unless buffers were already fixed */
+  if(chan -> sock_buff == 0 && size > sock_setopt_max() && sock_autotune_max() >= sock_setopt_max())
+    return;
+  if(size > sock_setopt_max())
+    size = sock_setopt_max();
+
+  /* avoid resetting for small changes */
+  if(chan -> sock_buff != 0 && 4 * abs(size - chan -> sock_buff) < chan -> sock_buff)
+    return;
+
+  /* printf("tune buffers: peer %d rtt %.3f[ms] width %.1f size %d\n", chan -> peer_id, rtt * 1e3, width, size);fflush(stdout); */
+  sock_set_buffers(chan -> sk, size);
+  chan -> sock_buff = size;
+}
+
+/* channel_tune_buffers() for a link: its head channel, streams and lanes */
+void
+channel_tune_link(channel_t head, double rtt, float width){
+  int i;
+
+  channel_tune_buffers(head, rtt, width);
+  for(i = 0; i < head -> nstreams; i++)
+    channel_tune_buffers(head -> streams[i], rtt, width);
+  for(i = 1; i < CHANNEL_MAX_LANES; i++)
+    if(head -> lanes[i] != NULL)
+      channel_tune_buffers(head -> lanes[i], rtt, width);
+}
+
+/* switch sending to shared memory once the last queued message is written, */
+/* it is the marker that tells the peer to switch reading. */
+/* whatever goes out after it, in any flow, is read from the ring */
+void
+channel_shm_switch_tx(channel_t chan){
+  assert(sendq_last(chan -> sendq) != NULL);
+  chan -> shm_switch = sendq_last(chan -> sendq);
 }
 
 int
@@ -214,20 +557,30 @@ _channel_setup_chunk(channel_t chan, int size, void* buff){
   chan -> curr_buff = msg_buff_create_on_buff(size, buff);
 }
 
+/* chunk to relay: its buffer is taken from pool if one is given and free */
 void
-channel_setup_chunk(channel_t chan){
+channel_setup_chunk(channel_t chan, msg_buff_pool_t pool){
   void** tail;
 
   int size = chan -> msg_info -> len + CHANNEL_MSG_HEADERLEN;
 
   assert(chan -> msg_info -> len > 0);
-  _channel_setup_chunk(chan, size, NULL);
+  assert(chan -> curr_buff == NULL);
+  if((chan -> curr_buff = msg_buff_create_from_pool(pool, size)) == NULL)
+    _channel_setup_chunk(chan, size, NULL);
 
   /* copy header contents into buffer head */
   tail = msg_buff_tail(chan -> curr_buff);
   pack_buff(tail, chan -> header_buff, CHANNEL_MSG_HEADERLEN);
 }
 
+/* rewrite the header copied into the chunk held, after msg_info was updated */
+void
+channel_repack_header(channel_t chan){
+  void* head = (void*)*msg_buff_head(chan -> curr_buff);
+  msg_info_pack(chan -> msg_info, &head);
+}
+
 void
 channel_setup_chunk_with_buff(channel_t chan, void* buff){
   int size = chan -> msg_info -> len;
@@ -344,8 +697,27 @@ void
 channel_send_msg(channel_t chan, msg_info_t minfo, const void* buff, int len){
   msg_buff_t msg = channel_pack_buff(minfo, buff, len);
 
-  /* queue in outgoing msg queue */
-  msg_buff_list_append(chan -> buff_queue, msg);
+  /* queued ahead of data chunks, and never held back by the budgets */
+  channel_queue_push(chan, msg, minfo);
+}
+
+/* destroy sent buffers the kernel no longer reads from */
+int
+channel_zc_release(channel_t chan){
+  msg_buff_t buff;
+
+  if(msg_buff_list_size(chan -> zc_pending) == 0)
+    return 0;
+  if(sock_zc_reap(chan -> sk) == -1)
+    return -1;
+
+  while(msg_buff_list_size(chan -> zc_pending)){
+    buff = msg_buff_list_cell_data(msg_buff_list_head(chan -> zc_pending));
+    if(!sock_zc_done(chan -> sk, buff -> zc_id))
+      break;
+    msg_buff_destroy(msg_buff_list_popleft(chan -> zc_pending));
+  }
+  return 0;
 }
 
 int
@@ -357,10 +729,12 @@ channel_write(channel_t chan, int *unblock){
   int n, len;
 
   *unblock = 0;
-  while(msg_buff_list_size(chan -> buff_queue)){
+  if(channel_zc_release(chan) == -1)
+    return CHANNEL_WRITE_ERR;
+  while(sendq_size(chan -> sendq)){
 
-    /* pop a msg chunk and try to send */
-    buff = msg_buff_list_cell_data(msg_buff_list_head(chan -> buff_queue));
+    /* pick the next chunk, by flow, and try to send */
+    buff = sendq_head(chan -> sendq);
     head = msg_buff_head(buff);
     len = msg_buff_send_len(buff);
 
@@ -382,17 +756,26 @@ channel_write(channel_t chan, int *unblock){
     }
 
     /* if msg buff completely sent delete */
-    msg_buff_list_popleft(chan -> buff_queue);
-    msg_buff_destroy(buff);
+    channel_queue_pop(chan);
+    if(buff == chan -> shm_switch){
+      sock_shm_start_tx(chan -> sk);
+      chan -> shm_switch = NULL;
+    }
+    /* keep it while zerocopy sends are outstanding */
+    if(!sock_zc_done(chan -> sk, sock_zc_sent(chan -> sk))){
+      buff -> zc_id = sock_zc_sent(chan -> sk);
+      msg_buff_list_append(chan -> zc_pending, buff);
+    }else
+      msg_buff_destroy(buff);
 
     /* unblock producer */
-    while(channel_list_size(chan -> wait_queue) &&
-	  msg_buff_list_size(chan -> buff_queue) < CHANNEL_MSG_QUEUE_LIMIT){
-      /* as much as i would like to, this does not hold for send_msg() */
-      /* assert(msg_buff_list_size(chan -> buff_queue) < CHANNEL_MSG_QUEUE_LIMIT); */
-      waiter = channel_list_popleft(chan -> wait_queue);
-      stat = channel_pipeline_chunk(waiter, chan);
-      assert(stat == CHANNEL_PIPELINE_OK);
+    while(channel_list_size(chan -> wait_queue)){
+      waiter = channel_list_cell_data(channel_list_head(chan -> wait_queue));
+      if(!channel_queue_admits(chan, msg_buff_len(waiter -> curr_buff)))
+	break;
+      channel_list_popleft(chan -> wait_queue);
+      /* a multicast chunk may go on to block on another of its next channels */
+      channel_pipeline_fanout(waiter);
       *unblock = 1;
     }
   }
@@ -405,12 +788,12 @@ channel_local_push_chunk(channel_t chan, msg_info_t minfo, const void *buff, int
   const int byte = 1;
   msg_buff_t chunk = channel_pack_buff(minfo, buff, len);
 
-  /* write to blocking finite queue */
+  /* write to blocking finite queue, control messages are never held back */
   pthread_mutex_lock(&chan -> lock);
-  while(msg_buff_list_size(chan -> buff_queue) >= CHANNEL_MSG_QUEUE_LIMIT)
+  while(channel_is_data(minfo) && !channel_queue_admits(chan, msg_buff_len(chunk)))
     pthread_cond_wait(&chan -> cond, &chan -> lock);
   
-  msg_buff_list_append(chan -> buff_queue, chunk);
+  channel_queue_push(chan, chunk, minfo);
   pthread_mutex_unlock(&chan -> lock);
 
   std_write(chan -> pipe[1], &byte, sizeof(int)); /* for header, and passing on chunk */
@@ -427,11 +810,10 @@ channel_local_pop_chunk(channel_t chan){
   
   /* read from blocking finite queue */
   pthread_mutex_lock(&chan -> lock);
-  chunk = msg_buff_list_popleft(chan -> buff_queue);
+  chunk = channel_queue_pop(chan);
     
-  /* if queue is not full anymore, signal */
-  if(msg_buff_list_size(chan -> buff_queue) == CHANNEL_MSG_QUEUE_LIMIT - 1)
-    pthread_cond_broadcast(&chan -> cond);
+  /* room was freed here, and maybe in the node budget */
+  pthread_cond_broadcast(&chan -> cond);
 
   pthread_mutex_unlock(&chan -> lock);
   
@@ -0,0 +1,730 @@
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <std/std.h>
+#include <struct/rtable.h>
+#include "impl/msg.h"
+#include "impl/coll.h"
+
+#define Min(a, b) ((a) < (b) ? (a) : (b))
+
+#define COLL_MAKE_OP(NAME, TYPE, EXPR)			\
+  void							\
+  coll_op_ ## NAME(void* inout, const void* in, int count){	\
+    TYPE *a = inout;					\
+    const TYPE *b = in;					\
+    int i;						\
+    for(i = 0; i < count; i++)				\
+      a[i] = EXPR;					\
+  }
+
+COLL_MAKE_OP(sum_int, int, a[i] + b[i])
+COLL_MAKE_OP(sum_long, long, a[i] + b[i])
+COLL_MAKE_OP(sum_float, float, a[i] + b[i])
+COLL_MAKE_OP(sum_double, double, a[i] + b[i])
+COLL_MAKE_OP(max_double, double, a[i] > b[i] ? a[i] : b[i])
+COLL_MAKE_OP(min_double, double, a[i] < b[i] ? a[i] : b[i])
+
+/* members ordered so that each is followed by the nearest of those left, */
+/* by the hops of the route between them */
+static int*
+coll_make_ring(comm_node_t node, comm_group_t g){
+  int* ring = std_malloc(sizeof(int) * g -> size);
+  char* used = std_calloc(g -> size, sizeof(char));
+  overlay_rtable_entry_t e;
+  int i, k, hops, best, best_hops = 0;
+
+  ring[0] = g -> members[0];
+  used[0] = 1;
+  for(i = 1; i < g -> size; i++){
+    best = -1;
+    for(k = 0; k < g -> size; k++){
+      if(used[k])
+	continue;
+      hops = 1;
+      if(node -> rts[ring[i - 1]] != NULL
+	 && (e = overlay_rtable_get_entry(node -> rts[ring[i - 1]], g -> members[k])) != NULL)
+	hops = e -> hops;
+      if(best == -1 || hops < best_hops){
+	best = k;
+	best_hops = hops;
+      }
+    }
+    ring[i] = g -> members[best];
+    used[best] = 1;
+  }
+  std_free(used);
+  return ring;
+}
+
+static void
+coll_ctx_init(coll_ctx_t ctx, comm_node_t node, int gid){
+  comm_group_t g;
+
+  assert(gid >= 0 && gid < node -> num_groups && node -> groups[gid] != NULL);
+  g = node -> groups[gid];
+  assert(g -> is_member[node -> node_id]);
+  if(g -> ring == NULL)
+    g -> ring = coll_make_ring(node, g);
+
+  ctx -> node = node;
+  ctx -> gid = gid;
+  ctx -> group = g;
+  ctx -> n = g -> size;
+  for(ctx -> pos = 0; g -> ring[ctx -> pos] != node -> node_id; ctx -> pos ++);
+  ctx -> prev = g -> ring[(ctx -> pos + ctx -> n - 1) % ctx -> n];
+  ctx -> next = g -> ring[(ctx -> pos + 1) % ctx -> n];
+  ctx -> seq = g -> coll_seq ++;
+  ctx -> sent = 0;
+  ctx -> recvd = 0;
+}
+
+/* tag of the message of an operation at a fixed step (COLL_*_STEP). */
+/* two members may share several groups, so the group is part of the tag */
+static int
+coll_fixed_tag(coll_ctx_t ctx, int step){
+  assert(step < COLL_MAX_STEPS && ctx -> gid < (1 << 6));
+  return 1 + (ctx -> gid << 24 | (ctx -> seq & 0xff) << 16 | step);
+}
+
+/* tags of the messages of an operation, by the step each is sent at. */
+/* counted steps must stay clear of the fixed ones */
+static int
+coll_tag(coll_ctx_t ctx, int step){
+  assert(step < COLL_MAX_COUNTED_STEPS);
+  return coll_fixed_tag(ctx, step);
+}
+
+static int
+coll_rank(comm_group_t g, int node_id){
+  int rank;
+  for(rank = 0; rank < g -> size; rank++)
+    if(g -> members[rank] == node_id)
+      return rank;
+  assert(0); /* not a member */
+  return -1;
+}
+
+/* elements count are split into blocks, one per member in the order members were given */
+static void
+coll_range(int count, int n, int rank, int* off, int* cnt){
+  *off = (long)count * rank / n;
+  *cnt = (long)count * (rank + 1) / n - *off;
+}
+
+/* rank of the member at a position in the ring, modulo its size */
+static int
+coll_pos_rank(coll_ctx_t ctx, int pos){
+  pos = ((pos % ctx -> n) + ctx -> n) % ctx -> n;
+  return coll_rank(ctx -> group, ctx -> group -> ring[pos]);
+}
+
+static int
+coll_seg_elems(int elem_size){
+  return COLL_SEGMENT_SIZE / elem_size > 0 ? COLL_SEGMENT_SIZE / elem_size : 1;
+}
+
+static void
+coll_send_next(coll_ctx_t ctx, const void* buff, int len){
+  comm_node_send_tagged(ctx -> node, ctx -> next, buff, len, coll_tag(ctx, ctx -> sent ++));
+}
+
+static void*
+coll_recv_prev(coll_ctx_t ctx, int len){
+  void* buff;
+  int n;
+
+  comm_node_recv_tagged(ctx -> node, ctx -> prev, coll_tag(ctx, ctx -> recvd ++), &buff, &n);
+  assert(n == len);
+  return buff;
+}
+
+/* send the block of the member at a ring position to next, in segments */
+static void
+coll_send_block(coll_ctx_t ctx, char* buff, int pos, int count, int elem_size){
+  int off, cnt, s;
+  int seg = coll_seg_elems(elem_size);
+
+  coll_range(count, ctx -> n, coll_pos_rank(ctx, pos), &off, &cnt);
+  for(s = 0; s < cnt; s += seg)
+    coll_send_next(ctx, buff + (long)(off + s) * elem_size, Min(seg, cnt - s) * elem_size);
+}
+
+/* at step k each member passes on the block it reduced at step k - 1, */
+/* a segment at a time, so that segments are pipelined around the ring. */
+/* after n - 1 steps the block of each member is fully reduced on it */
+static void
+coll_ring_reduce_scatter(coll_ctx_t ctx, char* buff, int count, int elem_size, coll_op_t op){
+  int seg = coll_seg_elems(elem_size);
+  int k, s, off, cnt, len;
+  char* p;
+  void* in;
+
+  coll_send_block(ctx, buff, ctx -> pos - 1, count, elem_size);
+  for(k = 0; k < ctx -> n - 1; k++){
+    coll_range(count, ctx -> n, coll_pos_rank(ctx, ctx -> pos - k - 2), &off, &cnt);
+    for(s = 0; s < cnt; s += seg){
+      p = buff + (long)(off + s) * elem_size;
+      len = Min(seg, cnt - s);
+      in = coll_recv_prev(ctx, len * elem_size);
+      op(p, in, len);
+      std_free(in);
+      if(k < ctx -> n - 2)
+	coll_send_next(ctx, p, len * elem_size);
+    }
+  }
+}
+
+/* each member starts with its own block, and passes on what it receives */
+static void
+coll_ring_allgather(coll_ctx_t ctx, char* buff, int count, int elem_size){
+  int seg = coll_seg_elems(elem_size);
+  int k, s, off, cnt, len;
+  char* p;
+  void* in;
+
+  coll_send_block(ctx, buff, ctx -> pos, count, elem_size);
+  for(k = 0; k < ctx -> n - 1; k++){
+    coll_range(count, ctx -> n, coll_pos_rank(ctx, ctx -> pos - k - 1), &off, &cnt);
+    for(s = 0; s < cnt; s += seg){
+      p = buff + (long)(off + s) * elem_size;
+      len = Min(seg, cnt - s);
+      in = coll_recv_prev(ctx, len * elem_size);
+      std_memcpy(p, in, len * elem_size);
+      std_free(in);
+      if(k < ctx -> n - 2)
+	coll_send_next(ctx, p, len * elem_size);
+    }
+  }
+}
+
+/* small vectors: every member sends all of it to the root */
+static void
+coll_direct_reduce(coll_ctx_t ctx, int root_id, void* buff, int count, int elem_size, coll_op_t op){
+  comm_group_t g = ctx -> group;
+  void* in;
+  int i, n;
+
+  if(ctx -> node -> node_id != root_id){
+    comm_node_send_tagged(ctx -> node, root_id, buff, count * elem_size, coll_fixed_tag(ctx, COLL_GATHER_STEP));
+    return;
+  }
+  for(i = 0; i < g -> size; i++){
+    if(g -> members[i] == root_id)
+      continue;
+    comm_node_recv_tagged(ctx -> node, g -> members[i], coll_fixed_tag(ctx, COLL_GATHER_STEP), &in, &n);
+    assert(n == count * elem_size);
+    op(buff, in, count);
+    std_free(in);
+  }
+}
+
+/* the root sends along the multicast tree of the routes to the members */
+static void
+coll_mcast(coll_ctx_t ctx, int root_id, void* buff, int len){
+  void* in;
+  int n;
+
+  if(ctx -> node -> node_id == root_id){
+    comm_node_mcast_tagged(ctx -> node, ctx -> gid, buff, len, coll_fixed_tag(ctx, COLL_BCAST_STEP));
+    return;
+  }
+  comm_node_recv_tagged(ctx -> node, root_id, coll_fixed_tag(ctx, COLL_BCAST_STEP), &in, &n);
+  assert(n == len);
+  std_memcpy(buff, in, len);
+  std_free(in);
+}
+
+static overlay_rtable_entry_t
+coll_route(comm_node_t node, int src_id, int dst_id){
+  if(node -> rts[src_id] == NULL)
+    return NULL;
+  return overlay_rtable_get_entry(node -> rts[src_id], dst_id);
+}
+
+/* longest routes first, the rest in a fixed order so that all members agree */
+static int
+coll_flow_cmp(const void* a, const void* b){
+  const coll_flow *x = a, *y = b;
+  if(x -> hops != y -> hops)
+    return y -> hops - x -> hops;
+  if(x -> src != y -> src)
+    return x -> src - y -> src;
+  return x -> dst - y -> dst;
+}
+
+/* phases of an all-to-all, as a greedy coloring of the flows: each goes in the first */
+/* phase in which its source sends nothing else, its destination receives nothing else, */
+/* and no link of its route carries another flow. every member computes the same */
+/* schedule from the routing tables, and keeps its own part of it */
+static void
+coll_make_alltoall_schedule(comm_node_t node, comm_group_t g){
+  int n = g -> size, nflows = n * (n - 1);
+  coll_flow_t flows = std_malloc(sizeof(coll_flow) * nflows);
+  overlay_rtable_entry_t e;
+  int *edge_id, *edges, *first, nedges = 0, maxid = 0;
+  char **tx_busy = NULL, **rx_busy = NULL, **link_busy = NULL;
+  int nphases = 0, *phase = std_malloc(sizeof(int) * nflows);
+  int i, j, k, f, p, me = coll_rank(g, node -> node_id);
+
+  for(f = 0, i = 0; i < n; i++){
+    for(j = 0; j < n; j++){
+      if(i == j)
+	continue;
+      e = coll_route(node, g -> members[i], g -> members[j]);
+      flows[f].src = i;
+      flows[f].dst = j;
+      flows[f].hops = e != NULL ? e -> hops : 1;
+      for(k = 0; e != NULL && k <= e -> hops; k++)
+	if(e -> path[k] > maxid)
+	  maxid = e -> path[k];
+      if(g -> members[i] > maxid)
+	maxid = g -> members[i];
+      f++;
+    }
+  }
+  qsort(flows, nflows, sizeof(coll_flow), coll_flow_cmp);
+
+  /* number the links used, and list those of each flow (a direct flow has a link of its own) */
+  maxid ++;
+  edge_id = std_calloc((long)maxid * maxid, sizeof(int));
+  first = std_malloc(sizeof(int) * (nflows + 1));
+  for(first[0] = 0, f = 0; f < nflows; f++)
+    first[f + 1] = first[f] + Min(flows[f].hops, COLL_MAX_HOPS);
+  edges = std_malloc(sizeof(int) * first[nflows]);
+  for(f = 0; f < nflows; f++){
+    int src = g -> members[flows[f].src], dst = g -> members[flows[f].dst];
+    e = coll_route(node, src, dst);
+    for(k = 0; k < first[f + 1] - first[f]; k++){
+      int u = e != NULL ? e -> path[k] : src, v = e != NULL ? e -> path[k + 1] : dst;
+      if(edge_id[(long)u * maxid + v] == 0)
+	edge_id[(long)u * maxid + v] = ++ nedges;
+      edges[first[f] + k] = edge_id[(long)u * maxid + v] - 1;
+    }
+  }
+  std_free(edge_id);
+
+  for(f = 0; f < nflows; f++){
+    for(p = 0; p < nphases; p++){
+      if(tx_busy[p][flows[f].src] || rx_busy[p][flows[f].dst])
+	continue;
+      for(k = first[f]; k < first[f + 1] && !link_busy[p][edges[k]]; k++);
+      if(k == first[f + 1])
+	break;
+    }
+    if(p == nphases){
+      nphases ++;
+      tx_busy = std_realloc(tx_busy, sizeof(char*) * nphases);
+      rx_busy = std_realloc(rx_busy, sizeof(char*) * nphases);
+      link_busy = std_realloc(link_busy, sizeof(char*) * nphases);
+      tx_busy[p] = std_calloc(n, sizeof(char));
+      rx_busy[p] = std_calloc(n, sizeof(char));
+      link_busy[p] = std_calloc(nedges, sizeof(char));
+    }
+    tx_busy[p][flows[f].src] = 1;
+    rx_busy[p][flows[f].dst] = 1;
+    for(k = first[f]; k < first[f + 1]; k++)
+      link_busy[p][edges[k]] = 1;
+    phase[f] = p;
+  }
+
+  g -> a2a_nphases = nphases;
+  g -> a2a_to = std_malloc(sizeof(int) * nphases);
+  g -> a2a_from = std_malloc(sizeof(int) * nphases);
+  for(p = 0; p < nphases; p++){
+    g -> a2a_to[p] = -1;
+    g -> a2a_from[p] = -1;
+  }
+  for(f = 0; f < nflows; f++){
+    if(flows[f].src == me)
+      g -> a2a_to[phase[f]] = flows[f].dst;
+    if(flows[f].dst == me)
+      g -> a2a_from[phase[f]] = flows[f].src;
+  }
+
+  for(p = 0; p < nphases; p++){
+    std_free(tx_busy[p]);
+    std_free(rx_busy[p]);
+    std_free(link_busy[p]);
+  }
+  std_free(tx_busy);
+  std_free(rx_busy);
+  std_free(link_busy);
+  std_free(edges);
+  std_free(first);
+  std_free(phase);
+  std_free(flows);
+}
+
+/* send blocks[i] (lens[i] bytes, > 0) to the member of rank i, and receive from each */
+/* other member into in[rank], in the phases of the all-to-all schedule of the group. */
+/* a phase starts once the flow received COLL_ALLTOALL_WINDOW - 1 phases earlier */
+/* has arrived */
+static void
+coll_exchange(coll_ctx_t ctx, const void** blocks, const int* lens, void** in, int* inlens){
+  comm_group_t g = ctx -> group;
+  int p, q, to, from, n;
+
+  if(g -> a2a_to == NULL)
+    coll_make_alltoall_schedule(ctx -> node, g);
+  for(p = 0; p < g -> a2a_nphases + COLL_ALLTOALL_WINDOW - 1; p++){
+    if(p < g -> a2a_nphases && (to = g -> a2a_to[p]) != -1){
+      assert(lens[to] > 0);
+      comm_node_send_tagged(ctx -> node, g -> members[to], blocks[to], lens[to], coll_tag(ctx, p));
+    }
+    q = p - (COLL_ALLTOALL_WINDOW - 1);
+    if(q >= 0 && q < g -> a2a_nphases && (from = g -> a2a_from[q]) != -1){
+      comm_node_recv_tagged(ctx -> node, g -> members[from], coll_tag(ctx, q), &in[from], &n);
+      if(inlens != NULL)
+	inlens[from] = n;
+    }
+  }
+}
+
+/* where the block of a member starts in a vector of count elements, and its length, */
+/* as left by coll_reduce_scatter() */
+void
+coll_block(comm_node_t node, int gid, int member_id, int count, int* off, int* n){
+  assert(gid >= 0 && gid < node -> num_groups && node -> groups[gid] != NULL);
+  coll_range(count, node -> groups[gid] -> size, coll_rank(node -> groups[gid], member_id), off, n);
+}
+
+/* every member of group gid calls the collective operations on it in the same order. */
+/* messages of one are kept apart from user messages and from those of other operations */
+
+/* dissemination barrier: in round r each member signals the one 2^r ahead of it */
+/* in the ring and waits for the one 2^r behind, so that after log2(n) rounds */
+/* every member has heard, directly or not, from all others. signals are */
+/* control messages, which do not queue behind bulk chunks */
+void
+coll_barrier(comm_node_t node, int gid){
+  coll_ctx ctx;
+  comm_group_t g;
+  void* in;
+  int r, d, n;
+
+  coll_ctx_init(&ctx, node, gid);
+  g = ctx.group;
+  for(r = 0, d = 1; d < ctx.n; r++, d *= 2){
+    comm_node_send_barrier(node, g -> ring[(ctx.pos + d) % ctx.n], coll_tag(&ctx, r));
+    comm_node_recv_tagged(node, g -> ring[(ctx.pos + ctx.n - d) % ctx.n], coll_tag(&ctx, r), &in, &n);
+    std_free(in);
+  }
+}
+
+void
+coll_bcast(comm_node_t node, int gid, int root_id, void* buff, int len){
+  coll_ctx ctx;
+
+  coll_ctx_init(&ctx, node, gid);
+  if(len == 0 || ctx.n == 1)
+    return;
+  coll_mcast(&ctx, root_id, buff, len);
+}
+
+/* result in buff of the root, other members' buff is overwritten */
+void
+coll_reduce(comm_node_t node, int gid, int root_id, void* buff, int count, int elem_size, coll_op_t op){
+  coll_ctx ctx;
+  comm_group_t g;
+  void* in;
+  int i, n, off, cnt;
+
+  coll_ctx_init(&ctx, node, gid);
+  if(count == 0 || ctx.n == 1)
+    return;
+  if((long)count * elem_size < COLL_RING_MIN_SIZE){
+    coll_direct_reduce(&ctx, root_id, buff, count, elem_size, op);
+    return;
+  }
+
+  /* the root collects the blocks reduced around the ring */
+  coll_ring_reduce_scatter(&ctx, buff, count, elem_size, op);
+  g = ctx.group;
+  if(node -> node_id != root_id){
+    coll_range(count, ctx.n, coll_rank(g, node -> node_id), &off, &cnt);
+    if(cnt > 0)
+      comm_node_send_tagged(node, root_id, (char*)buff + (long)off * elem_size, cnt * elem_size, coll_fixed_tag(&ctx, COLL_GATHER_STEP));
+    return;
+  }
+  for(i = 0; i < g -> size; i++){
+    coll_range(count, ctx.n, i, &off, &cnt);
+    if(g -> members[i] == root_id || cnt == 0)
+      continue;
+    comm_node_recv_tagged(node, g -> members[i], coll_fixed_tag(&ctx, COLL_GATHER_STEP), &in, &n);
+    assert(n == cnt * elem_size);
+    std_memcpy((char*)buff + (long)off * elem_size, in, n);
+    std_free(in);
+  }
+}
+
+/* large vectors are reduced and gathered around a ring of the members, */
+/* ordered by the routing tables so that ring neighbors are few hops apart. */
+/* small ones are reduced on a member and multicast back */
+void
+coll_allreduce(comm_node_t node, int gid, void* buff, int count, int elem_size, coll_op_t op){
+  coll_ctx ctx;
+
+  coll_ctx_init(&ctx, node, gid);
+  if(count == 0 || ctx.n == 1)
+    return;
+  if((long)count * elem_size < COLL_RING_MIN_SIZE){
+    coll_direct_reduce(&ctx, ctx.group -> ring[0], buff, count, elem_size, op);
+    coll_mcast(&ctx, ctx.group -> ring[0], buff, count * elem_size);
+    return;
+  }
+  coll_ring_reduce_scatter(&ctx, buff, count, elem_size, op);
+  coll_ring_allgather(&ctx, buff, count, elem_size);
+}
+
+/* on return, the block of this member (see coll_block()) holds the reduced values */
+void
+coll_reduce_scatter(comm_node_t node, int gid, void* buff, int count, int elem_size, coll_op_t op){
+  coll_ctx ctx;
+
+  coll_ctx_init(&ctx, node, gid);
+  if(count == 0 || ctx.n == 1)
+    return;
+  coll_ring_reduce_scatter(&ctx, buff, count, elem_size, op);
+}
+
+/* recvbuff gets len bytes from each member, in the order members were given */
+void
+coll_allgather(comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int len){
+  coll_ctx ctx;
+
+  coll_ctx_init(&ctx, node, gid);
+  std_memcpy((char*)recvbuff + (long)coll_rank(ctx.group, node -> node_id) * len, sendbuff, len);
+  if(len == 0 || ctx.n == 1)
+    return;
+  coll_ring_allgather(&ctx, recvbuff, ctx.n * len, 1);
+}
+
+/* sendbuff holds len bytes for each member and recvbuff gets len bytes from each, */
+/* in the order members were given. flows go in the phases of a schedule that keeps */
+/* them off each other's links */
+void
+coll_alltoall(comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int len){
+  coll_ctx ctx;
+  const void** blocks;
+  int* lens;
+  void** in;
+  int i, me;
+
+  coll_ctx_init(&ctx, node, gid);
+  me = coll_rank(ctx.group, node -> node_id);
+  std_memcpy((char*)recvbuff + (long)me * len, (const char*)sendbuff + (long)me * len, len);
+  if(len == 0 || ctx.n == 1)
+    return;
+
+  blocks = std_malloc(sizeof(void*) * ctx.n);
+  lens = std_malloc(sizeof(int) * ctx.n);
+  in = std_calloc(ctx.n, sizeof(void*));
+  for(i = 0; i < ctx.n; i++){
+    blocks[i] = (const char*)sendbuff + (long)i * len;
+    lens[i] = len;
+  }
+  coll_exchange(&ctx, blocks, lens, in, NULL);
+  for(i = 0; i < ctx.n; i++){
+    if(in[i] == NULL)
+      continue;
+    std_memcpy((char*)recvbuff + (long)i * len, in[i], len);
+    std_free(in[i]);
+  }
+  std_free(blocks);
+  std_free(lens);
+  std_free(in);
+}
+
+/* split group gid into clusters, e.g. the hosts under one switch or site: */
+/* clusters[rank] is the cluster of each member, numbered from 0 to nclusters - 1, */
+/* and leaders[c] the node id of the member of cluster c that talks to the other */
+/* clusters. a group is created for the members of each cluster and one for the */
+/* leaders, so, as for comm_node_group_create(), every node must call this with the */
+/* same arguments. members wait for each other before returning, so that none */
+/* multicasts to the new groups before all have them. */
+/* returns -1, and leaves the group flat, if there are not enough group ids left */
+int
+coll_hier_create(comm_node_t node, int gid, const int* clusters, int nclusters, const int* leaders){
+  comm_group_t g;
+  int* members;
+  int c, i, k;
+
+  assert(gid >= 0 && gid < node -> num_groups && node -> groups[gid] != NULL);
+  g = node -> groups[gid];
+  if(node -> num_groups + nclusters + 1 > COMM_MAX_GROUPS)
+    return -1;
+
+  if(g -> hier_nclusters > 0){
+    std_free(g -> hier_cluster);
+    std_free(g -> hier_gids);
+  }
+  g -> hier_nclusters = nclusters;
+  g -> hier_cluster = std_malloc(sizeof(int) * g -> size);
+  g -> hier_gids = std_malloc(sizeof(int) * nclusters);
+  std_memcpy(g -> hier_cluster, clusters, sizeof(int) * g -> size);
+
+  members = std_malloc(sizeof(int) * g -> size);
+  for(c = 0; c < nclusters; c++){
+    members[0] = leaders[c];
+    for(k = 1, i = 0; i < g -> size; i++)
+      if(clusters[i] == c && g -> members[i] != leaders[c])
+	members[k ++] = g -> members[i];
+    assert(clusters[coll_rank(g, leaders[c])] == c);
+    g -> hier_gids[c] = comm_node_group_create(node, members, k);
+  }
+  g -> hier_leaders = comm_node_group_create(node, leaders, nclusters);
+  std_free(members);
+
+  if(g -> is_member[node -> node_id])
+    coll_barrier(node, gid);
+  return 0;
+}
+
+/* group of the cluster of a member of a split group */
+static comm_group_t
+coll_hier_local(comm_node_t node, comm_group_t g, int node_id){
+  return node -> groups[g -> hier_gids[g -> hier_cluster[coll_rank(g, node_id)]]];
+}
+
+/* the hierarchical operations run the flat ones on the groups of coll_hier_create(): */
+/* within each cluster, then among the leaders only, so that data crosses the links */
+/* between clusters once per cluster rather than once per member. */
+/* on a group that was not split they are the flat operations */
+
+void
+coll_hier_bcast(comm_node_t node, int gid, int root_id, void* buff, int len){
+  comm_group_t g = node -> groups[gid];
+  comm_group_t local, root_local;
+
+  if(g -> hier_nclusters == 0){
+    coll_bcast(node, gid, root_id, buff, len);
+    return;
+  }
+  local = coll_hier_local(node, g, node -> node_id);
+  root_local = coll_hier_local(node, g, root_id);
+
+  /* the cluster of the root gets it first, then the other leaders, then their clusters */
+  if(local == root_local)
+    coll_bcast(node, g -> hier_gids[g -> hier_cluster[coll_rank(g, root_id)]], root_id, buff, len);
+  if(local -> members[0] == node -> node_id)
+    coll_bcast(node, g -> hier_leaders, root_local -> members[0], buff, len);
+  if(local != root_local)
+    coll_bcast(node, g -> hier_gids[g -> hier_cluster[coll_rank(g, node -> node_id)]], local -> members[0], buff, len);
+}
+
+void
+coll_hier_allreduce(comm_node_t node, int gid, void* buff, int count, int elem_size, coll_op_t op){
+  comm_group_t g = node -> groups[gid];
+  comm_group_t local;
+  int local_gid;
+
+  if(g -> hier_nclusters == 0){
+    coll_allreduce(node, gid, buff, count, elem_size, op);
+    return;
+  }
+  local_gid = g -> hier_gids[g -> hier_cluster[coll_rank(g, node -> node_id)]];
+  local = node -> groups[local_gid];
+
+  coll_reduce(node, local_gid, local -> members[0], buff, count, elem_size, op);
+  if(local -> members[0] == node -> node_id)
+    coll_allreduce(node, g -> hier_leaders, buff, count, elem_size, op);
+  coll_bcast(node, local_gid, local -> members[0], buff, count * elem_size);
+}
+
+/* members send all their blocks to their leader. leaders pack the blocks from their */
+/* cluster to each other cluster in a single message, exchange these in the phases */
+/* of the all-to-all schedule of the leaders, and send each member what it receives */
+void
+coll_hier_alltoall(comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int len){
+  comm_group_t g = node -> groups[gid];
+  comm_group_t local, other;
+  coll_ctx ctx, lctx;
+  int local_gid, n, k, c, nc, i, j, me, sz;
+  int *ranks, *lens;
+  const void** blocks;
+  void **bufs, **in, *p;
+  char *out, *q;
+
+  if(g -> hier_nclusters == 0 || len == 0){
+    coll_alltoall(node, gid, sendbuff, recvbuff, len);
+    return;
+  }
+  n = g -> size;
+  me = coll_rank(g, node -> node_id);
+  c = g -> hier_cluster[me];
+  local_gid = g -> hier_gids[c];
+  coll_ctx_init(&ctx, node, local_gid);
+  local = ctx.group;
+  if(local -> members[0] != node -> node_id){
+    comm_node_send_tagged(node, local -> members[0], sendbuff, n * len, coll_fixed_tag(&ctx, COLL_GATHER_STEP));
+    comm_node_recv_tagged(node, local -> members[0], coll_fixed_tag(&ctx, COLL_SCATTER_STEP), &p, &sz);
+    assert(sz == n * len);
+    std_memcpy(recvbuff, p, sz);
+    std_free(p);
+    return;
+  }
+
+  /* the leader: bufs[i] and out + i * n * len are what member i of the cluster sends and gets */
+  k = local -> size;
+  nc = g -> hier_nclusters;
+  bufs = std_malloc(sizeof(void*) * k);
+  bufs[0] = (void*)sendbuff;
+  for(i = 1; i < k; i++){
+    comm_node_recv_tagged(node, local -> members[i], coll_fixed_tag(&ctx, COLL_GATHER_STEP), &bufs[i], &sz);
+    assert(sz == n * len);
+  }
+  ranks = std_malloc(sizeof(int) * k);
+  out = std_malloc((long)k * n * len);
+  for(i = 0; i < k; i++)
+    ranks[i] = coll_rank(g, local -> members[i]);
+  for(i = 0; i < k; i++)
+    for(j = 0; j < k; j++)
+      std_memcpy(out + ((long)j * n + ranks[i]) * len, (char*)bufs[i] + (long)ranks[j] * len, len);
+
+  if(nc > 1){
+    coll_ctx_init(&lctx, node, g -> hier_leaders);
+    blocks = std_calloc(nc, sizeof(void*));
+    lens = std_calloc(nc, sizeof(int));
+    in = std_calloc(nc, sizeof(void*));
+    for(c = 0; c < nc; c++){
+      other = node -> groups[g -> hier_gids[c]];
+      if(other == local)
+	continue;
+      lens[c] = k * other -> size * len;
+      blocks[c] = q = std_malloc(lens[c]);
+      for(i = 0; i < k; i++)
+	for(j = 0; j < other -> size; j++, q += len)
+	  std_memcpy(q, (char*)bufs[i] + (long)coll_rank(g, other -> members[j]) * len, len);
+    }
+    coll_exchange(&lctx, blocks, lens, in, NULL);
+    for(c = 0; c < nc; c++){
+      if(in[c] == NULL)
+	continue;
+      other = node -> groups[g -> hier_gids[c]];
+      q = in[c];
+      for(i = 0; i < other -> size; i++){
+	int from = coll_rank(g, other -> members[i]);
+	for(j = 0; j < k; j++, q += len)
+	  std_memcpy(out + ((long)j * n + from) * len, q, len);
+      }
+      std_free(in[c]);
+    }
+    for(c = 0; c < nc; c++)
+      if(blocks[c] != NULL)
+	std_free((void*)blocks[c]);
+    std_free(blocks);
+    std_free(lens);
+    std_free(in);
+  }
+
+  for(i = 1; i < k; i++){
+    comm_node_send_tagged(node, local -> members[i], out + (long)i * n * len, n * len, coll_fixed_tag(&ctx, COLL_SCATTER_STEP));
+    std_free(bufs[i]);
+  }
+  std_memcpy(recvbuff, out, (long)n * len);
+  std_free(out);
+  std_free(ranks);
+  std_free(bufs);
+}
@@ -0,0 +1,31 @@
+#ifndef __COLL_H__
+#define __COLL_H__
+
+#include <comm/comm.h>
+
+/* combine count elements of in into inout, element by element */
+typedef void (*coll_op_t)(void* inout, const void* in, int count);
+
+void coll_op_sum_int(void* inout, const void* in, int count);
+void coll_op_sum_long(void* inout, const void* in, int count);
+void coll_op_sum_float(void* inout, const void* in, int count);
+void coll_op_sum_double(void* inout, const void* in, int count);
+void coll_op_max_double(void* inout, const void* in, int count);
+void coll_op_min_double(void* inout, const void* in, int count);
+
+void coll_block(comm_node_t node, int gid, int member_id, int count, int* off, int* n);
+
+void coll_barrier(comm_node_t node, int gid);
+void coll_bcast(comm_node_t node, int gid, int root_id, void* buff, int len);
+void coll_reduce(comm_node_t node, int gid, int root_id, void* buff, int count, int elem_size, coll_op_t op);
+void coll_allreduce(comm_node_t node, int gid, void* buff, int count, int elem_size, coll_op_t op);
+void coll_reduce_scatter(comm_node_t node, int gid, void* buff, int count, int elem_size, coll_op_t op);
+void coll_allgather(comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int len);
+void coll_alltoall(comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int len);
+
+int coll_hier_create(comm_node_t node, int gid, const int* clusters, int nclusters, const int* leaders);
+void coll_hier_bcast(comm_node_t node, int gid, int root_id, void* buff, int len);
+void coll_hier_allreduce(comm_node_t node, int gid, void* buff, int count, int elem_size, coll_op_t op);
+void coll_hier_alltoall(comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int len);
+
+#endif // __COLL_H__
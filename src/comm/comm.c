@@ -1,13 +1,17 @@
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <math.h>
 #include <sys/time.h>
 #include <assert.h>
 
 #include <std/std.h>
+#include <std/bytes.h>
 #include <struct/rtable.h>
 #include "impl/ioman.h"
 #include "impl/msg.h"
 #include "impl/comm.h"
+#include "impl/reroute.h"
 
 static int
 Max(int x, int y){
@@ -69,12 +73,74 @@ send_buffer_monitor(void* _node){
 
 #endif // COMM_MONITOR_RECV_BAND
 
+static comm_group_t
+comm_group_create(const int* members, int n){
+  comm_group_t g = std_malloc(sizeof(comm_group));
+  int i;
+
+  g -> size = n;
+  g -> members = std_malloc(sizeof(int) * n);
+  g -> is_member = std_calloc(COMM_MAX_PEER, sizeof(char));
+  for(i = 0; i < n; i++){
+    assert(members[i] >= 0 && members[i] < COMM_MAX_PEER);
+    g -> members[i] = members[i];
+    g -> is_member[members[i]] = 1;
+  }
+  g -> ring = NULL;
+  g -> coll_seq = 0;
+  g -> a2a_nphases = 0;
+  g -> a2a_to = NULL;
+  g -> a2a_from = NULL;
+  g -> hier_nclusters = 0;
+  g -> hier_cluster = NULL;
+  g -> hier_gids = NULL;
+  g -> hier_leaders = -1;
+  g -> replaced = NULL;
+  return g;
+}
+
+static void
+comm_group_destroy(comm_group_t g){
+  std_free(g -> members);
+  std_free(g -> is_member);
+  if(g -> ring != NULL)
+    std_free(g -> ring);
+  if(g -> a2a_to != NULL){
+    std_free(g -> a2a_to);
+    std_free(g -> a2a_from);
+  }
+  if(g -> hier_nclusters > 0){
+    std_free(g -> hier_cluster);
+    std_free(g -> hier_gids);
+  }
+  if(g -> replaced != NULL)
+    comm_group_destroy(g -> replaced);
+  std_free(g);
+}
+
+/* make members COMM_GROUP_ALL. the lock must be held. */
+/* the new group is flat: a split by coll_hier_create() has to be made again */
+static void
+comm_node_replace_group_all(comm_node_t node, const int* members, int n){
+  comm_group_t g = comm_group_create(members, n);
+
+  g -> replaced = node -> groups[COMM_GROUP_ALL];
+  node -> groups[COMM_GROUP_ALL] = g;
+}
+
 comm_node_t
 comm_node_create(int node_id){
-  int idx;
+  return comm_node_create_with_io(node_id, COMM_IO_SELECT);
+}
+
+/* io_backend is COMM_IO_SELECT or COMM_IO_URING, */
+/* the latter falls back to select if the kernel lacks io_uring */
+comm_node_t
+comm_node_create_with_io(int node_id, int io_backend){
+  int idx, i;
   comm_node_t node = (comm_node_t)std_malloc(sizeof(comm_node));
   node -> node_id = node_id;
-  node -> man = ioman_create(node_id, node, COMM_MAX_PEER);
+  node -> man = ioman_create(node_id, node, COMM_MAX_PEER, io_backend);
 
   node -> pending_conns = channel_hash_map_create(COMM_HASH_SIZE);
 
@@ -83,11 +149,28 @@ comm_node_create(int node_id){
 
   for(idx = 0; idx < COMM_MAX_PEER; idx++){
     node -> rtts[idx] = 0.0;
+    node -> link_widths[idx] = 0.0f;
+    node -> path_bw[idx] = 0.0;
+    node -> path_rr[idx] = 0;
+    node -> cong_echo_rr[idx] = 0;
+    for(i = 0; i < COMM_MAX_PATHS; i++){
+      node -> cong_rx[idx][i] = -1;
+      node -> cong_tx[idx][i].level = 0;
+      node -> cong_tx[idx][i].time = 0.0;
+    }
     node -> rts[idx] = NULL;
   }
   node -> num_rts = 0;
+  node -> reroute = NULL;
+  node -> wave_kind = 0;
+  node -> wave_pid = -1;
+
+  for(idx = 0; idx < COMM_MAX_GROUPS; idx++)
+    node -> groups[idx] = NULL;
+  node -> num_groups = 1; /* COMM_GROUP_ALL is set when routing tables are exchanged */
 
   node -> data_msg_chunk_size = COMM_DATA_CHUNK_SIZE;
+  node -> chunk_policy = COMM_DEFAULT_CHUNK_POLICY;
   node -> data_msg_sid = 0;
 
   node -> data_msg_recvd = 0;
@@ -95,10 +178,23 @@ comm_node_create(int node_id){
   node -> max_width = 0;
   node -> min_width = INT_MAX;
   
-  node -> data_msg_map = data_msg_hash_map_create(COMM_HASH_SIZE);
+  node -> data_msg_map = data_msg_open_map_create(COMM_HASH_SIZE);
   node -> recvd_data_msg_queues = (data_msg_list_t*) std_calloc(COMM_MAX_PEER, sizeof(data_msg_list_t));
+  node -> recvd_tagged_queues = (data_msg_list_t*) std_calloc(COMM_MAX_PEER, sizeof(data_msg_list_t));
+
+  node -> flows_rx = open_map_create(COMM_HASH_SIZE);
+  node -> acks = (comm_acks_t) std_calloc(COMM_MAX_PEER, sizeof(comm_acks));
+  node -> ack_srcs = (int*) std_malloc(sizeof(int) * COMM_MAX_PEER);
+  node -> nack_srcs = 0;
 
   node -> recvd_bytes = 0;
+
+  node -> aggr_on = 0;
+  node -> aggrs = NULL;
+  node -> aggr_pending = 0;
+  std_pthread_mutex_init(&node -> aggr_lock, NULL);
+  std_pthread_cond_init(&node -> aggr_cond, NULL);
+
   /* start bandwidth monitor */
 #if COMM_MONITOR_RECV_BAND
   node -> monitor_run = 1;
@@ -113,8 +209,13 @@ comm_node_create(int node_id){
 void
 comm_node_destroy(comm_node_t node){
   int idx;
+  long h;
+  comm_flow_rx_t flow;
   data_msg_t unread_msg;
   data_msg_list_t msg_queue;
+
+  /* send out what is still packed */
+  comm_node_set_aggregation(node, 0);
   
   ioman_stop(node -> man);
   ioman_destroy(node -> man);
@@ -122,14 +223,19 @@ comm_node_destroy(comm_node_t node){
   std_pthread_mutex_destroy(&node -> lock);
   std_pthread_cond_destroy(&node -> cond);
 
+  if(node -> reroute != NULL)
+    reroute_destroy(node -> reroute, node);
   for(idx = 0; idx < COMM_MAX_PEER; ++ idx){
     if(node -> rts[idx] != NULL){
       overlay_rtable_destroy(node -> rts[idx]);
       node -> rts[idx] = NULL;
     }
   }
+  for(idx = 0; idx < node -> num_groups; ++ idx)
+    if(node -> groups[idx] != NULL)
+      comm_group_destroy(node -> groups[idx]);
   
-  data_msg_hash_map_destroy(node -> data_msg_map);
+  data_msg_open_map_destroy(node -> data_msg_map);
 
   /* clean up all unread received messages */
   for(idx = 0; idx < COMM_MAX_PEER; ++idx){
@@ -143,6 +249,43 @@ comm_node_destroy(comm_node_t node){
     }
   }
   std_free(node -> recvd_data_msg_queues);
+  for(idx = 0; idx < COMM_MAX_PEER; ++idx){
+    msg_queue = node -> recvd_tagged_queues[idx];
+    if(msg_queue){
+      while(data_msg_list_size(msg_queue))
+	std_free(data_msg_destroy(data_msg_list_pop(msg_queue)));
+      data_msg_list_destroy(msg_queue);
+    }
+  }
+  std_free(node -> recvd_tagged_queues);
+
+  for(h = 0; h < node -> flows_rx -> size; h++){
+    if((flow = node -> flows_rx -> cells[h].data) != NULL){
+      open_map_destroy(flow -> done);
+      std_free(flow);
+    }
+  }
+  open_map_destroy(node -> flows_rx);
+  for(idx = 0; idx < COMM_MAX_PEER; ++idx){
+    if(node -> acks[idx].sids != NULL){
+      std_free(node -> acks[idx].sids);
+      std_free(node -> acks[idx].seqs);
+    }
+  }
+  std_free(node -> acks);
+  std_free(node -> ack_srcs);
+
+  if(node -> aggrs){
+    for(idx = 0; idx < COMM_MAX_PEER; ++idx){
+      if(node -> aggrs[idx].buff)
+	std_free(node -> aggrs[idx].buff);
+      if(node -> aggrs[idx].spare)
+	std_free(node -> aggrs[idx].spare);
+    }
+    std_free(node -> aggrs);
+  }
+  std_pthread_mutex_destroy(&node -> aggr_lock);
+  std_pthread_cond_destroy(&node -> aggr_cond);
 
   /* stop bandwidth monitor */
 #if COMM_MONITOR_RECV_BAND
@@ -160,10 +303,7 @@ comm_node_listen_port(comm_node_t node){
 
 sid_t
 comm_node_get_new_sid(comm_node_t node){
-  sid_t sid;
-  std_pthread_mutex_lock(&node -> lock);
-  sid = (node -> data_msg_sid ++);
-  std_pthread_mutex_unlock(&node -> lock);
+  sid_t sid = __sync_fetch_and_add(&node -> data_msg_sid, 1);
   sid <<= 20;
 
   assert(node -> node_id < (1 << 20));
@@ -172,14 +312,14 @@ comm_node_get_new_sid(comm_node_t node){
   return sid;
 }
 
-unsigned long
-comm_node_async_connect(comm_node_t node, const char* addr, int port){
+static unsigned long
+comm_node_async_connect_to(comm_node_t node, const char* addr, int port, int stream_dst, int lane){
   unsigned long handle;
   channel_t chan;
   std_pthread_mutex_lock(&node -> lock);
 
   handle = channel_hash_map_new_key(node -> pending_conns);
-  if(ioman_new_connection(node -> man, addr, port, &chan) == IOMAN_CONNECT_ERR){
+  if(ioman_new_connection(node -> man, addr, port, stream_dst, lane, &chan) == IOMAN_CONNECT_ERR){
     chan = NULL;
     fprintf(stderr, "%d: connect failed to (%s, %d)\n", node -> node_id, addr, port);
   }
@@ -192,6 +332,41 @@ comm_node_async_connect(comm_node_t node, const char* addr, int port){
   return handle;
 }
 
+unsigned long
+comm_node_async_connect(comm_node_t node, const char* addr, int port){
+  return comm_node_async_connect_to(node, addr, port, CHANNEL_PEER_UNKNOWN, 0);
+}
+
+/* open an extra parallel stream to an already connected peer dst_id, */
+/* (addr, port) being its listen endpoint. chunks to dst_id are then */
+/* striped over all its streams. wait with comm_node_connect_wait() */
+unsigned long
+comm_node_async_connect_stream(comm_node_t node, int dst_id, const char* addr, int port){
+  assert(dst_id >= 0 && dst_id < COMM_MAX_PEER);
+  return comm_node_async_connect_to(node, addr, port, dst_id, 0);
+}
+
+/* open the connection carrying virtual lane 'lane' (1 .. COMM_MAX_LANES - 1) */
+/* to an already connected peer dst_id. hops that routing tables assign to */
+/* that lane go over it. wait with comm_node_connect_wait() */
+unsigned long
+comm_node_async_connect_lane(comm_node_t node, int dst_id, int lane, const char* addr, int port){
+  assert(dst_id >= 0 && dst_id < COMM_MAX_PEER);
+  assert(lane > 0 && lane < COMM_MAX_LANES);
+  return comm_node_async_connect_to(node, addr, port, dst_id, lane);
+}
+
+/* number of parallel streams needed to fill a link of 'width' [Mbps]: */
+/* the bandwidth-delay product with the measured RTT, divided by the */
+/* largest window one TCP stream can open */
+int
+comm_node_calc_streams(comm_node_t node, int dst_id, float width, int max_streams){
+  double bdp = width * 1e6 / 8 * node -> rtts[dst_id]; /* [B] */
+  int k = (int)(bdp / sock_max_window()) + 1;
+
+  return Max(1, Min(k, Min(max_streams, COMM_MAX_STREAMS)));
+}
+
 int
 comm_node_connect_wait(comm_node_t node, unsigned long handle, int* dst_id){
   channel_t chan;
@@ -223,13 +398,26 @@ void
 comm_node_notify_connect(comm_node_t node, channel_t chan){
   msg_info_t minfo = msg_info_create();
   
-  /* send first ping message */
+  const void* body = ioman_hostname(node -> man);
+  char lane[sizeof(int)];
+  void* p = lane;
+
+  /* send first ping message, telling where we are */
   minfo -> kind   = MSG_TYPE_PING0;
   minfo -> dst_id = -1; /* unknown at this time */
   minfo -> src_id = node -> node_id;
-  minfo -> len    = 0;
+  minfo -> len    = strlen(body) + 1;
+
+  /* or ask peer to attach this as a parallel stream, or as the lane it carries */
+  if(chan -> stream_dst != CHANNEL_PEER_UNKNOWN){
+    minfo -> kind   = MSG_TYPE_STREAM0;
+    minfo -> dst_id = chan -> stream_dst;
+    minfo -> len    = sizeof(int);
+    pack_int(&p, chan -> lane);
+    body = lane;
+  }
 
-  channel_send_msg(chan, minfo, NULL, 0);
+  channel_send_msg(chan, minfo, body, minfo -> len);
   
   msg_info_destroy(minfo);
 }
@@ -269,6 +457,28 @@ comm_node_rtt_measure_end(comm_node_t node, int dst_id){
   /* printf("%d: rtt -> %d :%.3f[ms]\n", node -> node_id, dst_id, node -> rtts[dst_id] * 1e3); */
 }
 
+/* bandwidth of the link to a neighbor, [Mbps] */
+float
+comm_node_link_width(comm_node_t node, int dst_id){
+  assert(dst_id < COMM_MAX_PEER);
+  return node -> link_widths[dst_id] > 0 ? node -> link_widths[dst_id] : COMM_DEFAULT_LINK_WIDTH;
+}
+
+/* tell the bandwidth of the link to a neighbor (e.g. from the topology XML). */
+/* socket buffers of the link, and of its streams and lanes, are sized from it: */
+/* at once if it is connected, or else once it is */
+void
+comm_node_set_link_width(comm_node_t node, int dst_id, float width){
+  assert(dst_id < COMM_MAX_PEER);
+  ioman_set_link_width(node -> man, dst_id, width);
+}
+
+/* send large chunks of links connected from now on with MSG_ZEROCOPY */
+void
+comm_node_set_zerocopy(comm_node_t node, int on){
+  ioman_set_zerocopy(node -> man, on);
+}
+
 void
 comm_node_bcast_msg(comm_node_t node, int msg_kind, const void *buff, int len){
   ioman_bcast_msg(node -> man, msg_kind, buff, len);
@@ -302,6 +512,20 @@ comm_node_register_rt(comm_node_t node, const void** buff){
   return updated;
 }
 
+/* COMM_GROUP_ALL: nodes 0 to num_peers - 1 */
+static void
+comm_node_set_group_all(comm_node_t node, int num_peers){
+  int* members = std_malloc(sizeof(int) * num_peers);
+  int pid;
+
+  for(pid = 0; pid < num_peers; pid++)
+    members[pid] = pid;
+  std_pthread_mutex_lock(&node -> lock);
+  comm_node_replace_group_all(node, members, num_peers);
+  std_pthread_mutex_unlock(&node -> lock);
+  std_free(members);
+}
+
 void
 comm_node_exchange_rt(comm_node_t node, overlay_rtable_t rt, int num_peers){
   int bufflen = overlay_rtable_pack_len(rt);
@@ -314,6 +538,7 @@ comm_node_exchange_rt(comm_node_t node, overlay_rtable_t rt, int num_peers){
   overlay_rtable_pack(rt, &p);
   assert(node -> node_id == rt -> srcpid && node -> rts[rt -> srcpid] == NULL);
   node -> rts[rt -> srcpid] = rt;
+  comm_node_set_group_all(node, num_peers);
   comm_node_bcast_msg(node, MSG_TYPE_RT, buff, bufflen);
   std_free(buff);
 
@@ -328,38 +553,482 @@ comm_node_exchange_rt(comm_node_t node, overlay_rtable_t rt, int num_peers){
 
 int
 comm_node_lookup_rt(comm_node_t node, int src_pid, int dst_pid){
+  int lane;
+  return comm_node_lookup_rt_path(node, src_pid, dst_pid, 0, &lane);
+}
+
+/* next hop as comm_node_lookup_rt(), on route number 'path' from src_pid, */
+/* and the virtual lane to take it on */
+int
+comm_node_lookup_rt_path(comm_node_t node, int src_pid, int dst_pid, int path, int *lane){
   overlay_rtable_entry_t entry;
   overlay_rtable_t rt = node -> rts[src_pid];
   int i;
   assert(rt != NULL);
   entry = overlay_rtable_get_entry(rt, dst_pid);
   assert(entry != NULL);
+  entry = overlay_rtable_entry_get_path(entry, path);
   /* go through path and find this node */
   /* next hop comes after that */
   for(i = 0; i < entry -> hops; i++){
     if(entry -> path[i] == node -> node_id){
+      *lane = entry -> lanes[i];
       return entry -> path[i + 1]; /* return next hop */
     }
   }
+  *lane = 0;
   return -1;
 }
 
+/* next hops of a multicast chunk from src_pid to group gid, that came in from from_pid */
+/* (this node itself if it is the source): where the routes from src_pid to the members */
+/* go after from_pid and this node. routes sharing a next hop share the chunk, */
+/* which goes on the lowest of their lanes, as climbing to a higher lane is always allowed */
+int
+comm_node_lookup_mcast(comm_node_t node, int gid, int src_pid, int from_pid, int *nexts, int *lanes){
+  comm_group_t g = node -> groups[gid];
+  overlay_rtable_t rt = node -> rts[src_pid];
+  overlay_rtable_entry_t entry;
+  int i, j, k, n = 0;
+
+  assert(g != NULL && rt != NULL);
+  for(k = 0; k < g -> size; k++){
+    if(g -> members[k] == src_pid)
+      continue;
+    entry = overlay_rtable_get_entry(rt, g -> members[k]);
+    assert(entry != NULL);
+    for(i = 0; i < entry -> hops; i++)
+      if(entry -> path[i] == node -> node_id)
+	break;
+    if(i == entry -> hops) /* not through this node */
+      continue;
+    if((i == 0 && from_pid != node -> node_id) || (i > 0 && entry -> path[i - 1] != from_pid))
+      continue;
+
+    for(j = 0; j < n && nexts[j] != entry -> path[i + 1]; j++);
+    if(j == n){
+      nexts[n] = entry -> path[i + 1];
+      lanes[n ++] = entry -> lanes[i];
+    }else if(entry -> lanes[i] < lanes[j])
+      lanes[j] = entry -> lanes[i];
+  }
+  return n;
+}
+
+int
+comm_node_group_member(comm_node_t node, int gid, int pid){
+  return node -> groups[gid] != NULL && node -> groups[gid] -> is_member[pid];
+}
+
+static void
+comm_node_set_peer_hostname(channel_t chan, const msg_info_t msg_info, const void* rawbuff){
+  if(msg_info -> len == 0)
+    return;
+  strncpy(chan -> peer_hostname, rawbuff, CHANNEL_HOSTNAME_LEN - 1);
+  chan -> peer_hostname[CHANNEL_HOSTNAME_LEN - 1] = '\0';
+}
+
+#if COMM_USE_SHM
+/* connector of a link to a peer on the same host: */
+/* offer a shared memory segment to carry the link instead of loopback TCP. */
+/* SHM0 (offer) -> SHM1 (accepted, acceptor sends on shm after this) */
+/* -> SHM2 (connector sends on shm after this) */
+static void
+comm_node_shm_offer(comm_node_t node, channel_t chan){
+  const char* name;
+
+  if(chan -> peer_hostname[0] == '\0' || strcmp(chan -> peer_hostname, ioman_hostname(node -> man)) != 0)
+    return;
+
+  if((name = sock_shm_create(channel_get_sock(chan))) != NULL)
+    ioman_reply_msg(node -> man, chan, MSG_TYPE_SHM0, name, strlen(name) + 1);
+}
+#endif // COMM_USE_SHM
+
+/* the link between u and v is gone: reroute what took it, from every source, */
+/* and let the others know. called on the ioman thread */
+void
+comm_node_link_down(comm_node_t node, int u, int v){
+  int buff[2];
+  void* p = buff;
+
+  /* before the routes are all known nothing needs rerouting */
+  if(node -> groups[COMM_GROUP_ALL] == NULL || node -> num_rts < node -> groups[COMM_GROUP_ALL] -> size)
+    return;
+  if(node -> reroute == NULL)
+    node -> reroute = reroute_create(node);
+  if(!reroute_link_down(node -> reroute, node, u, v))
+    return;
+  ioman_resend(node -> man);
+
+  pack_int(&p, u);
+  pack_int(&p, v);
+  comm_node_bcast_msg(node, MSG_TYPE_LINKDOWN, buff, sizeof(buff));
+}
+
+/* COMM_GROUP_ALL with pid added, or removed. the lock must be held */
+static void
+comm_node_update_group_all(comm_node_t node, int pid, int add){
+  comm_group_t g = node -> groups[COMM_GROUP_ALL];
+  int* members = std_malloc(sizeof(int) * (g -> size + 1));
+  int i, n = 0;
+
+  for(i = 0; i < g -> size; i++)
+    if(g -> members[i] != pid)
+      members[n ++] = g -> members[i];
+  if(add)
+    members[n ++] = pid;
+  comm_node_replace_group_all(node, members, n);
+  std_free(members);
+}
+
+/* whether a route may be extended to a node that joined: it takes no failed */
+/* link, or it does not matter as one end left. routes that could not be */
+/* changed around failed links are left in place */
+static int
+comm_node_route_usable(comm_node_t node, int src, int dst, overlay_rtable_entry_t e){
+  if(node -> reroute == NULL || !reroute_entry_dead(node -> reroute, e))
+    return 1;
+  return !comm_node_group_member(node, COMM_GROUP_ALL, src) || !comm_node_group_member(node, COMM_GROUP_ALL, dst);
+}
+
+/* route from src to the node pid that joined, through its neighbor nearest to src. */
+/* NULL if no neighbor has a usable route from src */
+static overlay_rtable_entry_t
+comm_node_route_to_joined(comm_node_t node, int src, int pid, const int* nbrs, int nnbrs){
+  overlay_rtable_entry_t e, best = NULL, route;
+  int i, hops, *path, *lanes, direct = 0;
+
+  for(i = 0; i < nnbrs; i++){
+    if(nbrs[i] == src){
+      best = NULL;
+      direct = 1;
+      break;
+    }
+    e = overlay_rtable_get_entry(node -> rts[src], nbrs[i]);
+    if(comm_node_route_usable(node, src, nbrs[i], e) && (best == NULL || e -> hops < best -> hops))
+      best = e;
+  }
+  if(best == NULL && !direct)
+    return NULL;
+
+  hops = best != NULL ? best -> hops + 1 : 1;
+  path = std_malloc(sizeof(int) * (hops + 1));
+  lanes = std_calloc(hops, sizeof(int));
+  path[0] = src;
+  if(best != NULL){
+    std_memcpy(path, best -> path, sizeof(int) * (best -> hops + 1));
+    std_memcpy(lanes, best -> lanes, sizeof(int) * best -> hops);
+  }
+  path[hops] = pid;
+  route = overlay_rtable_entry_create(pid, path, hops, best != NULL ? best -> metric + 1 : 1,
+				      best != NULL ? best -> width : node -> max_width);
+  overlay_rtable_entry_set_lanes(route, lanes);
+  std_free(path);
+  std_free(lanes);
+  return route;
+}
+
+/* route from the node pid that joined to dst, through its neighbor nearest to dst. */
+/* NULL if no neighbor has a usable route to dst */
+static overlay_rtable_entry_t
+comm_node_route_from_joined(comm_node_t node, int pid, int dst, const int* nbrs, int nnbrs){
+  overlay_rtable_entry_t e, best = NULL, route;
+  int i, hops, *path, *lanes, direct = 0;
+
+  for(i = 0; i < nnbrs; i++){
+    if(nbrs[i] == dst){
+      best = NULL;
+      direct = 1;
+      break;
+    }
+    e = overlay_rtable_get_entry(node -> rts[nbrs[i]], dst);
+    if(comm_node_route_usable(node, nbrs[i], dst, e) && (best == NULL || e -> hops < best -> hops))
+      best = e;
+  }
+  if(best == NULL && !direct)
+    return NULL;
+
+  hops = best != NULL ? best -> hops + 1 : 1;
+  path = std_malloc(sizeof(int) * (hops + 1));
+  lanes = std_calloc(hops, sizeof(int));
+  path[0] = pid;
+  path[1] = dst;
+  if(best != NULL){
+    std_memcpy(path + 1, best -> path, sizeof(int) * (best -> hops + 1));
+    std_memcpy(lanes + 1, best -> lanes, sizeof(int) * best -> hops);
+  }
+  route = overlay_rtable_entry_create(dst, path, hops, best != NULL ? best -> metric + 1 : 1,
+				      best != NULL ? best -> width : node -> max_width);
+  overlay_rtable_entry_set_lanes(route, lanes);
+  std_free(path);
+  std_free(lanes);
+  return route;
+}
+
+/* node pid joined with links to nbrs. it is placed below all of them, like a leaf */
+/* added to the up/down order (or on levels of its own under ordered links): */
+/* routes to it end with one of its links and its routes start with one, */
+/* so no route or channel dependency there was changes, and it relays nothing */
+/* until routes are computed anew. every node works out the same routes, */
+/* and the same answer: -1, with nothing changed, if some member cannot */
+/* reach pid or be reached from it but over failed links */
+static int
+comm_node_add_peer(comm_node_t node, int pid, const int* nbrs, int nnbrs){
+  overlay_rtable_entry_t* to = std_calloc(pid + 1, sizeof(overlay_rtable_entry_t));
+  overlay_rtable_entry_t from;
+  overlay_rtable_t rt;
+  int s, ok = 1;
+
+  assert(pid == node -> num_rts && pid < COMM_MAX_PEER && nnbrs > 0);
+  rt = overlay_rtable_create(pid, pid + 1);
+  for(s = 0; s < pid && ok; s++){
+    to[s] = comm_node_route_to_joined(node, s, pid, nbrs, nnbrs);
+    if((from = comm_node_route_from_joined(node, pid, s, nbrs, nnbrs)) != NULL)
+      overlay_rtable_add_entry(rt, from);
+    ok = to[s] != NULL && from != NULL;
+  }
+  if(!ok){
+    for(s = 0; s < pid; s++)
+      if(to[s] != NULL)
+	overlay_rtable_entry_destroy(to[s]);
+    overlay_rtable_destroy(rt);
+    std_free(to);
+    return -1;
+  }
+  for(s = 0; s < pid; s++){
+    overlay_rtable_grow(node -> rts[s], pid + 1);
+    overlay_rtable_add_entry(node -> rts[s], to[s]);
+  }
+  std_free(to);
+
+  std_pthread_mutex_lock(&node -> lock);
+  node -> rts[pid] = rt;
+  node -> num_rts ++;
+  if(node -> reroute != NULL)
+    node -> reroute = reroute_renew(node -> reroute, node);
+  comm_node_update_group_all(node, pid, 1);
+  std_pthread_mutex_unlock(&node -> lock);
+  return 0;
+}
+
+/* node pid is leaving: routes go around it as around failed links */
+static void
+comm_node_remove_peer(comm_node_t node, int pid){
+  if(node -> reroute == NULL)
+    node -> reroute = reroute_create(node);
+  reroute_node_down(node -> reroute, node, pid);
+  ioman_forget_peer(node -> man, pid);
+
+  std_pthread_mutex_lock(&node -> lock);
+  comm_node_update_group_all(node, pid, 0);
+  std_pthread_mutex_unlock(&node -> lock);
+}
+
+/* hand the node pid that joined all routing tables, and the members of COMM_GROUP_ALL */
+static void
+comm_node_sync_joined(comm_node_t node, int pid){
+  comm_group_t g = node -> groups[COMM_GROUP_ALL];
+  void *buff, *p;
+  int s, len;
+
+  for(s = 0; s <= pid; s++){
+    len = overlay_rtable_pack_len(node -> rts[s]);
+    p = buff = std_malloc(len);
+    overlay_rtable_pack(node -> rts[s], &p);
+    ioman_send_msg(node -> man, MSG_TYPE_RTCOPY, pid, buff, len);
+    std_free(buff);
+  }
+
+  len = sizeof(int) * (g -> size + 1);
+  p = buff = std_malloc(len);
+  pack_int(&p, g -> size);
+  for(s = 0; s < g -> size; s++)
+    pack_int(&p, g -> members[s]);
+  ioman_send_msg(node -> man, MSG_TYPE_MEMBERS, pid, buff, len);
+  std_free(buff);
+}
+
+/* a join or leave is announced by an echo wave: a node passes the first notice */
+/* it gets on to its other neighbors, and answers the neighbor it got it from */
+/* once it heard from all of them. so the node announcing knows every node took */
+/* the change, once it heard back from each of its neighbors. */
+/* the notice is (pid, num. of neighbors, neighbors) */
+static void
+comm_node_handle_wave(comm_node_t node, int from, int kind, const void* buff, int len){
+  const void* p = buff;
+  int pid = unpack_int(&p), nnbrs = unpack_int(&p);
+  int *nbrs = std_malloc(sizeof(int) * (nnbrs + 1)), *links = std_malloc(sizeof(int) * COMM_MAX_PEER);
+  int i, nlinks;
+
+  for(i = 0; i < nnbrs; i++)
+    nbrs[i] = unpack_int(&p);
+
+  if(node -> wave_kind != kind || node -> wave_pid != pid){
+    node -> wave_kind = kind;
+    node -> wave_pid = pid;
+    node -> wave_parent = from;
+    node -> wave_count = 0;
+    if(kind == MSG_TYPE_JOIN){
+      if(comm_node_add_peer(node, pid, nbrs, nnbrs) == -1){
+	if(nbrs[0] == node -> node_id)
+	  fprintf(stderr, "%d: node %d cannot join, some members are cut off from its neighbors\n", node -> node_id, pid);
+      }else if(nbrs[0] == node -> node_id) /* sent before the answer to pid, so they come first */
+	comm_node_sync_joined(node, pid);
+    }else
+      comm_node_remove_peer(node, pid);
+
+    nlinks = ioman_links(node -> man, links);
+    for(i = 0; i < nlinks; i++)
+      if(links[i] != from)
+	ioman_send_msg(node -> man, kind, links[i], buff, len);
+  }
+
+  nlinks = ioman_links(node -> man, links);
+  std_pthread_mutex_lock(&node -> lock);
+  if(++ node -> wave_count == nlinks){
+    /* every link carried one notice or answer each way, nothing more comes. */
+    /* a node whose join failed may try again under the same id */
+    node -> wave_kind = 0;
+    if(node -> wave_parent == -1)
+      std_pthread_cond_broadcast(&node -> cond);
+    else
+      ioman_send_msg(node -> man, kind, node -> wave_parent, buff, len);
+  }
+  std_pthread_mutex_unlock(&node -> lock);
+
+  std_free(nbrs);
+  std_free(links);
+}
+
+/* announce a join or leave of this node to its neighbors, and wait for their answers */
+static void
+comm_node_start_wave(comm_node_t node, int kind){
+  int *links = std_malloc(sizeof(int) * COMM_MAX_PEER);
+  int nlinks = ioman_links(node -> man, links);
+  int i, len = sizeof(int) * (nlinks + 2);
+  void *buff = std_malloc(len), *p = buff;
+
+  assert(nlinks > 0);
+  pack_int(&p, node -> node_id);
+  pack_int(&p, kind == MSG_TYPE_JOIN ? nlinks : 0);
+  for(i = 0; kind == MSG_TYPE_JOIN && i < nlinks; i++)
+    pack_int(&p, links[i]);
+
+  std_pthread_mutex_lock(&node -> lock);
+  node -> wave_kind = kind;
+  node -> wave_pid = node -> node_id;
+  node -> wave_parent = -1;
+  node -> wave_count = 0;
+  std_pthread_mutex_unlock(&node -> lock);
+
+  for(i = 0; i < nlinks; i++)
+    ioman_send_msg(node -> man, kind, links[i], buff, (char*)p - (char*)buff);
+
+  std_pthread_mutex_lock(&node -> lock);
+  while(node -> wave_count < nlinks)
+    std_pthread_cond_wait(&node -> cond, &node -> lock);
+  std_pthread_mutex_unlock(&node -> lock);
+
+  std_free(buff);
+  std_free(links);
+}
+
+/* join a running overlay, instead of comm_node_exchange_rt(). the node must be */
+/* connected to its neighbors-to-be, and its id must be the number of nodes so far */
+/* (including any that left). returns 0 once every node routes to and from it, */
+/* or -1 if some member could only be reached over failed links: nothing changed, */
+/* and the node is destroyed or joins again with other neighbors. */
+/* groups other than COMM_GROUP_ALL must be created again, in the same order as */
+/* on the other nodes, and COMM_GROUP_ALL split again if coll_hier_create() had */
+/* split it, on every node. one node may join or leave at a time */
+int
+comm_node_join(comm_node_t node){
+  int joined;
+
+  comm_node_start_wave(node, MSG_TYPE_JOIN);
+
+  /* the tables came before the answer of the neighbor sending them, */
+  /* none came if the others did not take this node */
+  std_pthread_mutex_lock(&node -> lock);
+  joined = node -> num_rts == node -> node_id + 1;
+  assert(!joined || node -> groups[COMM_GROUP_ALL] != NULL);
+  std_pthread_mutex_unlock(&node -> lock);
+  return joined ? 0 : -1;
+}
+
+/* stop being routed through, and be dropped from COMM_GROUP_ALL, */
+/* which the others then have to split again as after comm_node_join(). */
+/* returns once every node routes around this one; chunks already on their way */
+/* through it are still relayed, until it is destroyed */
+void
+comm_node_leave(comm_node_t node){
+  comm_node_start_wave(node, MSG_TYPE_LEAVE);
+}
+
+/* a barrier signal reached this node: pass it on towards its destination, */
+/* or deliver it as a one byte message tagged as when it was sent */
+static void
+comm_node_handle_barrier(comm_node_t node, const void* buff, int len){
+  const void* p = buff;
+  int src_id = unpack_int(&p);
+  int dst_id = unpack_int(&p);
+  int tag = unpack_int(&p);
+  data_msg_t msg;
+
+  if(dst_id != node -> node_id){
+    ioman_send_msg(node -> man, MSG_TYPE_BARRIER, comm_node_lookup_rt(node, node -> node_id, dst_id), buff, len);
+    return;
+  }
+
+  msg = data_msg_create(1, src_id, get_curr_time());
+  *(char*)msg -> user_msg_data = 0;
+  msg -> tag = tag;
+  comm_node_deliver_chunk(node, msg);
+}
+
+/* acknowledgements of chunks reached this node: pass them on towards */
+/* the source of the chunks, or let it forget those. */
+/* the message is (from, to, n) and n times (sid, seq) */
+static void
+comm_node_handle_acks(comm_node_t node, const void* buff, int len){
+  const void* p = buff;
+  int from = unpack_int(&p);
+  int to = unpack_int(&p);
+  int i, n = unpack_int(&p);
+  sid_t sid;
+
+  /* dropped if the route is cut, the chunks are sent again and acknowledged again */
+  if(to != node -> node_id){
+    ioman_try_send_msg(node -> man, MSG_TYPE_ACK, comm_node_lookup_rt(node, node -> node_id, to), buff, len);
+    return;
+  }
+  for(i = 0; i < n; i++){
+    sid = unpack_uint64(&p);
+    ioman_ack_chunk(node -> man, from, sid, unpack_int(&p));
+  }
+}
+
 void
 comm_node_handle_msg(comm_node_t node, channel_t chan, const msg_info_t msg_info, const msg_buff_t buff){
   int src_id = msg_info -> src_id;
   const void* rawbuff = *msg_buff_head(buff);
+  const char* hostname = ioman_hostname(node -> man);
+  int ok;
   switch(msg_info -> kind){
   case MSG_TYPE_PING0: /* acceptor */
     //printf("%d: got PING0\n", node -> node_id);fflush(stdout);
     ioman_register_channel(node -> man, src_id, chan); /* register peer id */
+    comm_node_set_peer_hostname(chan, msg_info, rawbuff);
     
     comm_node_rtt_measure_start(node, src_id);
     /* send ping */
-    ioman_send_msg(node -> man, MSG_TYPE_PING1, src_id, NULL, 0);
+    ioman_send_msg(node -> man, MSG_TYPE_PING1, src_id, hostname, strlen(hostname) + 1);
     break;
   case MSG_TYPE_PING1: /* connector */
     //printf("%d: got PING1\n", node -> node_id);fflush(stdout);
     ioman_register_channel(node -> man, src_id, chan); /* register peer id */
+    comm_node_set_peer_hostname(chan, msg_info, rawbuff);
     comm_node_rtt_measure_start(node, src_id);
     /* send pong */
     ioman_send_msg(node -> man, MSG_TYPE_PONG0, src_id, NULL, 0);
@@ -367,21 +1036,86 @@ comm_node_handle_msg(comm_node_t node, channel_t chan, const msg_info_t msg_info
   case MSG_TYPE_PONG0: /* acceptor */
     //printf("%d: got P0NG0\n", node -> node_id);fflush(stdout);
     comm_node_rtt_measure_end(node, src_id);
+    ioman_tune_link(node -> man, src_id);
     /* send pong */
     ioman_send_msg(node -> man, MSG_TYPE_PONG1, src_id, NULL, 0);
     break;
   case MSG_TYPE_PONG1: /* connector */
     //printf("%d: got P0NG1\n", node -> node_id);fflush(stdout);
     comm_node_rtt_measure_end(node, src_id);
+    ioman_tune_link(node -> man, src_id);
 
     /* connection process completes here */
     comm_node_notify_success(node, chan);
+#if COMM_USE_SHM
+    comm_node_shm_offer(node, chan);
+#endif
+    break;
+  case MSG_TYPE_STREAM0: /* acceptor */
+    chan -> lane = unpack_int(&rawbuff);
+    ioman_register_stream(node -> man, src_id, chan);
+    ioman_tune_link(node -> man, src_id);
+    ioman_reply_msg(node -> man, chan, MSG_TYPE_STREAM1, NULL, 0);
+    break;
+  case MSG_TYPE_STREAM1: /* connector */
+    ioman_register_stream(node -> man, src_id, chan);
+    ioman_tune_link(node -> man, src_id);
+    comm_node_notify_success(node, chan);
+    break;
+  case MSG_TYPE_SHM0: /* acceptor */
+    ok = sock_shm_attach(channel_get_sock(chan), rawbuff) == SOCK_CONNECT_OK;
+    ioman_reply_msg(node -> man, chan, MSG_TYPE_SHM1, &ok, sizeof(int));
+    if(ok)
+      channel_shm_switch_tx(chan);
+    break;
+  case MSG_TYPE_SHM1: /* connector */
+    if(unpack_int(&rawbuff)){
+      ioman_shm_start_rx(node -> man, chan);
+      ioman_reply_msg(node -> man, chan, MSG_TYPE_SHM2, NULL, 0);
+      channel_shm_switch_tx(chan);
+    }else
+      sock_shm_abort(channel_get_sock(chan));
+    break;
+  case MSG_TYPE_SHM2: /* acceptor */
+    ioman_shm_start_rx(node -> man, chan);
     break;
   case MSG_TYPE_RT:
     if(comm_node_register_rt(node, &rawbuff)){
       comm_node_bcast_msg(node, MSG_TYPE_RT, *msg_buff_head(buff), msg_buff_len(buff));
     }
     break;
+  case MSG_TYPE_JOIN:
+  case MSG_TYPE_LEAVE:
+    comm_node_handle_wave(node, src_id, msg_info -> kind, rawbuff, msg_buff_len(buff));
+    break;
+  case MSG_TYPE_RTCOPY:
+    comm_node_register_rt(node, &rawbuff);
+    break;
+  case MSG_TYPE_MEMBERS:
+    {
+      int i, n = unpack_int(&rawbuff);
+      int* members = std_malloc(sizeof(int) * (n + 1));
+      for(i = 0; i < n; i++)
+	members[i] = unpack_int(&rawbuff);
+      std_pthread_mutex_lock(&node -> lock);
+      comm_node_replace_group_all(node, members, n);
+      std_pthread_mutex_unlock(&node -> lock);
+      std_free(members);
+    }
+    break;
+  case MSG_TYPE_LINKDOWN:
+    {
+      int u = unpack_int(&rawbuff);
+      int v = unpack_int(&rawbuff);
+      comm_node_link_down(node, u, v);
+    }
+    break;
+  case MSG_TYPE_BARRIER:
+    comm_node_handle_barrier(node, rawbuff, msg_buff_len(buff));
+    break;
+  case MSG_TYPE_ACK:
+    comm_node_handle_acks(node, rawbuff, msg_buff_len(buff));
+    break;
   default:
     fprintf(stderr, "comm_node_handle_msg: unknown msg type: ");
     msg_info_print(msg_info);
@@ -393,7 +1127,7 @@ comm_node_handle_msg(comm_node_t node, channel_t chan, const msg_info_t msg_info
 /* comm_node_handle_chunk_header(comm_node_t node, channel_t chan, const msg_info_t header){ */
 /*   double t; */
 /*   int sid = header -> sid; */
-/*   data_msg_t data = data_msg_hash_map_find(node -> data_msg_map, sid); */
+/*   data_msg_t data = data_msg_open_map_find(node -> data_msg_map, sid); */
 
 /*   assert(sid != -1); /\* valid sid *\/ */
   
@@ -401,7 +1135,7 @@ comm_node_handle_msg(comm_node_t node, channel_t chan, const msg_info_t msg_info
 /*   if(data == NULL){ */
 /*     t = get_curr_time(); */
 /*     data = data_msg_create(header -> tot_len, header -> src_id, t); */
-/*     data_msg_hash_map_add(node -> data_msg_map, sid, data); */
+/*     data_msg_open_map_add(node -> data_msg_map, sid, data); */
 /*     /\* printf("%d: got header src: %d\n", node -> node_id, header -> src_id);fflush(stdout); *\/ */
 /*   } */
 
@@ -409,25 +1143,199 @@ comm_node_handle_msg(comm_node_t node, channel_t chan, const msg_info_t msg_info
 /*   data -> len += CHANNEL_MSG_HEADERLEN; */
 /* } */
 
-void
-comm_node_setup_chunk(comm_node_t node, channel_t chan, const msg_info_t header){
+/* keep the congestion a chunk met on its route, and what its source */
+/* reports about chunks we send to it */
+static void
+comm_node_cong_record(comm_node_t node, const msg_info_t header){
+  int path;
+
+  /* multicast chunks take no particular route */
+  if(header -> kind == MSG_TYPE_MCAST)
+    return;
+
+  if(header -> path >= 0 && header -> path < COMM_MAX_PATHS)
+    node -> cong_rx[header -> src_id][header -> path] = header -> cong;
+
+  if(header -> echo != -1 && (path = header -> echo >> 8) < COMM_MAX_PATHS){
+    node -> cong_tx[header -> src_id][path].level = header -> echo & 0xff;
+    node -> cong_tx[header -> src_id][path].time = get_curr_time();
+  }
+}
+
+/* congestion seen on one of the routes from dst_id, to piggyback on a chunk to dst_id */
+int
+comm_node_cong_echo(comm_node_t node, int dst_id){
+  int i, path;
+
+  for(i = 0; i < COMM_MAX_PATHS; i++){
+    path = node -> cong_echo_rr[dst_id] ++ % COMM_MAX_PATHS;
+    if(node -> cong_rx[dst_id][path] != -1)
+      return (path << 8) | node -> cong_rx[dst_id][path];
+  }
+  return -1;
+}
+
+static data_msg_t
+comm_node_open_data_msg(comm_node_t node, const msg_info_t header){
   double t;
   sid_t sid = header -> sid;
-  data_msg_t data = data_msg_hash_map_find(node -> data_msg_map, sid);
+  data_msg_t data = data_msg_open_map_find(node -> data_msg_map, sid);
 
   assert(sid != -1); /* valid sid */
+
+  comm_node_cong_record(node, header);
   
   /* create new data msg if new session */
   if(data == NULL){
     t = get_curr_time();
     data = data_msg_create(header -> tot_len, header -> src_id, t);
-    data_msg_hash_map_add(node -> data_msg_map, sid, data);
+    data -> tag = header -> tag;
+    data_msg_open_map_add(node -> data_msg_map, sid, data);
     /* printf("%d: got header src: %d\n", node -> node_id, header -> src_id);fflush(stdout); */
   }
+  return data;
+}
+
+/* messages received of the flow a chunk for this node belongs to, */
+/* with those its source had acknowledged when sending it forgotten */
+static comm_flow_rx_t
+comm_node_flow_rx(comm_node_t node, const msg_info_t header){
+  unsigned long gid = header -> kind == MSG_TYPE_MCAST ? header -> dst_id + 1 : 0;
+  unsigned long key = (gid << 32) | header -> src_id;
+  comm_flow_rx_t flow = open_map_find(node -> flows_rx, key);
+
+  if(flow == NULL){
+    flow = std_malloc(sizeof(comm_flow_rx));
+    flow -> next = 0;
+    flow -> done = open_map_create(COMM_HASH_SIZE);
+    open_map_add(node -> flows_rx, key, flow);
+  }
+  while(flow -> next < header -> flow_acked){
+    if(open_map_size(flow -> done) == 0){
+      flow -> next = header -> flow_acked;
+      break;
+    }
+    open_map_pop(flow -> done, flow -> next ++);
+  }
+  return flow;
+}
+
+/* whether a chunk for this node was received already (DATA_MSG_CHUNK_RECVD), */
+/* is being read (DATA_MSG_CHUNK_READING), or neither: a source sends chunks */
+/* again when routes change, and both copies may come */
+static int
+comm_node_chunk_state(comm_node_t node, const msg_info_t header){
+  comm_flow_rx_t flow = comm_node_flow_rx(node, header);
+  data_msg_t data;
+
+  if(header -> flow_seq < flow -> next || open_map_find(flow -> done, header -> flow_seq) != NULL)
+    return DATA_MSG_CHUNK_RECVD;
+  if((data = data_msg_open_map_find(node -> data_msg_map, header -> sid)) == NULL)
+    return DATA_MSG_CHUNK_NONE;
+  return data_msg_chunk_state(data, header -> seq);
+}
+
+static void
+comm_node_send_acks(comm_node_t node, int src_id){
+  comm_acks_t a = &node -> acks[src_id];
+  int i, len = sizeof(int) * 3 + (sizeof(sid_t) + sizeof(int)) * a -> n;
+  void *buff, *p;
+
+  if(a -> n == 0)
+    return;
+  p = buff = std_malloc(len);
+  pack_int(&p, node -> node_id);
+  pack_int(&p, src_id);
+  pack_int(&p, a -> n);
+  for(i = 0; i < a -> n; i++){
+    pack_uint64(&p, a -> sids[i]);
+    pack_int(&p, a -> seqs[i]);
+  }
+  ioman_try_send_msg(node -> man, MSG_TYPE_ACK, comm_node_lookup_rt(node, node -> node_id, src_id), buff, len);
+  std_free(buff);
+  a -> n = 0;
+}
+
+/* let the source of a chunk received forget it, see resend_keep() */
+static void
+comm_node_ack_chunk(comm_node_t node, const msg_info_t header){
+  comm_acks_t a = &node -> acks[header -> src_id];
+
+  if(a -> sids == NULL){
+    a -> sids = std_malloc(sizeof(sid_t) * COMM_ACK_BATCH);
+    a -> seqs = std_malloc(sizeof(int) * COMM_ACK_BATCH);
+  }
+  if(!a -> listed){
+    a -> listed = 1;
+    node -> ack_srcs[node -> nack_srcs ++] = header -> src_id;
+  }
+  a -> sids[a -> n] = header -> sid;
+  a -> seqs[a -> n ++] = header -> seq;
+  if(a -> n == COMM_ACK_BATCH)
+    comm_node_send_acks(node, header -> src_id);
+}
+
+/* send the acknowledgements gathered, each source's in one message. */
+/* called by the ioman thread before it waits for more to do */
+void
+comm_node_flush_acks(comm_node_t node){
+  int i;
+
+  for(i = 0; i < node -> nack_srcs; i++){
+    comm_node_send_acks(node, node -> ack_srcs[i]);
+    node -> acks[node -> ack_srcs[i]].listed = 0;
+  }
+  node -> nack_srcs = 0;
+}
+
+/* a chunk sent again that came, or is coming, another way is read aside and */
+/* dropped, see comm_node_handle_chunk() */
+void
+comm_node_setup_chunk(comm_node_t node, channel_t chan, const msg_info_t header){
+  data_msg_t data;
+
+  if(comm_node_chunk_state(node, header) != DATA_MSG_CHUNK_NONE){
+    channel_setup_msg(chan);
+    return;
+  }
+  data = comm_node_open_data_msg(node, header);
+  data_msg_set_chunk_state(data, header -> seq, DATA_MSG_CHUNK_READING);
 
 /*   setup channel chunk using data message buffer */
 /*   writing directly to buffer will reduce copying */
-  channel_setup_chunk_with_buff(chan, data_msg_buff_tail(data));
+  channel_setup_chunk_with_buff(chan, data_msg_buff_at(data, header -> off));
+}
+
+/* a multicast chunk relayed further, that this node is also a member for: */
+/* its body is copied out of the relayed buffer */
+void
+comm_node_copy_chunk(comm_node_t node, channel_t chan, const msg_info_t header, const void* body){
+  data_msg_t data;
+  void* dst;
+
+  switch(comm_node_chunk_state(node, header)){
+  case DATA_MSG_CHUNK_RECVD:
+    comm_node_ack_chunk(node, header);
+    return;
+  case DATA_MSG_CHUNK_READING:
+    return;
+  }
+  data = comm_node_open_data_msg(node, header);
+  dst = data_msg_buff_at(data, header -> off);
+  data_msg_set_chunk_state(data, header -> seq, DATA_MSG_CHUNK_READING);
+  std_memcpy(dst, body, header -> len);
+  comm_node_handle_chunk(node, chan, header, msg_buff_create_on_buff(header -> len, dst));
+}
+
+/* the channel a chunk was being read into its message on broke: */
+/* let the copy its source sends again in */
+void
+comm_node_abort_chunk(comm_node_t node, const msg_info_t header, msg_buff_t buff){
+  data_msg_t data = data_msg_open_map_find(node -> data_msg_map, header -> sid);
+
+  if(data != NULL && buff -> data == data_msg_buff_at(data, header -> off)
+     && data_msg_chunk_state(data, header -> seq) == DATA_MSG_CHUNK_READING)
+    data_msg_set_chunk_state(data, header -> seq, DATA_MSG_CHUNK_NONE);
 }
 
 void
@@ -439,6 +1347,16 @@ comm_node_deliver_chunk(comm_node_t node, data_msg_t msg){
 
     std_pthread_mutex_lock(&node -> lock);
 
+    /* messages of collective operations are kept apart, for comm_node_recv_tagged() */
+    if(msg -> tag != 0){
+      if((msg_queue = node -> recvd_tagged_queues[msg -> src_id]) == NULL)
+	msg_queue = node -> recvd_tagged_queues[msg -> src_id] = data_msg_list_create();
+      data_msg_list_append(msg_queue, msg);
+      std_pthread_cond_broadcast(&node -> cond);
+      std_pthread_mutex_unlock(&node -> lock);
+      return;
+    }
+
     /* access message queue per source id */
     msg_queue = node -> recvd_data_msg_queues[msg -> src_id];
     if(msg_queue == NULL){
@@ -456,11 +1374,45 @@ comm_node_deliver_chunk(comm_node_t node, data_msg_t msg){
     std_pthread_mutex_unlock(&node -> lock);
 }
 
+/* split a chunk of packed small messages, and deliver each of them */
+void
+comm_node_deliver_aggr(comm_node_t node, data_msg_t aggr){
+  data_msg_list_t msg_queue;
+  data_msg_t msg;
+  const void* p = aggr -> user_msg_data;
+  const void* end = p + aggr -> len;
+  int len;
+
+  std_pthread_mutex_lock(&node -> lock);
+
+  msg_queue = node -> recvd_data_msg_queues[aggr -> src_id];
+  if(msg_queue == NULL){
+    msg_queue = data_msg_list_create();
+    node -> recvd_data_msg_queues[aggr -> src_id] = msg_queue;
+  }
+
+  while(p < end){
+    len = unpack_int(&p);
+    assert(len > 0 && p + len <= end);
+    msg = data_msg_create(len, aggr -> src_id, aggr -> start_time);
+    std_memcpy(msg -> user_msg_data, p, len);
+    p += len;
+
+    data_msg_list_append(msg_queue, msg);
+    ++ node -> data_msg_unacked_recvd;
+    ++ node -> data_msg_recvd;
+  }
+
+  std_pthread_cond_broadcast(&node -> cond);
+  std_pthread_mutex_unlock(&node -> lock);
+
+  std_free(data_msg_destroy(aggr));
+}
+
 void
 comm_node_recv_data(comm_node_t node, int src_id, void** buff, int* buffsize){
   data_msg_t msg = 0;
   data_msg_list_t msg_queue = 0;
-  buff = 0;
 
   std_pthread_mutex_lock(&node -> lock);
 
@@ -486,6 +1438,34 @@ comm_node_recv_data(comm_node_t node, int src_id, void** buff, int* buffsize){
   return;
 }
 
+/* wait for the message with the given tag from src_id, */
+/* messages of collective operations may complete in any order */
+void
+comm_node_recv_tagged(comm_node_t node, int src_id, int tag, void** buff, int* buffsize){
+  data_msg_list_t msg_queue;
+  data_msg_list_cell_t cell;
+  data_msg_t msg = NULL;
+
+  std_pthread_mutex_lock(&node -> lock);
+  while(msg == NULL){
+    if((msg_queue = node -> recvd_tagged_queues[src_id]) != NULL){
+      for(cell = data_msg_list_head(msg_queue); cell != data_msg_list_end(msg_queue); cell = data_msg_list_cell_next(cell)){
+	if(data_msg_list_cell_data(cell) -> tag == tag){
+	  msg = data_msg_list_cell_data(cell);
+	  data_msg_list_remove(msg_queue, cell);
+	  break;
+	}
+      }
+    }
+    if(msg == NULL)
+      std_pthread_cond_wait(&node -> cond, &node -> lock);
+  }
+  std_pthread_mutex_unlock(&node -> lock);
+
+  *buffsize = msg -> len;
+  *buff = data_msg_destroy(msg);
+}
+
 void
 comm_node_recv_any_data(comm_node_t node, int* src_id, void** buff, int* buffsize){
   int tmp_nodeid;
@@ -523,6 +1503,18 @@ comm_node_recv_any_data(comm_node_t node, int* src_id, void** buff, int* buffsiz
   return;
 }
 
+/* the message of a chunk was received in full */
+static void
+comm_node_flow_done(comm_node_t node, const msg_info_t header){
+  comm_flow_rx_t flow = comm_node_flow_rx(node, header);
+
+  if(header -> flow_seq < flow -> next)
+    return;
+  open_map_add(flow -> done, header -> flow_seq, flow);
+  while(open_map_pop(flow -> done, flow -> next) != NULL)
+    flow -> next ++;
+}
+
 void
 comm_node_handle_chunk(comm_node_t node, channel_t chan, const msg_info_t header, const msg_buff_t chunk){
   sid_t sid = header -> sid;
@@ -530,8 +1522,16 @@ comm_node_handle_chunk(comm_node_t node, channel_t chan, const msg_info_t header
   double dt;
 
   assert(sid != -1); /* valid sid */
-  data = data_msg_hash_map_find(node -> data_msg_map, sid);
-  assert(data != NULL); /* should have been created by handle_chunk_header */
+  data = data_msg_open_map_find(node -> data_msg_map, sid);
+
+  /* a copy read aside, see comm_node_setup_chunk() */
+  if(data == NULL || chunk -> data != data_msg_buff_at(data, header -> off)){
+    if(comm_node_chunk_state(node, header) == DATA_MSG_CHUNK_RECVD)
+      comm_node_ack_chunk(node, header);
+    msg_buff_destroy(chunk);
+    return;
+  }
+  comm_node_ack_chunk(node, header);
 
   node -> recvd_bytes += msg_buff_len(chunk); /* for stats */
 
@@ -539,52 +1539,398 @@ comm_node_handle_chunk(comm_node_t node, channel_t chan, const msg_info_t header
     dt = get_curr_time() - (data -> start_time);
 /*     printf("%d: got data msg src: %d len: %d band: %.3f[MB/s]\n", node -> node_id, header -> src_id, data -> len, (data -> len) * 1e-6 / dt);fflush(stdout); */
 
-    data_msg_hash_map_pop(node -> data_msg_map, sid);
+    data_msg_open_map_pop(node -> data_msg_map, sid);
+    comm_node_flow_done(node, header);
 
-    comm_node_deliver_chunk(node, data);
+    if(header -> kind == MSG_TYPE_AGGR)
+      comm_node_deliver_aggr(node, data);
+    else
+      comm_node_deliver_chunk(node, data);
   }
 /*   else{ */
 /*     printf("%d: got chunk src: %d len: %d/%d\n", node -> node_id, header -> src_id, data -> recvd, data -> len);fflush(stdout); */
 /*   } */
 }
 
-#if COMM_ADJUST_CHUNK_SIZE
+/* COMM_CHUNK_FIXED, COMM_CHUNK_WIDTH or COMM_CHUNK_ADAPTIVE, */
+/* takes effect for messages sent afterwards */
+void
+comm_node_set_chunk_policy(comm_node_t node, int policy){
+  node -> chunk_policy = policy;
+}
+
+/* pipelining a message of len bytes over hops links in chunks of c bytes takes */
+/*   (len / c + hops - 1) * (c / bw + COMM_CHUNK_OVERHEAD), */
+/* which is smallest at c = sqrt(len * COMM_CHUNK_OVERHEAD * bw / (hops - 1)). */
+/* a backlog on the first hop already keeps the pipeline full, */
+/* so chunks then grow towards the maximum to cut per-chunk cost */
 static int
-comm_node_calc_chunk_size(comm_node_t node, int dst_id){
+comm_node_adaptive_chunk_size(comm_node_t node, int dst_id, int len){
   overlay_rtable_t rt = node -> rts[node -> node_id];
-  overlay_rtable_entry_t entry = overlay_rtable_get_entry(rt, dst_id);
-  return (int)((float)entry -> width / node -> max_width * node -> data_msg_chunk_size);
+  overlay_rtable_entry_t entry = NULL;
+  int hops = 1, next_id = dst_id, max_size;
+  double bw, c, q;
+
+  if(rt != NULL && (entry = overlay_rtable_get_entry(rt, dst_id)) != NULL && entry -> hops > 0){
+    hops = entry -> hops;
+    next_id = comm_node_lookup_rt(node, node -> node_id, dst_id);
+  }
+
+  /* a single link: nothing to pipeline */
+  if(hops <= 1)
+    return COMM_MAX_CHUNK_SIZE;
+
+  /* relays receive into chunk buffers of the default size */
+  max_size = node -> data_msg_chunk_size;
+
+  /* path throughput [B/s]: first hop and path width, or what sending achieved */
+  bw = comm_node_link_width(node, next_id) * 1e6 / 8;
+  if(entry -> width > 0 && entry -> width * 1e6 / 8 < bw)
+    bw = entry -> width * 1e6 / 8;
+  if(node -> path_bw[dst_id] > 0 && node -> path_bw[dst_id] < bw)
+    bw = node -> path_bw[dst_id];
+
+  c = sqrt((double)len * COMM_CHUNK_OVERHEAD * bw / (hops - 1));
+
+  q = (double)ioman_queued_bytes(node -> man, next_id) / CHANNEL_QUEUE_BUDGET;
+  if(q > 1.0) q = 1.0;
+  if(c < max_size)
+    c += q * (max_size - c);
+
+  return (int)c;
+}
+
+static int
+comm_node_calc_chunk_size(comm_node_t node, int dst_id, int len){
+  overlay_rtable_t rt = node -> rts[node -> node_id];
+  int size;
+
+  switch(node -> chunk_policy){
+  case COMM_CHUNK_WIDTH:
+    if(rt == NULL || node -> max_width <= 0)
+      return node -> data_msg_chunk_size;
+    size = (int)((float)overlay_rtable_get_entry(rt, dst_id) -> width / node -> max_width * node -> data_msg_chunk_size);
+    break;
+  case COMM_CHUNK_ADAPTIVE:
+    size = comm_node_adaptive_chunk_size(node, dst_id, len);
+    break;
+  default:
+    return node -> data_msg_chunk_size;
+  }
+
+  /* page multiple within bounds */
+  size = Max(COMM_MIN_CHUNK_SIZE, Min(COMM_MAX_CHUNK_SIZE, size));
+  return size & ~4095;
 }
-#endif
 
 double
 comm_node_peer_rtt(comm_node_t node, int dst_id){
   return node -> rtts[dst_id];
 }
 
+/* needs aggr_lock, which is released while pushing as that may block. */
+/* the chunk goes to the submission queue of the thread that packed it, */
+/* after any chunk to dst_id still being pushed, */
+/* so it stays ahead of what that thread sends to dst_id later */
+static void
+comm_node_aggr_flush_one(comm_node_t node, int dst_id){
+  comm_aggr_t aggr = &node -> aggrs[dst_id];
+  char* buff;
+  int len;
+
+  while(aggr -> flushing)
+    std_pthread_cond_wait(&node -> aggr_cond, &node -> aggr_lock);
+  if(aggr -> len == 0)
+    return;
+
+  buff = aggr -> buff;
+  len = aggr -> len;
+  aggr -> buff = aggr -> spare;
+  aggr -> spare = NULL;
+  aggr -> len = 0;
+  aggr -> flushing = 1;
+  -- node -> aggr_pending;
+
+  std_pthread_mutex_unlock(&node -> aggr_lock);
+  ioman_send_aggr(node -> man, aggr -> via, dst_id, comm_node_get_new_sid(node), buff, len);
+  std_pthread_mutex_lock(&node -> aggr_lock);
+
+  aggr -> spare = buff;
+  aggr -> flushing = 0;
+  std_pthread_cond_broadcast(&node -> aggr_cond);
+}
+
+/* flush aggregated chunks whose oldest message waited long enough */
+static void*
+comm_node_aggr_flusher(void* _node){
+  comm_node_t node = (comm_node_t)_node;
+  struct timespec ts;
+  double t, next;
+  int dst_id;
+
+  std_pthread_mutex_lock(&node -> aggr_lock);
+  while(node -> aggr_on){
+    if(node -> aggr_pending == 0){
+      std_pthread_cond_wait(&node -> aggr_cond, &node -> aggr_lock);
+      continue;
+    }
+
+    t = get_curr_time();
+    next = t + COMM_AGGR_FLUSH_INTERVAL;
+    for(dst_id = 0; dst_id < COMM_MAX_PEER && node -> aggr_pending; dst_id ++){
+      if(node -> aggrs[dst_id].len == 0)
+	continue;
+      if(t - node -> aggrs[dst_id].first_time >= COMM_AGGR_FLUSH_INTERVAL)
+	comm_node_aggr_flush_one(node, dst_id);
+      else if(node -> aggrs[dst_id].first_time + COMM_AGGR_FLUSH_INTERVAL < next)
+	next = node -> aggrs[dst_id].first_time + COMM_AGGR_FLUSH_INTERVAL;
+    }
+
+    if(node -> aggr_pending){
+      ts.tv_sec = (time_t)next;
+      ts.tv_nsec = (long)((next - ts.tv_sec) * 1e9);
+      std_pthread_cond_timedwait(&node -> aggr_cond, &node -> aggr_lock, &ts);
+    }
+  }
+  std_pthread_mutex_unlock(&node -> aggr_lock);
+
+  return NULL;
+}
+
+static void
+comm_node_aggr_push(comm_node_t node, int dst_id, const void* buff, int len){
+  comm_aggr_t aggr = &node -> aggrs[dst_id];
+  channel_t via = ioman_get_local_channel(node -> man);
+  void* p;
+
+  std_pthread_mutex_lock(&node -> aggr_lock);
+
+  /* a chunk only packs messages of one thread; flushing lets others in, so look again */
+  while(aggr -> len > 0 &&
+	(aggr -> via != via || aggr -> len + (int)sizeof(int) + len > COMM_AGGR_CHUNK_SIZE))
+    comm_node_aggr_flush_one(node, dst_id);
+
+  if(aggr -> buff == NULL)
+    aggr -> buff = std_malloc(COMM_AGGR_CHUNK_SIZE);
+
+  if(aggr -> len == 0){
+    aggr -> via = via;
+    aggr -> first_time = get_curr_time();
+    if(node -> aggr_pending ++ == 0)
+      std_pthread_cond_broadcast(&node -> aggr_cond);
+  }
+
+  p = aggr -> buff + aggr -> len;
+  pack_int(&p, len);
+  pack_buff(&p, buff, len);
+  aggr -> len = (char*)p - aggr -> buff;
+
+  std_pthread_mutex_unlock(&node -> aggr_lock);
+}
+
+/* send everything packed so far */
 void
-comm_node_send_data(comm_node_t node, int dst_id, const void *buff, int len){
-  sid_t sid = comm_node_get_new_sid(node);
+comm_node_flush(comm_node_t node){
+  int dst_id;
+
+  std_pthread_mutex_lock(&node -> aggr_lock);
+  for(dst_id = 0; dst_id < COMM_MAX_PEER && node -> aggr_pending; dst_id ++)
+    comm_node_aggr_flush_one(node, dst_id);
+  std_pthread_mutex_unlock(&node -> aggr_lock);
+}
+
+/* coalesce small messages to the same destination into one chunk, */
+/* flushed when it fills up or after COMM_AGGR_FLUSH_INTERVAL */
+void
+comm_node_set_aggregation(comm_node_t node, int on){
+  if(on && !node -> aggr_on){
+    if(node -> aggrs == NULL)
+      node -> aggrs = (comm_aggr_t)std_calloc(COMM_MAX_PEER, sizeof(comm_aggr));
+    node -> aggr_on = 1;
+    std_pthread_create(&node -> aggr_flusher, NULL, comm_node_aggr_flusher, (void*)node);
+  }
+  else if(!on && node -> aggr_on){
+    std_pthread_mutex_lock(&node -> aggr_lock);
+    node -> aggr_on = 0;
+    std_pthread_cond_broadcast(&node -> aggr_cond);
+    std_pthread_mutex_unlock(&node -> aggr_lock);
+    std_pthread_join(node -> aggr_flusher, NULL);
+
+    comm_node_flush(node);
+  }
+}
+
+/* [%] how congested a route to dst_id is: the send queue on its first hop, */
+/* or what the destination reported if that is worse and recent */
+static int
+comm_node_path_cong(comm_node_t node, int dst_id, int path, overlay_rtable_entry_t e, double now){
+  long occ = ioman_queued_bytes(node -> man, e -> path[1]) * 100 / CHANNEL_QUEUE_BUDGET;
+  comm_cong_t fb = &node -> cong_tx[dst_id][path];
+
+  if(now - fb -> time < COMM_CONG_FEEDBACK_TTL && fb -> level > occ)
+    occ = fb -> level;
+  return occ > 100 ? 100 : occ;
+}
+
+/* route for the next chunk to dst_id. routes are taken in proportion to */
+/* their width scaled down by their congestion, spread evenly by the golden ratio sequence */
+static int
+comm_node_select_path(comm_node_t node, int dst_id){
+  overlay_rtable_entry_t entry, e;
+  double w[COMM_MAX_PATHS];
+  double x, now, total = 0;
+  unsigned n;
+  int path, npaths;
+
+  if(node -> rts[node -> node_id] == NULL)
+    return 0;
+  /* no entry to this node itself */
+  entry = overlay_rtable_get_entry(node -> rts[node -> node_id], dst_id);
+  if(entry == NULL || entry -> alt == NULL)
+    return 0;
+
+  now = get_curr_time();
+  for(npaths = 0, e = entry; e != NULL && npaths < COMM_MAX_PATHS; npaths ++, e = e -> alt){
+    w[npaths] = Max(e -> width, 1) * (101 - comm_node_path_cong(node, dst_id, npaths, e, now));
+    total += w[npaths];
+  }
+
+  n = __sync_fetch_and_add(&node -> path_rr[dst_id], 1);
+  x = n * 0.6180339887498949;
+  x = (x - floor(x)) * total;
+  for(path = 0; path < npaths - 1; path ++){
+    if((x -= w[path]) < 0)
+      break;
+  }
+  return path;
+}
+
+/* fragment a message, each chunk taking the route selected for it */
+static void
+comm_node_send_chunks(comm_node_t node, int dst_id, const void *buff, int len, int prio, int tag){
+  sid_t sid;
   int seq;
   int remain, off;
   int size;
+  int CHUNK_SZ;
+  double t0, dt, bw;
 
-#if COMM_ADJUST_CHUNK_SIZE
-  int CHUNK_SZ = comm_node_calc_chunk_size(node, dst_id);
-#else
-  int CHUNK_SZ = node -> data_msg_chunk_size;
-#endif
-  
+  sid = comm_node_get_new_sid(node);
+  CHUNK_SZ = comm_node_calc_chunk_size(node, dst_id, len);
+  t0 = get_curr_time();
 
   for(seq = 0, off = 0, remain = len; remain > 0; seq ++){
     size = CHUNK_SZ > remain ? remain : CHUNK_SZ;
-    ioman_send_chunk(node -> man, dst_id, sid, len, seq, buff + off, size);
+    ioman_send_chunk(node -> man, dst_id, prio, comm_node_select_path(node, dst_id), tag, sid, len, seq, off, buff + off, size);
     remain -= size;
     off += size;
     /* printf("%d: comm_node_send_data %d/%d -> %d\n", node -> node_id, off, len, dst_id);fflush(stdout); */
   }
+
+  /* pushing only blocks once the queue is full, so a message that filled it */
+  /* was sent at the rate the path drains (rough, and updated without locking) */
+  if(node -> chunk_policy == COMM_CHUNK_ADAPTIVE && seq > 1
+     && node -> rts[node -> node_id] != NULL
+     && ioman_queued_bytes(node -> man, comm_node_lookup_rt(node, node -> node_id, dst_id)) >= CHANNEL_QUEUE_BUDGET / 2
+     && (dt = get_curr_time() - t0) > 0){
+    bw = len / dt;
+    node -> path_bw[dst_id] = node -> path_bw[dst_id] > 0 ? 0.75 * node -> path_bw[dst_id] + 0.25 * bw : bw;
+  }
+}
+
+void
+comm_node_send_data(comm_node_t node, int dst_id, const void *buff, int len){
+  comm_node_send_data_prio(node, dst_id, buff, len, COMM_PRIO_NORMAL);
+}
+
+/* chunks of a message share their link with other flows in proportion to */
+/* the weight of its priority class, at the sender and at every relay */
+void
+comm_node_send_data_prio(comm_node_t node, int dst_id, const void *buff, int len, int prio){
+  /* high priority messages are not held back for packing */
+  if(node -> aggr_on){
+    if(len > 0 && len <= COMM_AGGR_MAX_MSG && prio != COMM_PRIO_HIGH){
+      comm_node_aggr_push(node, dst_id, buff, len);
+      return;
+    }
+    /* keep packed messages ahead of this one */
+    std_pthread_mutex_lock(&node -> aggr_lock);
+    comm_node_aggr_flush_one(node, dst_id);
+    std_pthread_mutex_unlock(&node -> aggr_lock);
+  }
+
+  comm_node_send_chunks(node, dst_id, buff, len, prio, 0);
+}
+
+/* a message of a collective operation, see comm_node_recv_tagged() */
+void
+comm_node_send_tagged(comm_node_t node, int dst_id, const void *buff, int len, int tag){
+  comm_node_send_tagged_prio(node, dst_id, buff, len, COMM_PRIO_NORMAL, tag);
+}
+
+void
+comm_node_send_tagged_prio(comm_node_t node, int dst_id, const void *buff, int len, int prio, int tag){
+  assert(tag != 0);
+  comm_node_send_chunks(node, dst_id, buff, len, prio, tag);
+}
+
+/* signal of coll_barrier(), received with comm_node_recv_tagged(). it is a control */
+/* message, queued ahead of data chunks at each hop and never held back by the budgets */
+void
+comm_node_send_barrier(comm_node_t node, int dst_id, int tag){
+  int buff[3];
+  void* p = buff;
+
+  assert(tag != 0);
+  pack_int(&p, node -> node_id);
+  pack_int(&p, dst_id);
+  pack_int(&p, tag);
+  ioman_send_ctrl(node -> man, MSG_TYPE_BARRIER, comm_node_lookup_rt(node, node -> node_id, dst_id), buff, sizeof(buff));
 }
 
+/* members given as node ids, returns the group id. groups are numbered */
+/* in creation order, so every node must create the same groups in the same order, */
+/* and before any chunk multicast to the group reaches it */
+int
+comm_node_group_create(comm_node_t node, const int* members, int n){
+  int gid;
+
+  std_pthread_mutex_lock(&node -> lock);
+  assert(node -> num_groups < COMM_MAX_GROUPS);
+  gid = node -> num_groups ++;
+  node -> groups[gid] = comm_group_create(members, n);
+  std_pthread_mutex_unlock(&node -> lock);
+
+  return gid;
+}
+
+/* send to every member of group gid but this node, with a single copy per link: */
+/* chunks follow the routes to the members, and where these part, */
+/* relays pass the same buffer on to each next hop. members receive as from comm_node_send_data() */
+void
+comm_node_mcast_data(comm_node_t node, int gid, const void *buff, int len){
+  comm_node_mcast_tagged(node, gid, buff, len, 0);
+}
+
+void
+comm_node_mcast_tagged(comm_node_t node, int gid, const void *buff, int len, int tag){
+  sid_t sid;
+  int seq;
+  int remain, off;
+  int size;
+
+  assert(gid >= 0 && gid < node -> num_groups && node -> groups[gid] != NULL);
+
+  sid = comm_node_get_new_sid(node);
+  for(seq = 0, off = 0, remain = len; remain > 0; seq ++){
+    size = node -> data_msg_chunk_size > remain ? remain : node -> data_msg_chunk_size;
+    ioman_send_mcast(node -> man, gid, tag, sid, len, seq, off, buff + off, size);
+    remain -= size;
+    off += size;
+  }
+}
+
+
 /* void */
 /* comm_node_wait_data(comm_node_t node, int count){ */
 /*   std_pthread_mutex_lock(&node -> lock); */
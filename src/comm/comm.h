@@ -3,13 +3,50 @@
 
 typedef struct comm_node comm_node, *comm_node_t;
 
+enum comm_io_backend{
+  COMM_IO_SELECT,
+  COMM_IO_URING,
+};
+
+enum comm_chunk_policy{
+  COMM_CHUNK_FIXED,    /* same chunk size for every destination */
+  COMM_CHUNK_WIDTH,    /* scaled by path width relative to the widest path */
+  COMM_CHUNK_ADAPTIVE, /* from hop count, path throughput and queue occupancy */
+};
+
+/* same order as msg_prio */
+enum comm_prio{
+  COMM_PRIO_LOW,    /* bulk transfers */
+  COMM_PRIO_NORMAL,
+  COMM_PRIO_HIGH,   /* latency-sensitive messages */
+};
+
+/* multicast group of every node, see comm_node_group_create() */
+enum comm_group_id{
+  COMM_GROUP_ALL,
+};
+
 comm_node_t comm_node_create(int node_id);
+comm_node_t comm_node_create_with_io(int node_id, int io_backend);
 void comm_node_destroy(comm_node_t node);
 int comm_node_listen_port(comm_node_t node);
 unsigned long comm_node_async_connect(comm_node_t node, const char* addr, int port);
+unsigned long comm_node_async_connect_stream(comm_node_t node, int dst_id, const char* addr, int port);
+unsigned long comm_node_async_connect_lane(comm_node_t node, int dst_id, int lane, const char* addr, int port);
+int comm_node_calc_streams(comm_node_t node, int dst_id, float width, int max_streams);
+void comm_node_set_link_width(comm_node_t node, int dst_id, float width);
+void comm_node_set_zerocopy(comm_node_t node, int on);
+void comm_node_set_aggregation(comm_node_t node, int on);
+void comm_node_flush(comm_node_t node);
+void comm_node_set_chunk_policy(comm_node_t node, int policy);
 int comm_node_connect_wait(comm_node_t node, unsigned long handle, int* dst_id);
+int comm_node_join(comm_node_t node);
+void comm_node_leave(comm_node_t node);
 double comm_node_peer_rtt(comm_node_t node, int dst_id);
 void comm_node_send_data(comm_node_t node, int dst_id, const void *buff, int buffsize);
+void comm_node_send_data_prio(comm_node_t node, int dst_id, const void *buff, int buffsize, int prio);
+int comm_node_group_create(comm_node_t node, const int* members, int n);
+void comm_node_mcast_data(comm_node_t node, int gid, const void *buff, int buffsize);
 void comm_node_recv_data(comm_node_t node, int src_id, void **buff, int* buffsize);
 void comm_node_recv_any_data(comm_node_t node, int* src_id, void **buff, int* buffsize);
 
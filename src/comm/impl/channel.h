@@ -5,11 +5,16 @@
 #include <std/map.h>
 #include "sock.h"
 #include "msg.h"
+#include "sendq.h"
 
 #define CHANNEL_PEER_UNKNOWN (-1)
+#define CHANNEL_HOSTNAME_LEN (64)
 
 #define CHANNEL_MSG_HEADERLEN (100)
-#define CHANNEL_MSG_QUEUE_LIMIT (100) // size of the chunk queue associated with each channel for sending
+#define CHANNEL_QUEUE_BUDGET (16 * 1024 * 1024) // bytes of chunks queued per channel for sending
+#define CHANNEL_MIN_SOCK_BUFF (64 * 1024)        // bounds of socket buffer sizes set from the BDP
+#define CHANNEL_MAX_SOCK_BUFF (64 * 1024 * 1024)
+#define CHANNEL_MAX_LANES (4)                    // virtual lanes per link, lane 0 being the link itself
 
 enum channel_connect_status{
   CHANNEL_CONNECT_INPROGRESS,
@@ -48,6 +53,13 @@ enum channel_pipeline_status{
 
 typedef struct channel channel, *channel_t;
 
+/* bytes queued over all channels of a node, */
+/* updated atomically since local channels are filled by user threads */
+typedef struct channel_budget{
+  long cap;
+  long queued;
+} channel_budget, *channel_budget_t;
+
 LIST_MAKE_TYPE_INTERFACE(channel);
 HASHMAP_MAKE_TYPE_INTERFACE(channel);
 
@@ -59,13 +71,16 @@ struct channel{
   
   /* id related stuff */
   int peer_id;
-  char peer_hostname[20];
+  char peer_hostname[CHANNEL_HOSTNAME_LEN];
 
   /* msg buffer related stuff */
   void* header_buff;
   int header_off;
 
-  msg_buff_list_t buff_queue;
+  sendq_t sendq;
+  channel_budget_t budget;  /* node-wide, NULL if not accounted */
+  long *link_queued;        /* bytes queued to the peer over all its connections, NULL until registered */
+  msg_buff_list_t zc_pending; /* sent, but the kernel may still read them (MSG_ZEROCOPY) */
   
   msg_info_t msg_info;
   msg_buff_t curr_buff;
@@ -75,6 +90,31 @@ struct channel{
   channel_t next;
   channel_t prev;
   channel_list_t wait_queue;
+  channel_t *fanout; /* next channels the current chunk still has to be pushed to */
+  int nfanout;
+  int fanout_cap;
+
+  /* parallel streams to the same peer: */
+  /* the head channel (the one in channel_map) holds the extra streams, */
+  /* each extra stream points back to its head */
+  int stream_dst; /* peer a stream is being opened to, before it is registered */
+  channel_t stream_head;
+  channel_t *streams;
+  int nstreams;
+  int stream_rr;
+
+  /* virtual lanes to the same peer: each lane is a connection of its own, */
+  /* so that a chunk blocked on one lane never holds up the others. */
+  /* the head channel holds them by lane number, each points back to it */
+  int lane;
+  channel_t lane_head;
+  channel_t lanes[CHANNEL_MAX_LANES]; /* [0] unused */
+
+  /* socket buffer size set from the BDP, 0 if left to the kernel */
+  int sock_buff;
+
+  /* last message to go through TCP before sending switches to shared memory */
+  msg_buff_t shm_switch;
 
   /* stuff for local pseudo-channel */
   int pipe[2];
@@ -104,8 +144,9 @@ int channel_is_established(channel_t chan);
 
 int channel_read_header(channel_t chan, int* msg_kind);
 
-void channel_setup_chunk(channel_t chan);
+void channel_setup_chunk(channel_t chan, msg_buff_pool_t pool);
 void channel_setup_chunk_with_buff(channel_t chan, void* buff);
+void channel_repack_header(channel_t chan);
 void channel_setup_msg(channel_t chan);
 
 int channel_read_msg(channel_t chan, msg_buff_t *buff);
@@ -114,8 +155,31 @@ msg_buff_t channel_local_pop_chunk(channel_t chan);
 void channel_local_pop_chunk_ack(channel_t chan);
 int channel_read_chunk(channel_t chan, msg_buff_t *buff);
 
+void channel_set_budget(channel_t chan, channel_budget_t budget);
+void channel_set_link_counter(channel_t chan, long *link_queued);
+long channel_queued_bytes(channel_t chan);
+int channel_queued_chunks(channel_t chan);
 int channel_pipeline_chunk(channel_t chan, channel_t next);
-
+void channel_fanout_reset(channel_t chan);
+void channel_fanout_add(channel_t chan, channel_t next);
+int channel_pipeline_fanout(channel_t chan);
+void channel_requeue_chunk(channel_t chan, msg_buff_t buff, msg_info_t minfo);
+void channel_salvage(channel_t chan, msg_buff_list_t chunks, channel_list_t waiters);
+void channel_forget(channel_t chan, channel_t gone);
+
+void channel_add_stream(channel_t head, channel_t stream);
+void channel_remove_stream(channel_t head, channel_t stream);
+channel_t channel_promote_stream(channel_t head);
+channel_t channel_select_stream(channel_t head);
+void channel_add_lane(channel_t head, channel_t lane);
+void channel_remove_lane(channel_t head, channel_t lane);
+channel_t channel_select_lane(channel_t head, int lane);
+
+void channel_tune_buffers(channel_t chan, double rtt, float width);
+void channel_tune_link(channel_t head, double rtt, float width);
+void channel_shm_switch_tx(channel_t chan);
+
+int channel_zc_release(channel_t chan);
 void channel_send_msg(channel_t chan, msg_info_t minfo, const void* buff, int len);
 int channel_write(channel_t chan, int *unblock);
 
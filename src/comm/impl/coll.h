@@ -0,0 +1,38 @@
+#ifndef __IMPL_COLL_H__
+#define __IMPL_COLL_H__
+
+#include <comm/coll.h>
+#include "comm.h"
+
+#define COLL_SEGMENT_SIZE (1024 * 1024)  // bytes per message on ring links, a segment is passed on as soon as it is reduced
+#define COLL_RING_MIN_SIZE (64 * 1024)   // smaller allreduce/reduce go through one node instead of the ring
+#define COLL_ALLTOALL_WINDOW (2)         // all-to-all phases whose flows may be in flight at once
+#define COLL_MAX_HOPS (64)               // links per route that an all-to-all schedule keeps apart
+#define COLL_MAX_STEPS (1 << 16)         // messages per link in one operation (tags have 16 bits for it)
+#define COLL_GATHER_STEP (COLL_MAX_STEPS - 1) // step of messages sent straight to the root
+#define COLL_BCAST_STEP (COLL_MAX_STEPS - 2)  // step of messages multicast by the root
+#define COLL_SCATTER_STEP (COLL_MAX_STEPS - 3) // step of messages sent straight from the root
+#define COLL_MAX_COUNTED_STEPS (COLL_SCATTER_STEP) // ring, all-to-all and barrier steps stay below the fixed ones
+
+/* one collective operation in progress on a member */
+typedef struct coll_ctx{
+  comm_node_t node;
+  int gid;
+  comm_group_t group;
+  int n;    /* members */
+  int pos;  /* position of this node in the ring */
+  int prev; /* node ids of the neighbors in the ring */
+  int next;
+  int seq;  /* operation number, the same on all members */
+  int sent; /* messages sent to next and received from prev so far */
+  int recvd;
+} coll_ctx, *coll_ctx_t;
+
+/* flow of an all-to-all, between members given by rank */
+typedef struct coll_flow{
+  int src;
+  int dst;
+  int hops;
+} coll_flow, *coll_flow_t;
+
+#endif // __IMPL_COLL_H__
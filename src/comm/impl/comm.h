@@ -4,9 +4,23 @@
 #include <comm/comm.h>
 
 #define COMM_MAX_PEER (1024)               // hard coded max number of node communicators
-#define COMM_HASH_SIZE (128)               // size of the hash bucket
+#define COMM_HASH_SIZE (128)               // size of the hash bucket (initial size for growing maps)
 #define COMM_DATA_CHUNK_SIZE (1024 * 1024) // chunk size to which messages will be fragmented for sending
-#define COMM_ADJUST_CHUNK_SIZE (0)         // set to 1, to adjust chunk size based on bandwidth with destination 
+#define COMM_DEFAULT_CHUNK_POLICY (COMM_CHUNK_FIXED) // how chunk size is chosen per destination, see comm_node_set_chunk_policy()
+#define COMM_MIN_CHUNK_SIZE (64 * 1024)    // bounds for non-fixed policies
+#define COMM_MAX_CHUNK_SIZE (4 * 1024 * 1024)
+#define COMM_CHUNK_OVERHEAD (50e-6)        // [s] assumed per-chunk cost at each hop (header, syscalls, pipeline step)
+#define COMM_MAX_STREAMS (8)               // max number of parallel TCP streams per overlay link
+#define COMM_MAX_LANES (CHANNEL_MAX_LANES) // max number of virtual lanes per overlay link
+#define COMM_MAX_PATHS (4)                 // max number of routes per destination that chunks are striped over
+#define COMM_MAX_GROUPS (64)               // max number of multicast groups, including COMM_GROUP_ALL
+#define COMM_CONG_FEEDBACK_TTL (0.1)       // [s] congestion reported by a destination is trusted this long
+#define COMM_DEFAULT_LINK_WIDTH (1000.0f)  // [Mbps] assumed for links whose bandwidth was not given
+#define COMM_USE_SHM (1)                   // set to 1, to carry traffic between peers on the same host over shared memory
+#define COMM_AGGR_MAX_MSG (4 * 1024)       // with aggregation on, messages up to this size are coalesced per destination
+#define COMM_AGGR_CHUNK_SIZE (64 * 1024)   // an aggregated chunk is flushed before it grows beyond this
+#define COMM_AGGR_FLUSH_INTERVAL (0.001)   // [s] max time a message waits in an aggregated chunk
+#define COMM_ACK_BATCH (1024)              // max chunks acknowledged by one message to their source
 
 #define COMM_MONITOR_RECV_BAND (0)         // set to 1, to run a thread that monitors send/recv bandwidth for node communicators
 
@@ -15,6 +29,59 @@
 
 #include <pthread.h>
 
+/* congestion of one route, as reported back by its destination */
+typedef struct comm_cong{
+  int level; /* [%] */
+  double time;
+} comm_cong, *comm_cong_t;
+
+/* multicast group: members, and a membership flag per node */
+typedef struct comm_group{
+  int size;
+  int* members;
+  char* is_member;
+
+  /* collective operations on the group, see coll.c */
+  int* ring;    /* members in the order of the ring, NULL until first needed */
+  int coll_seq; /* collective operations so far */
+  int a2a_nphases; /* all-to-all schedule of this node: member sent to and received from */
+  int* a2a_to;     /* in each phase, -1 if none. NULL until first needed */
+  int* a2a_from;
+  int hier_nclusters; /* clusters the group is split into by coll_hier_create(), 0 if none */
+  int* hier_cluster;  /* cluster of each member, by rank */
+  int* hier_gids;     /* group of the members of each cluster, its leader first */
+  int hier_leaders;   /* group of the leaders of the clusters, in cluster order */
+
+  /* COMM_GROUP_ALL this one replaced on a join or leave. user threads */
+  /* use groups without locking, so it is only freed with this one */
+  struct comm_group* replaced;
+} comm_group, *comm_group_t;
+
+/* messages of one flow to this node (from a source to it, or to a group it is in) */
+/* that were received, to tell chunks the source sent again from those that came */
+typedef struct comm_flow_rx{
+  sid_t next;      /* all numbered below were received, or are not for this node */
+  open_map_t done; /* received ones numbered from next on */
+} comm_flow_rx, *comm_flow_rx_t;
+
+/* chunks received from one source, to acknowledge */
+typedef struct comm_acks{
+  sid_t* sids;
+  int* seqs;
+  int n;
+  int listed; /* in ack_srcs */
+} comm_acks, *comm_acks_t;
+
+/* small messages to one destination, packed as a sequence of (len, data) */
+typedef struct comm_aggr{
+  char* buff;
+  int len;
+  double first_time; /* when the oldest message was packed */
+  channel_t via;     /* submission queue of the thread whose messages are packed */
+  char* spare;       /* buffer of the chunk being flushed, or free */
+  int flushing;      /* a chunk is being pushed with aggr_lock released */
+} comm_aggr, *comm_aggr_t;
+
 struct comm_node {
   int node_id;
   ioman_t man;
@@ -25,11 +92,32 @@ struct comm_node {
   pthread_cond_t cond;
   
   double rtts[COMM_MAX_PEER];
+  float link_widths[COMM_MAX_PEER]; /* [Mbps], 0 if unknown. written by the ioman thread */
   overlay_rtable_t rts[COMM_MAX_PEER];
   int num_rts;
+  struct reroute* reroute; /* routes around failed links, NULL until one fails. ioman thread only */
 
   int data_msg_chunk_size;
-  sid_t data_msg_sid;
+  int chunk_policy;
+  double path_bw[COMM_MAX_PEER]; /* [B/s] measured when sending to each destination, 0 if unknown */
+  unsigned path_rr[COMM_MAX_PEER]; /* chunks sent to each destination with multiple routes, incremented atomically */
+
+  /* congestion feedback, written by the ioman thread. */
+  /* user threads read it without locking (an estimate) */
+  int cong_rx[COMM_MAX_PEER][COMM_MAX_PATHS];       /* [%] seen on chunks from each source, -1 if none */
+  int cong_echo_rr[COMM_MAX_PEER];                  /* route whose level is echoed next */
+  comm_cong cong_tx[COMM_MAX_PEER][COMM_MAX_PATHS]; /* echoed by each destination */
+  /* join or leave being announced, see comm_node_join() */
+  int wave_kind;   /* MSG_TYPE_JOIN or MSG_TYPE_LEAVE, 0 if none yet */
+  int wave_pid;    /* node joining or leaving */
+  int wave_parent; /* neighbor it was first heard from, -1 on that node itself */
+  int wave_count;  /* neighbors heard from */
+
+  /* multicast groups by id, created in the same order on every node */
+  comm_group_t groups[COMM_MAX_GROUPS];
+  int num_groups;
+
+  sid_t data_msg_sid; /* incremented atomically */
 
   /* num. of data msgs received */
   int data_msg_recvd;
@@ -41,13 +129,29 @@ struct comm_node {
   int max_width;
   int min_width;
 
-  /* TODO: temporary */
-  data_msg_hash_map_t data_msg_map;
+  /* in-flight messages being reassembled, keyed by sid */
+  /* only touched by the ioman thread */
+  data_msg_open_map_t data_msg_map;
   data_msg_list_t* recvd_data_msg_queues; // sid -> recvd_data_msg_queue
+  data_msg_list_t* recvd_tagged_queues;   /* messages of collective operations, by source */
+
+  /* chunks sent again, told apart, see comm_node_chunk_state(). ioman thread only */
+  open_map_t flows_rx; /* comm_flow_rx by source and group */
+  comm_acks_t acks;    /* by source */
+  int* ack_srcs;       /* sources with chunks to acknowledge */
+  int nack_srcs;
 
   /* for stats */
   long recvd_bytes;
 
+  /* small-message aggregation, see comm_node_set_aggregation() */
+  int aggr_on;
+  comm_aggr_t aggrs;   /* per destination */
+  int aggr_pending;    /* num. of destinations with packed messages */
+  pthread_mutex_t aggr_lock;
+  pthread_cond_t aggr_cond;
+  pthread_t aggr_flusher;
+
 #if COMM_MONITOR_RECV_BAND
   int monitor_run;
   pthread_t monitor;
@@ -61,9 +165,24 @@ void comm_node_notify_connect(comm_node_t node, channel_t chan);
 void comm_node_notify_success(comm_node_t node, channel_t chan);
 void comm_node_notify_failure(comm_node_t node, channel_t chan);
 int comm_node_lookup_rt(comm_node_t node, int src_pid, int dst_pid);
+int comm_node_lookup_rt_path(comm_node_t node, int src_pid, int dst_pid, int path, int *lane);
+int comm_node_lookup_mcast(comm_node_t node, int gid, int src_pid, int from_pid, int *nexts, int *lanes);
+int comm_node_group_member(comm_node_t node, int gid, int pid);
+float comm_node_link_width(comm_node_t node, int dst_id);
+int comm_node_cong_echo(comm_node_t node, int dst_id);
+void comm_node_link_down(comm_node_t node, int u, int v);
 void comm_node_handle_msg(comm_node_t node, channel_t chan, const msg_info_t msg_info, const msg_buff_t buff);
 void comm_node_setup_chunk(comm_node_t node, channel_t chan, const msg_info_t header);
 void comm_node_handle_chunk(comm_node_t node, channel_t chan, const msg_info_t header, const msg_buff_t chunk);
+void comm_node_send_tagged(comm_node_t node, int dst_id, const void *buff, int len, int tag);
+void comm_node_send_tagged_prio(comm_node_t node, int dst_id, const void *buff, int len, int prio, int tag);
+void comm_node_mcast_tagged(comm_node_t node, int gid, const void *buff, int len, int tag);
+void comm_node_send_barrier(comm_node_t node, int dst_id, int tag);
+void comm_node_recv_tagged(comm_node_t node, int src_id, int tag, void** buff, int* buffsize);
+void comm_node_copy_chunk(comm_node_t node, channel_t chan, const msg_info_t header, const void* body);
+void comm_node_abort_chunk(comm_node_t node, const msg_info_t header, msg_buff_t buff);
+void comm_node_flush_acks(comm_node_t node);
+void comm_node_deliver_chunk(comm_node_t node, data_msg_t msg);
 
 
 #endif // __IMPL_COMM_H__
@@ -8,13 +8,18 @@ typedef struct ioman ioman, *ioman_t;
 #include <pthread.h>
 #include <std/std.h>
 #include "sock.h"
+#include "uring.h"
 #include "channel.h"
+#include "resend.h"
 #include "comm.h"
 
 enum ioman_event_type {
   IOMAN_EVENT_NEWCHAN,
   IOMAN_EVENT_NEWMSG,
   IOMAN_EVENT_BCASTMSG,
+  IOMAN_EVENT_SENDMSG,
+  IOMAN_EVENT_NEWLOCAL,
+  IOMAN_EVENT_LINKWIDTH,
   IOMAN_EVENT_FINALIZE,
 };
 
@@ -29,19 +34,32 @@ enum ioman_fdset_cache_status{
 };
 
 #define IOMAN_NOTIFYPIPE_BUFF_SIZE (1024 * 1024 * 4) /* 4MB */
+#define IOMAN_TUNE_SOCK_BUFF (0)      // set to 1, to periodically re-size socket buffers from the measured RTT (turns off kernel autotuning)
+#define IOMAN_TUNE_INTERVAL (1.0)     // [s]
+#define IOMAN_URING_POOL_BUFFS (32)   // number of registered chunk buffers for relaying with io_uring
+#define IOMAN_QUEUE_CAP (256L * 1024 * 1024) // bytes of chunks queued for sending over all channels of a node
+#define IOMAN_LINK_TIMEOUT (10)       // [s] a link that stops acknowledging for this long is taken as failed, and routed around
+#define IOMAN_RESEND_TIMEOUT (IOMAN_LINK_TIMEOUT) // [s] chunks to a destination that acknowledged nothing for this long are sent again
+#define IOMAN_RESEND_CHECK (1.0)      // [s] interval of looking for such destinations
 
 struct ioman{
   int node_id;
   comm_node_t comm;
-  char node_hostname[20];
+  char node_hostname[CHANNEL_HOSTNAME_LEN];
 
   int pipe_R[2];
   
   channel_list_t channels;
   channel_t *channel_map;
   int maxpeers;
+  long *link_queued; /* bytes queued to each peer, updated atomically as channel_map is not safe to walk from other threads */
+
+  /* per-thread submission queues (local pseudo-channels). */
+  /* each producer thread pushes chunks only to its own queue, */
+  /* which is registered once and then drained by the ioman thread */
+  channel_list_t local_chans;
+  pthread_key_t local_key;
 
-  channel_t local_chan;
   sock_t lsock;
   pthread_t handler;
   pthread_mutex_t lock;
@@ -50,27 +68,67 @@ struct ioman{
   fd_set R_fds, W_fds;
   int fdset_valid;
 
+  double last_tune;
+
+  /* io_uring backend, NULL if select() is used */
+  uring_t uring;
+  uring_slot pipe_slot;
+  uring_slot timer_slot;
+  msg_buff_pool_t pool; /* registered buffers for relayed chunks */
+
+  int zerocopy; /* links connected from now on send large chunks with MSG_ZEROCOPY */
+  long dropped_msgs; /* messages whose destination had no link when sent */
+  resend_t resend;   /* data chunks sent from here and not acknowledged yet */
+  int resend_all;    /* routes changed, send them all again */
+  double resend_check;
+  int nshm_rx; /* channels reading from shared memory rings */
+
+  channel_budget budget; /* shared by all channels */
+
+  /* next hops of the multicast chunk being relayed */
+  int *mcast_nexts;
+  int *mcast_lanes;
+
 /*   int use_cache; */
 /*   int use_total; */
   
 };
 
-ioman_t ioman_create(int node_id, comm_node_t comm, int maxpeers);
+ioman_t ioman_create(int node_id, comm_node_t comm, int maxpeers, int io_backend);
 void ioman_destroy(ioman_t ioman);
 
 void ioman_register_channel(ioman_t man, int dst_id, channel_t chan);
+void ioman_register_stream(ioman_t man, int dst_id, channel_t chan);
+void ioman_reply_msg(ioman_t man, channel_t chan, int kind, const void* buff, int len);
 
 int ioman_get_nsocks(ioman_t man);
+int ioman_links(ioman_t man, int* pids);
 void ioman_get_traffic_info(ioman_t man, long *rx_count, long *tx_count);
 void ioman_get_send_buffer_info(ioman_t man, long *count);
 void ioman_channel_tcp_info_print(ioman_t man, int dst_id);
 void ioman_start(ioman_t man);
 void ioman_stop(ioman_t man);
 int ioman_listen_port(ioman_t man);
-int ioman_new_connection(ioman_t man, const char* addr, int port, channel_t* chan);
+void ioman_set_zerocopy(ioman_t man, int on);
+void ioman_shm_start_rx(ioman_t man, channel_t chan);
+void ioman_resend(ioman_t man);
+void ioman_ack_chunk(ioman_t man, int from, sid_t sid, int seq);
+void ioman_forget_peer(ioman_t man, int pid);
+int ioman_try_send_msg(ioman_t man, int kind, int dst_id, const void* buff, int len);
+void ioman_tune_link(ioman_t man, int dst_id);
+const char* ioman_hostname(ioman_t man);
+int ioman_new_connection(ioman_t man, const char* addr, int port, int stream_dst, int lane, channel_t* chan);
+
+/* the following may be called from any thread */
+channel_t ioman_get_local_channel(ioman_t man);
+long ioman_queued_bytes(ioman_t man, int dst_id);
+void ioman_set_link_width(ioman_t man, int dst_id, float width);
 void ioman_send_msg(ioman_t man, int kind, int dst_id, const void* buff, int len);
 void ioman_bcast_msg(ioman_t man, int kind, const void* buff, int len);
-void ioman_send_chunk(ioman_t man, int dst_id, sid_t sid, int tot_len, int seq, const void* buff, int len);
+void ioman_send_chunk(ioman_t man, int dst_id, int prio, int path, int tag, sid_t sid, int tot_len, int seq, int off, const void* buff, int len);
+void ioman_send_aggr(ioman_t man, channel_t via, int dst_id, sid_t sid, const void* buff, int len);
+void ioman_send_ctrl(ioman_t man, int kind, int dst_id, const void* buff, int len);
+void ioman_send_mcast(ioman_t man, int gid, int tag, sid_t sid, int tot_len, int seq, int off, const void* buff, int len);
 
 #endif // __IMPL_IOMAN_H__
 
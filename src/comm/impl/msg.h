@@ -13,6 +13,27 @@ enum msg_kind {
   MSG_TYPE_PONG1,
 
   MSG_TYPE_RT,
+  MSG_TYPE_STREAM0,
+  MSG_TYPE_STREAM1,
+  MSG_TYPE_SHM0,
+  MSG_TYPE_SHM1,
+  MSG_TYPE_SHM2,
+  MSG_TYPE_AGGR, // data chunk packing several small messages, relayed like MSG_TYPE_DATA
+  MSG_TYPE_MCAST, // data chunk to every member of group dst_id, duplicated by relays
+  MSG_TYPE_LINKDOWN, // two nodes lost their link, flooded so that everyone reroutes alike
+  MSG_TYPE_JOIN,    // a node joined, passed on as an echo wave, see comm_node_join()
+  MSG_TYPE_LEAVE,   // a node is leaving, passed on likewise
+  MSG_TYPE_RTCOPY,  // routing table handed to a node that joined, not passed on
+  MSG_TYPE_MEMBERS, // members of COMM_GROUP_ALL, handed to a node that joined
+  MSG_TYPE_BARRIER, // barrier signal, relayed hop by hop as a control message, see comm_node_send_barrier()
+  MSG_TYPE_ACK,     // data chunks received, relayed back to their source likewise, see comm_node_ack_chunk()
+};
+
+/* scheduling class of a data message, carried in the header so relays honor it */
+enum msg_prio{
+  MSG_PRIO_LOW,
+  MSG_PRIO_NORMAL,
+  MSG_PRIO_HIGH,
 };
 
 typedef uint64_t sid_t;
@@ -28,6 +49,14 @@ typedef struct msg_info{
   sid_t sid;
   int tot_len;
   int seq;
+  int off; /* byte offset of chunk in message */
+  int prio;
+  int path; /* which of the routes from src_id to dst_id the chunk takes */
+  int cong; /* [%] fullest send queue the chunk joined on its way so far */
+  int echo; /* (path << 8 | cong) of chunks from dst_id to src_id, fed back to dst_id. -1 if none */
+  int tag;  /* 0 for user messages, else the collective operation step the message belongs to */
+  sid_t flow_seq;   /* number of the message among those from src_id to dst_id, see resend_keep() */
+  sid_t flow_acked; /* messages numbered below were acknowledged in full when the chunk was sent */
   
 } msg_info, *msg_info_t;
 
@@ -41,6 +70,20 @@ void msg_info_destroy(msg_info_t minfo);
 void msg_info_unpack(msg_info_t minfo, const void** header);
 void msg_info_pack(msg_info_t minfo, void **header);
 
+/* fixed-size buffers carved out of one region, */
+/* so the region can be registered with the kernel once */
+typedef struct msg_buff_pool{
+  void* base;
+  int buff_len;
+  int nbuffs;
+  void** free_buffs;
+  int nfree;
+} msg_buff_pool, *msg_buff_pool_t;
+
+msg_buff_pool_t msg_buff_pool_create(int nbuffs, int buff_len);
+void msg_buff_pool_destroy(msg_buff_pool_t pool);
+long msg_buff_pool_size(msg_buff_pool_t pool);
+
 typedef struct msg_buff{
   int len;
   void* data;
@@ -48,11 +91,19 @@ typedef struct msg_buff{
   void* tail;
   
   int using_ext_buff;
+  msg_buff_pool_t pool; /* data is returned here, if taken from a pool */
+  unsigned int zc_id;   /* zerocopy send that must complete before data is released */
+
+  /* shares of one buffer each hold a reference on the first, which owns data */
+  int refs;
+  struct msg_buff* owner; /* NULL if this is the owner */
   
 } msg_buff, *msg_buff_t;
 
 msg_buff_t msg_buff_create(int len);
 msg_buff_t msg_buff_create_on_buff(int len, void* buff_to_use);
+msg_buff_t msg_buff_create_from_pool(msg_buff_pool_t pool, int len);
+msg_buff_t msg_buff_share(msg_buff_t buff);
 void msg_buff_destroy(msg_buff_t buff);
 const void** msg_buff_head(msg_buff_t buff);
 void** msg_buff_tail(msg_buff_t buff);
@@ -68,9 +119,12 @@ typedef struct data_msg{
   int recvd;
 
   int seq;
+  int tag;
   double start_time;
   
   msg_buff_list_t chunk_list;
+  char* chunk_state; /* by seq, see data_msg_chunk_state() */
+  int nchunk_state;
   
   void* user_msg_data;
   
@@ -78,16 +132,25 @@ typedef struct data_msg{
 
 data_msg_t data_msg_create(int len, int src_id, double t);
 void* data_msg_destroy(data_msg_t msg);
-void* data_msg_buff_tail(data_msg_t msg);
+void* data_msg_buff_at(data_msg_t msg, int off);
 int data_msg_push_chunk(data_msg_t msg, const msg_info_t header, const msg_buff_t chunk);
+int data_msg_chunk_state(data_msg_t msg, int seq);
+void data_msg_set_chunk_state(data_msg_t msg, int seq, int state);
 
 LIST_MAKE_TYPE_INTERFACE(data_msg);
-HASHMAP_MAKE_TYPE_INTERFACE(data_msg);
+OPENMAP_MAKE_TYPE_INTERFACE(data_msg);
 
 enum data_msg_status {
   DATA_MSG_MORE,
   DATA_MSG_FULL,
 };
 
+/* a chunk may arrive more than once when its source sent it again */
+enum data_msg_chunk_state {
+  DATA_MSG_CHUNK_NONE,
+  DATA_MSG_CHUNK_READING, /* being read into the message */
+  DATA_MSG_CHUNK_RECVD,
+};
+
 
 #endif // __IMPL_MSG_H__
@@ -0,0 +1,43 @@
+#ifndef __IMPL_REROUTE_H__
+#define __IMPL_REROUTE_H__
+
+#include <struct/rtable.h>
+#include "comm.h"
+
+/* routes of all sources as they were exchanged, and the turns they make. */
+/* a route avoiding failed links only makes turns from one channel (a directed */
+/* link on a lane) to the next that some original route made, so the channel */
+/* dependencies stay a subset of the original ones, and deadlock-free if those were */
+typedef struct reroute{
+  int npeers;                   /* node ids are below it */
+  overlay_rtable_entry_t* orig; /* [src * npeers + dst] */
+
+  int* link_id;  /* [u * npeers + v] -> directed link number + 1, 0 if no route takes it */
+  int nlinks;
+  int* link_src;
+  int* link_dst;
+  char* dead;    /* [link] */
+
+  /* channel = link * COMM_MAX_LANES + lane. turns as adjacency lists */
+  int nchans;
+  char* used;      /* [chan] taken by some route */
+  int* succ_first; /* [chan .. chan + 1) in succs */
+  int* succs;
+  int* pred_first;
+  int* preds;
+
+  /* replaced routes. user threads read routes without locking, */
+  /* so these are only freed with the node */
+  overlay_rtable_entry_t* retired;
+  int nretired;
+  int retired_cap;
+} reroute, *reroute_t;
+
+reroute_t reroute_create(comm_node_t node);
+void reroute_destroy(reroute_t r, comm_node_t node);
+int reroute_link_down(reroute_t r, comm_node_t node, int u, int v);
+int reroute_node_down(reroute_t r, comm_node_t node, int pid);
+reroute_t reroute_renew(reroute_t r, comm_node_t node);
+int reroute_entry_dead(reroute_t r, overlay_rtable_entry_t e);
+
+#endif // __IMPL_REROUTE_H__
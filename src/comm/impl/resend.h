@@ -0,0 +1,56 @@
+#ifndef __IMPL_RESEND_H__
+#define __IMPL_RESEND_H__
+
+#include <std/list.h>
+#include <std/map.h>
+#include "msg.h"
+
+/* data chunks this node sent, kept until their destinations acknowledge them, */
+/* so that those lost with a failed link can be sent again by the new routes. */
+/* messages are numbered per flow (to one destination, or multicast to one group) */
+/* in the order the ioman thread takes their first chunk, which lets destinations */
+/* tell chunks sent again from those they got already. ioman thread only */
+
+typedef struct resend_chunk{
+  msg_buff_t buff; /* share of the chunk as sent, header included */
+  int seq;
+  double sent;     /* when it was last sent */
+  int* waiting;    /* members yet to acknowledge a multicast chunk, NULL for others */
+  int nwaiting;
+} resend_chunk, *resend_chunk_t;
+
+LIST_MAKE_TYPE_INTERFACE(resend_chunk);
+
+typedef struct resend_msg{
+  sid_t sid;
+  sid_t flow_seq;
+  int flow;
+  int left; /* bytes whose chunks were not taken yet */
+  resend_chunk_list_t chunks; /* taken, and not acknowledged yet */
+} resend_msg, *resend_msg_t;
+
+LIST_MAKE_TYPE_INTERFACE(resend_msg);
+OPENMAP_MAKE_TYPE_INTERFACE(resend_msg);
+
+typedef struct resend_flow{
+  sid_t next_seq;
+  resend_msg_list_t msgs; /* not acknowledged in full, by number */
+  double last_ack;
+} resend_flow, *resend_flow_t;
+
+typedef struct resend{
+  int maxpeers;
+  int nflows;         /* to each node, then to each group */
+  resend_flow_t flows;
+  resend_msg_open_map_t msgs; /* by sid */
+  long nchunks;
+} resend, *resend_t;
+
+resend_t resend_create(int maxpeers, int maxgroups);
+void resend_destroy(resend_t r);
+void resend_keep(resend_t r, msg_info_t minfo, msg_buff_t chunk, const int* members, int nmembers, double now);
+void resend_ack(resend_t r, int from, sid_t sid, int seq, double now);
+void resend_forget_peer(resend_t r, int pid);
+sid_t resend_flow_acked(resend_t r, int flow);
+
+#endif // __IMPL_RESEND_H__
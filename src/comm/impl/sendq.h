@@ -0,0 +1,47 @@
+#ifndef __IMPL_SENDQ_H__
+#define __IMPL_SENDQ_H__
+
+#include <std/list.h>
+#include <std/map.h>
+#include "msg.h"
+
+#define SENDQ_QUANTUM (64 * 1024) // bytes a flow of weight 1 may send per round
+#define SENDQ_FLOW_WEIGHT(prio) (1 << (2 * (prio))) // MSG_PRIO_LOW: 1, NORMAL: 4, HIGH: 16
+
+/* chunks of one flow, kept in the order they were queued */
+typedef struct sendq_flow{
+  unsigned long key;
+  int weight;
+  long deficit; /* bytes it may still send in this round */
+  msg_buff_list_t queue;
+} sendq_flow, *sendq_flow_t;
+
+LIST_MAKE_TYPE_INTERFACE(sendq_flow);
+OPENMAP_MAKE_TYPE_INTERFACE(sendq_flow);
+
+/* send queue of a channel: one FIFO per flow, served by deficit round robin */
+/* so that a bulk transfer does not hold back other flows sharing the link. */
+/* control messages have a FIFO of their own, always served first */
+typedef struct sendq{
+  msg_buff_list_t control;
+  sendq_flow_open_map_t flows; /* only flows with queued chunks */
+  sendq_flow_list_t active;    /* service order */
+  msg_buff_t head;             /* taken off its flow, being sent */
+  msg_buff_t last;             /* most recently pushed */
+  int size;                    /* num. of chunks, including head */
+  long bytes;
+} sendq, *sendq_t;
+
+unsigned long sendq_flow_key(int src_id, int dst_id, int prio);
+
+sendq_t sendq_create();
+void sendq_destroy(sendq_t q);
+void sendq_push(sendq_t q, msg_buff_t buff, unsigned long key, int prio);
+void sendq_push_control(sendq_t q, msg_buff_t buff);
+msg_buff_t sendq_head(sendq_t q);
+msg_buff_t sendq_pop(sendq_t q);
+msg_buff_t sendq_last(sendq_t q);
+int sendq_size(sendq_t q);
+long sendq_bytes(sendq_t q);
+
+#endif // __IMPL_SENDQ_H__
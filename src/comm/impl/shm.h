@@ -0,0 +1,52 @@
+#ifndef __IMPL_SHM_H__
+#define __IMPL_SHM_H__
+
+#define SHM_RING_SIZE (4 * 1024 * 1024) // bytes buffered per direction, must be a power of 2
+#define SHM_NAME_LEN (64)
+#define SHM_CACHE_LINE (64)
+
+enum shm_side{
+  SHM_SIDE_CONNECTOR,
+  SHM_SIDE_ACCEPTOR,
+};
+
+/* single-producer single-consumer byte ring, */
+/* head and tail only grow and are kept on separate cache lines */
+typedef struct shm_ring{
+  volatile long head; /* written by producer */
+  char pad0[SHM_CACHE_LINE - sizeof(long)];
+  volatile long tail; /* written by consumer */
+  char pad1[SHM_CACHE_LINE - sizeof(long)];
+  volatile int rx_wait; /* consumer found the ring empty and waits for a doorbell */
+  volatile int tx_wait; /* producer found the ring full and waits for a doorbell */
+  char pad2[SHM_CACHE_LINE - 2 * sizeof(int)];
+  char data[SHM_RING_SIZE];
+} shm_ring, *shm_ring_t;
+
+/* segment mapped by both peers: ring[side] is written by that side */
+typedef struct shm_seg{
+  shm_ring ring[2];
+} shm_seg, *shm_seg_t;
+
+typedef struct shm{
+  char name[SHM_NAME_LEN];
+  int linked; /* name still exists in /dev/shm */
+  shm_seg_t seg;
+  shm_ring_t tx;
+  shm_ring_t rx;
+} shm, *shm_t;
+
+shm_t shm_create();
+shm_t shm_attach(const char* name);
+void shm_unlink_name(shm_t sh);
+void shm_destroy(shm_t sh);
+const char* shm_name(shm_t sh);
+
+int shm_write(shm_t sh, const void* buf, int n, int* bell);
+int shm_read(shm_t sh, void* buf, int n, int* bell);
+int shm_rx_pending(shm_t sh);
+int shm_rx_arm(shm_t sh);
+int shm_tx_space(shm_t sh);
+int shm_tx_arm(shm_t sh);
+
+#endif // __IMPL_SHM_H__
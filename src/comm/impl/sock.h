@@ -2,6 +2,8 @@
 #define __IMPL_SOCK_H__
 
 #include <iface/iface.h>
+#include "shm.h"
+#include "uring.h"
 
 enum connect_status{
   SOCK_CONNECT_OK,
@@ -21,11 +23,42 @@ enum recv_status{
   SOCK_RECV_ERR,
 };
 
+#define SOCK_DEFAULT_MAX_WINDOW (4 * 1024 * 1024) // used if the kernel limit cannot be read
+#define SOCK_ZEROCOPY_MIN (64 * 1024)             // sends at least this large use MSG_ZEROCOPY, if enabled
+#define SOCK_ZEROCOPY_MAX_COPIED (8)              // give up zerocopy after the kernel copied this many times anyway
+
 typedef struct sock{
   int fd;
   inet_iface_t dst_iface;
   int port;
 
+  /* shared memory transport with a co-located peer, NULL if plain TCP. */
+  /* each direction switches to its ring separately, after which */
+  /* the TCP connection only carries doorbell bytes */
+  shm_t shm;
+  int shm_tx;
+  int shm_rx;
+  int tx_blocked;   /* tx ring was full, waiting for a doorbell */
+  int bell_pending; /* doorbell to send once tx has switched */
+  int peer_closed;
+
+  /* io_uring backend, NULL for plain nonblocking calls. */
+  /* a try_recv/try_send posts the operation and reports EAGAIN, */
+  /* the same call made once it completed returns its result */
+  uring_t uring;
+  uring_slot rx_slot;
+  uring_slot tx_slot;
+  uring_slot poll_slot;
+
+  /* MSG_ZEROCOPY: every zerocopy send gets the next id, */
+  /* the kernel reports ids whose pages it released on the error queue */
+  int zerocopy;
+  unsigned int zc_sent;
+  unsigned int zc_done;
+  int zc_copied;
+
+  int io_timeout; /* [s] sock_recv_n() and sock_send_n() give up after waiting this long, 0 to wait on */
+
 } sock, *sock_t;
 
 sock_t base_sock_create(int fd, inet_iface_t dst_iface, int port);
@@ -34,6 +67,12 @@ int sock_fileno(sock_t sk);
 int sock_port(sock_t sk);
 inet_iface_t sock_iface(sock_t sk);
 struct tcp_info sock_tcp_info(sock_t sk);
+int sock_autotune_max();
+int sock_setopt_max();
+int sock_max_window();
+void sock_set_buffers(sock_t sk, int size);
+void sock_set_fail_timeout(sock_t sk, int timeout);
+void sock_set_io_timeout(sock_t sk, int timeout);
 void sock_print(sock_t sk);
 void sock_print_err(sock_t sk);
 sock_t listen_sock_create(int myport, int backlog);
@@ -47,4 +86,27 @@ int sock_recv_n(sock_t sk, void* buf, int n);
 int sock_try_send_n(sock_t sk, const void* buf, int n, int *nr);
 int sock_send_n(sock_t sk, const void* buf, int n);
 
+const char* sock_shm_create(sock_t sk);
+int sock_shm_attach(sock_t sk, const char* name);
+void sock_shm_abort(sock_t sk);
+void sock_shm_start_tx(sock_t sk);
+void sock_shm_start_rx(sock_t sk);
+int sock_is_shm_rx(sock_t sk);
+int sock_is_tx_blocked(sock_t sk);
+int sock_shm_rx_pending(sock_t sk);
+int sock_shm_rx_arm(sock_t sk);
+int sock_shm_doorbell(sock_t sk);
+int sock_shm_tx_unblock(sock_t sk);
+
+int sock_enable_zerocopy(sock_t sk);
+unsigned int sock_zc_sent(sock_t sk);
+int sock_zc_done(sock_t sk, unsigned int id);
+int sock_zc_reap(sock_t sk);
+
+void sock_set_uring(sock_t sk, uring_t ring);
+int sock_uring_rx_busy(sock_t sk);
+int sock_uring_tx_busy(sock_t sk);
+int sock_uring_poll(sock_t sk, int events);
+void sock_uring_cancel(sock_t sk);
+
 #endif // __IMPL_SOCK_H__
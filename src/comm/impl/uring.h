@@ -0,0 +1,58 @@
+#ifndef __IMPL_URING_H__
+#define __IMPL_URING_H__
+
+#include <stddef.h>
+#include <sys/time.h>
+
+#define URING_ENTRIES (256)
+
+enum uring_slot_state{
+  URING_SLOT_IDLE,
+  URING_SLOT_BUSY,
+  URING_SLOT_DONE,
+};
+
+/* one outstanding operation and, once completed, its result */
+typedef struct uring_slot{
+  int state;
+  int res;
+  const void* buf;
+} uring_slot, *uring_slot_t;
+
+/* minimal io_uring wrapper on the raw system calls */
+typedef struct uring{
+  int fd;
+
+  void* sq_ptr;
+  size_t sq_size;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned sq_entries;
+  void* sqes;
+  unsigned nprep; /* prepared but not submitted */
+
+  void* cq_ptr;
+  size_t cq_size;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  void* cqes;
+
+  long long timeout[2]; /* timespec read at submission */
+
+  /* registered buffer, ops inside it use the fixed variants */
+  const char* fixed_base;
+  long fixed_len;
+} uring, *uring_t;
+
+void uring_slot_init(uring_slot_t slot);
+
+uring_t uring_create(int entries);
+void uring_destroy(uring_t ring);
+int uring_register_buffer(uring_t ring, void* base, long len);
+
+void uring_prep_recv(uring_t ring, uring_slot_t slot, int fd, void* buf, int len);
+void uring_prep_send(uring_t ring, uring_slot_t slot, int fd, const void* buf, int len);
+void uring_prep_poll(uring_t ring, uring_slot_t slot, int fd, int events);
+void uring_prep_timeout(uring_t ring, uring_slot_t slot, const struct timeval* tv);
+void uring_prep_cancel(uring_t ring, uring_slot_t slot);
+void uring_submit(uring_t ring, int wait);
+
+#endif // __IMPL_URING_H__
@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <linux/tcp.h>
+#include <poll.h>
 
 #include <std/std.h>
 #include "impl/sock.h"
@@ -10,15 +11,27 @@
 
 #define SetMax(x, a, b) ( x = (a) > (b) ? (a) : (b) )
 
+static double
+get_curr_time(){
+  struct timeval tv;
+  std_gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec *1e-6;
+}
+
 ioman_t
-ioman_create(int node_id, comm_node_t comm, int maxpeers){
+ioman_create(int node_id, comm_node_t comm, int maxpeers, int io_backend){
   const int buff_size = IOMAN_NOTIFYPIPE_BUFF_SIZE;
   ioman_t man = (ioman_t)std_malloc(sizeof(ioman));
 
   man -> node_id = node_id;
   man -> comm = comm;
   
-  std_gethostname(man -> node_hostname, sizeof(man -> node_hostname));
+  /* same name gxp uses, so co-located peers can be recognized */
+  if(getenv("GXP_HOSTNAME") != NULL){
+    strncpy(man -> node_hostname, getenv("GXP_HOSTNAME"), sizeof(man -> node_hostname) - 1);
+    man -> node_hostname[sizeof(man -> node_hostname) - 1] = '\0';
+  }else
+    std_gethostname(man -> node_hostname, sizeof(man -> node_hostname));
 
   //printf("%d: %s\n", man -> node_id, man -> node_hostname);fflush(stdout);
 
@@ -32,8 +45,10 @@ ioman_create(int node_id, comm_node_t comm, int maxpeers){
 
   man -> channel_map = (channel_t*) std_calloc(maxpeers, sizeof(channel_t));
   man -> maxpeers = maxpeers;
+  man -> link_queued = (long*) std_calloc(maxpeers, sizeof(long));
 
-  man -> local_chan = channel_local_create(node_id);
+  man -> local_chans = channel_list_create();
+  std_pthread_key_create(&man -> local_key, NULL);
   man -> lsock = NULL;
 
   std_pthread_mutex_init(&man -> lock, NULL);
@@ -43,6 +58,35 @@ ioman_create(int node_id, comm_node_t comm, int maxpeers){
   FD_ZERO(&man -> W_fds);
   man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
 
+  man -> last_tune = 0.0;
+
+  man -> zerocopy = 0;
+  man -> dropped_msgs = 0;
+  man -> resend = resend_create(maxpeers, COMM_MAX_GROUPS);
+  man -> resend_all = 0;
+  man -> resend_check = 0.0;
+  man -> nshm_rx = 0;
+
+  man -> budget.cap = IOMAN_QUEUE_CAP;
+  man -> budget.queued = 0;
+
+  man -> mcast_nexts = std_malloc(sizeof(int) * maxpeers);
+  man -> mcast_lanes = std_malloc(sizeof(int) * maxpeers);
+
+  man -> uring = NULL;
+  man -> pool = NULL;
+  uring_slot_init(&man -> pipe_slot);
+  uring_slot_init(&man -> timer_slot);
+  if(io_backend == COMM_IO_URING){
+    if((man -> uring = uring_create(URING_ENTRIES)) == NULL)
+      fprintf(stderr, "%d: io_uring unavailable, using select\n", node_id);
+    else{
+      man -> pool = msg_buff_pool_create(IOMAN_URING_POOL_BUFFS, COMM_DATA_CHUNK_SIZE + CHANNEL_MSG_HEADERLEN);
+      /* without registration, I/O on the pool just uses the plain operations */
+      uring_register_buffer(man -> uring, man -> pool -> base, msg_buff_pool_size(man -> pool));
+    }
+  }
+
 /*   man -> use_cache = 0; */
 /*   man -> use_total = 0; */
   
@@ -56,10 +100,23 @@ ioman_destroy(ioman_t man){
   
   channel_list_destroy(man -> channels);
   std_free(man -> channel_map);
+  std_free(man -> link_queued);
+  std_free(man -> mcast_nexts);
+  std_free(man -> mcast_lanes);
     
   std_pthread_mutex_destroy(&man -> lock);
 
-  channel_local_destroy(man -> local_chan);
+  while(channel_list_size(man -> local_chans))
+    channel_local_destroy(channel_list_pop(man -> local_chans));
+  channel_list_destroy(man -> local_chans);
+  std_pthread_key_delete(man -> local_key);
+
+  resend_destroy(man -> resend);
+
+  if(man -> uring != NULL){
+    uring_destroy(man -> uring);
+    msg_buff_pool_destroy(man -> pool);
+  }
   
   std_free(man);
 }
@@ -71,6 +128,22 @@ ioman_register_channel(ioman_t man, int dst_id, channel_t chan){
   man -> channel_map[dst_id] = chan;
 /*   printf("%d: registered chan: %d\n", man -> node_id, dst_id);fflush(stdout); */
   chan -> peer_id = dst_id; /* register peer id */
+  channel_set_link_counter(chan, &man -> link_queued[dst_id]);
+}
+
+/* attach an extra parallel stream, or a virtual lane if chan -> lane is set, */
+/* to the channel registered for dst_id */
+void
+ioman_register_stream(ioman_t man, int dst_id, channel_t chan){
+  channel_t head = man -> channel_map[dst_id];
+  assert(head != NULL);
+  assert(chan -> peer_id == CHANNEL_PEER_UNKNOWN);
+  if(chan -> lane > 0)
+    channel_add_lane(head, chan);
+  else
+    channel_add_stream(head, chan);
+  chan -> peer_id = dst_id;
+  channel_set_link_counter(chan, &man -> link_queued[dst_id]);
 }
 
 void
@@ -79,9 +152,17 @@ ioman_delete_channel(ioman_t man, channel_t chan){
 
   dstid = chan -> peer_id;
   /* if channel has been registered with dstid, remove that */
-  if(dstid != CHANNEL_PEER_UNKNOWN){
+  if(chan -> lane > 0){
+    if(chan -> lane_head != NULL)
+      channel_remove_lane(chan -> lane_head, chan);
+  }
+  else if(chan -> stream_head != NULL){
+    channel_remove_stream(chan -> stream_head, chan);
+  }
+  else if(dstid != CHANNEL_PEER_UNKNOWN){
     assert(man -> channel_map[dstid] == chan);
-    man -> channel_map[dstid] = NULL;
+    /* surviving parallel streams keep the link alive */
+    man -> channel_map[dstid] = channel_promote_stream(chan);
   }
   channel_destroy(chan);
 
@@ -93,16 +174,37 @@ ioman_get_nsocks(ioman_t man){
   return channel_list_size(man -> channels);
 }
 
+/* neighbors this node has a link to, by increasing id. returns how many */
+int
+ioman_links(ioman_t man, int* pids){
+  int pid, n = 0;
+
+  for(pid = 0; pid < man -> maxpeers; pid++)
+    if(man -> channel_map[pid] != NULL)
+      pids[n ++] = pid;
+  return n;
+}
+
 void
 ioman_get_traffic_info(ioman_t man, long *rx_count, long *tx_count){
   channel_t chan;
-  int dstid;
+  int dstid, i;
 
   *rx_count = 0; *tx_count = 0;
   for(dstid = 0; dstid < man -> maxpeers; dstid++){
     if((chan = man -> channel_map[dstid]) != NULL){
       *rx_count += chan -> rx_count;
       *tx_count += chan -> tx_count;
+      for(i = 0; i < chan -> nstreams; i++){
+	*rx_count += chan -> streams[i] -> rx_count;
+	*tx_count += chan -> streams[i] -> tx_count;
+      }
+      for(i = 1; i < CHANNEL_MAX_LANES; i++){
+	if(chan -> lanes[i] != NULL){
+	  *rx_count += chan -> lanes[i] -> rx_count;
+	  *tx_count += chan -> lanes[i] -> tx_count;
+	}
+      }
     }
   }
 }
@@ -110,16 +212,30 @@ ioman_get_traffic_info(ioman_t man, long *rx_count, long *tx_count){
 void
 ioman_get_send_buffer_info(ioman_t man, long *count){
   channel_t chan;
-  int dstid;
+  int dstid, i;
 
   *count = 0;
   for(dstid = 0; dstid < man -> maxpeers; dstid++){
     if((chan = man -> channel_map[dstid]) != NULL){
-      *count += msg_buff_list_size(chan -> buff_queue);
+      *count += channel_queued_chunks(chan);
+      for(i = 0; i < chan -> nstreams; i++)
+	*count += channel_queued_chunks(chan -> streams[i]);
+      for(i = 1; i < CHANNEL_MAX_LANES; i++)
+	if(chan -> lanes[i] != NULL)
+	  *count += channel_queued_chunks(chan -> lanes[i]);
     }
   }
 }
 
+/* bytes waiting to be sent to a neighbor over all its streams and lanes. */
+/* may be called from any thread; the count moves while it is read */
+long
+ioman_queued_bytes(ioman_t man, int dst_id){
+  if(dst_id < 0 || dst_id >= man -> maxpeers)
+    return 0;
+  return __sync_fetch_and_add(&man -> link_queued[dst_id], 0);
+}
+
 void
 ioman_channel_tcp_info_print(ioman_t man, int dst_id){
   struct tcp_info info;
@@ -177,6 +293,29 @@ ioman_listen_port(ioman_t man){
   return sock_port(man -> lsock);
 }
 
+/* only the select backend sends with MSG_ZEROCOPY */
+void
+ioman_set_zerocopy(ioman_t man, int on){
+  man -> zerocopy = on;
+}
+
+/* node budget and per-socket modes for a channel joining the ioman thread */
+static void
+ioman_setup_channel(ioman_t man, channel_t chan){
+  sock_t sk = channel_get_sock(chan);
+
+  channel_set_budget(chan, &man -> budget);
+  sock_set_fail_timeout(sk, IOMAN_LINK_TIMEOUT);
+  sock_set_uring(sk, man -> uring);
+  if(man -> zerocopy && man -> uring == NULL)
+    sock_enable_zerocopy(sk);
+}
+
+const char*
+ioman_hostname(ioman_t man){
+  return man -> node_hostname;
+}
+
 void
 ioman_notify_newchan(ioman_t man, channel_t chan){
   int e = IOMAN_EVENT_NEWCHAN;
@@ -188,8 +327,11 @@ ioman_notify_newchan(ioman_t man, channel_t chan){
   
 }
 
+/* stream_dst is CHANNEL_PEER_UNKNOWN for a new link, */
+/* or the peer id if opening an extra parallel stream to an existing link, */
+/* which carries virtual lane 'lane' if it is not 0 */
 int
-ioman_new_connection(ioman_t man, const char* addr, int port, channel_t *chan){
+ioman_new_connection(ioman_t man, const char* addr, int port, int stream_dst, int lane, channel_t *chan){
   sock_t sk = connect_sock_create(addr, port);
 
   if(sock_connect(sk) == SOCK_CONNECT_ERR){
@@ -198,6 +340,8 @@ ioman_new_connection(ioman_t man, const char* addr, int port, channel_t *chan){
   }
 
   *chan = channel_setup_create(sk);
+  (*chan) -> stream_dst = stream_dst;
+  (*chan) -> lane = lane;
   ioman_notify_newchan(man, *chan);
   
   return IOMAN_CONNECT_OK;
@@ -210,11 +354,78 @@ ioman_handle_event_newchan(ioman_t man){
   assert(n == sizeof(channel_t));
 
   /* add channel to list */
+  ioman_setup_channel(man, chan);
   channel_list_append(man -> channels, chan);
 
   man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
 }
 
+/* returns the submission queue of the calling thread, */
+/* creating and registering it to the ioman thread on first use */
+channel_t
+ioman_get_local_channel(ioman_t man){
+  int e = IOMAN_EVENT_NEWLOCAL;
+  channel_t chan = pthread_getspecific(man -> local_key);
+
+  if(chan == NULL){
+    chan = channel_local_create(man -> node_id);
+    channel_set_budget(chan, &man -> budget);
+    std_pthread_setspecific(man -> local_key, chan);
+
+    std_pthread_mutex_lock(&man -> lock);
+    std_write(man -> pipe_R[1], &e, sizeof(int));
+    std_write(man -> pipe_R[1], &chan, sizeof(channel_t));
+    std_pthread_mutex_unlock(&man -> lock);
+  }
+  return chan;
+}
+
+void
+ioman_handle_event_newlocal(ioman_t man){
+  channel_t chan;
+  int n = std_read(man -> pipe_R[0], &chan, sizeof(channel_t));
+  assert(n == sizeof(channel_t));
+
+  sock_set_uring(channel_get_sock(chan), man -> uring);
+  channel_list_append(man -> local_chans, chan);
+
+  man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+}
+
+/* size the socket buffers of the link to dst_id, and of its streams and lanes, */
+/* from the RTT measured at connect time and the width known for the link */
+void
+ioman_tune_link(ioman_t man, int dst_id){
+  channel_t head = man -> channel_map[dst_id];
+
+  if(head != NULL)
+    channel_tune_link(head, man -> comm -> rtts[dst_id], man -> comm -> link_widths[dst_id]);
+}
+
+/* link widths are only written on the ioman thread, */
+/* which re-sizes the buffers of a link already connected */
+void
+ioman_set_link_width(ioman_t man, int dst_id, float width){
+  int e = IOMAN_EVENT_LINKWIDTH;
+
+  std_pthread_mutex_lock(&man -> lock);
+  std_write(man -> pipe_R[1], &e, sizeof(int));
+  std_write(man -> pipe_R[1], &dst_id, sizeof(int));
+  std_write(man -> pipe_R[1], &width, sizeof(float));
+  std_pthread_mutex_unlock(&man -> lock);
+}
+
+static void
+ioman_handle_event_linkwidth(ioman_t man){
+  int dst_id;
+  float width;
+  std_read(man -> pipe_R[0], &dst_id, sizeof(int));
+  std_read(man -> pipe_R[0], &width, sizeof(float));
+
+  man -> comm -> link_widths[dst_id] = width;
+  ioman_tune_link(man, dst_id);
+}
+
 void
 ioman_notify_newmsg(ioman_t man){
   int e = IOMAN_EVENT_NEWMSG;
@@ -239,11 +450,59 @@ ioman_sys_send_msg(ioman_t man, channel_t chan, int kind, int dst_id, const void
   msg_info_destroy(minfo);
 }
 
+/* to be used ONLY by ioman thread: a message to the neighbor dst_id, */
+/* or -1 if there is no link to it (any more) */
+int
+ioman_try_send_msg(ioman_t man, int kind, int dst_id, const void* buff, int len){
+  channel_t chan;
+
+  if(dst_id < 0 || (chan = man -> channel_map[dst_id]) == NULL)
+    return -1;
+  ioman_sys_send_msg(man, chan, kind, dst_id, buff, len);
+  man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+  return 0;
+}
+
+/* to be used ONLY by ioman thread: answer on the channel a message came from */
+void
+ioman_reply_msg(ioman_t man, channel_t chan, int kind, const void* buff, int len){
+  assert(chan -> peer_id != CHANNEL_PEER_UNKNOWN);
+  ioman_sys_send_msg(man, chan, kind, chan -> peer_id, buff, len);
+  man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+}
+
 void
 ioman_handle_event_newmsg(ioman_t man){
   man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
 }
 
+/* the peer left (or was never linked) after the message was queued */
+static void
+ioman_drop_msg(ioman_t man, int kind, int dst_id){
+  man -> dropped_msgs ++;
+  fprintf(stderr, "%d: no link to %d, dropped message of kind %d (%ld dropped)\n",
+	  man -> node_id, dst_id, kind, man -> dropped_msgs);
+}
+
+void
+ioman_handle_event_sendmsg(ioman_t man){
+  void *buff;
+  int kind, dst_id, len;
+  channel_t chan;
+  std_read(man -> pipe_R[0], &kind, sizeof(int));
+  std_read(man -> pipe_R[0], &dst_id, sizeof(int));
+  std_read(man -> pipe_R[0], &buff, sizeof(void*));
+  std_read(man -> pipe_R[0], &len, sizeof(int));
+
+  if((chan = man -> channel_map[dst_id]) != NULL)
+    ioman_sys_send_msg(man, chan, kind, dst_id, buff, len);
+  else
+    ioman_drop_msg(man, kind, dst_id);
+  std_free(buff); /* free what was alloc-ed in send_msg() */
+
+  man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+}
+
 void
 ioman_handle_event_bcastmsg(ioman_t man){
   int pid;
@@ -279,9 +538,18 @@ ioman_handle_event(ioman_t man){
   case IOMAN_EVENT_BCASTMSG:
     ioman_handle_event_bcastmsg(man);
     break;
+  case IOMAN_EVENT_SENDMSG:
+    ioman_handle_event_sendmsg(man);
+    break;
+  case IOMAN_EVENT_NEWLOCAL:
+    ioman_handle_event_newlocal(man);
+    break;
   case IOMAN_EVENT_NEWCHAN:
     ioman_handle_event_newchan(man);
     break;
+  case IOMAN_EVENT_LINKWIDTH:
+    ioman_handle_event_linkwidth(man);
+    break;
   default:
     fprintf(stderr, "ioman_handle_event: invalid event type: %d\n", e);
     exit(1);
@@ -317,11 +585,18 @@ ioman_set_fds(ioman_t man, fd_set *R_fds, fd_set *W_fds, int *maxfd){
     FD_SET(fd, R_fds);
     SetMax(*maxfd, *maxfd, fd);
     
-    /* local channel */
-    if(channel_is_readable(man -> local_chan)){
-      fd = sock_fileno(channel_get_sock(man -> local_chan));
-      FD_SET(fd, R_fds);
-      SetMax(*maxfd, *maxfd, fd);
+    /* local channels */
+    for(chan_cell = channel_list_head(man -> local_chans);
+	chan_cell != channel_list_end(man -> local_chans);
+	chan_cell = channel_list_cell_next(chan_cell)){
+
+      chan = channel_list_cell_data(chan_cell);
+
+      if(channel_is_readable(chan)){
+	fd = sock_fileno(channel_get_sock(chan));
+	FD_SET(fd, R_fds);
+	SetMax(*maxfd, *maxfd, fd);
+      }
     }
     
     /* channels */
@@ -331,7 +606,8 @@ ioman_set_fds(ioman_t man, fd_set *R_fds, fd_set *W_fds, int *maxfd){
       
       chan = channel_list_cell_data(chan_cell);
       
-      if(channel_is_readable(chan)){
+      /* a channel blocked on a full shared memory ring waits for a doorbell */
+      if(channel_is_readable(chan) || sock_is_tx_blocked(channel_get_sock(chan))){
 	fd = sock_fileno(channel_get_sock(chan));
 	FD_SET(fd, R_fds);
 	SetMax(*maxfd, *maxfd, fd);
@@ -368,9 +644,15 @@ ioman_check_set_fds(ioman_t man, fd_set *fds){
   if(FD_ISSET(sock_fileno(man -> lsock), fds))
     printf("lsock, ");
 
-  /* local channel */
-  if(FD_ISSET(sock_fileno(channel_get_sock(man -> local_chan)), fds))
-    printf("local, ");
+  /* local channels */
+  for(chan_cell = channel_list_head(man -> local_chans);
+      chan_cell != channel_list_end(man -> local_chans);
+      chan_cell = channel_list_cell_next(chan_cell)){
+
+    chan = channel_list_cell_data(chan_cell);
+    if(FD_ISSET(sock_fileno(channel_get_sock(chan)), fds))
+      printf("local, ");
+  }
 
   /* channels */
   for(chan_cell = channel_list_head(man -> channels);
@@ -389,18 +671,244 @@ ioman_check_set_fds(ioman_t man, fd_set *fds){
   
 }
 
+/* NULL if the route of the chunk does not go on from here by a live link: */
+/* its next hop is gone and the route was not changed yet, or its source's */
+/* route was changed while it was on its way and no longer passes here. */
+/* going on by another route would add channel dependencies, so the caller */
+/* drops the chunk, and its source sends it again (ioman_resend()) */
 channel_t
-ioman_get_nexthop_channel(ioman_t man, int src_id, int dst_id){
+ioman_get_nexthop_channel(ioman_t man, int src_id, int dst_id, int path){
   channel_t nexthop;
-  int nextpid = comm_node_lookup_rt(man -> comm, src_id, dst_id);
-  assert(nextpid != -1);
-  nexthop = man -> channel_map[nextpid];
-  if(nexthop == NULL){
-    fprintf(stdout, "%d: NEXTHOP: %d -> %d: next: %d\n", man -> node_id, src_id, dst_id, nextpid);
-    fflush(stdout);
+  int lane;
+  int nextpid = comm_node_lookup_rt_path(man -> comm, src_id, dst_id, path, &lane);
+
+  if(nextpid == -1)
+    return NULL;
+  if((nexthop = man -> channel_map[nextpid]) == NULL){
+    /* a link lost before the routes were known */
+    comm_node_link_down(man -> comm, man -> node_id, nextpid);
+    nextpid = comm_node_lookup_rt_path(man -> comm, src_id, dst_id, path, &lane);
+    if(nextpid == -1 || (nexthop = man -> channel_map[nextpid]) == NULL)
+      return NULL;
+  }
+  return channel_select_lane(nexthop, lane);
+}
+
+/* keep a data chunk this node sends until it is acknowledged, see resend_keep() */
+static void
+ioman_keep_chunk(ioman_t man, channel_t chan){
+  msg_info_t minfo = chan -> msg_info;
+  comm_group_t g;
+  int i, n = 0;
+
+  if(minfo -> kind == MSG_TYPE_MCAST){
+    g = man -> comm -> groups[minfo -> dst_id];
+    for(i = 0; i < g -> size; i++)
+      if(g -> members[i] != man -> node_id)
+	man -> mcast_nexts[n ++] = g -> members[i];
+    if(n > 0)
+      resend_keep(man -> resend, minfo, chan -> curr_buff, man -> mcast_nexts, n, get_curr_time());
+  }else if(comm_node_group_member(man -> comm, COMM_GROUP_ALL, minfo -> dst_id))
+    resend_keep(man -> resend, minfo, chan -> curr_buff, NULL, 0, get_curr_time());
+
+  channel_repack_header(chan);
+}
+
+/* send a kept chunk again by the routes of now. a copy is sent, as the chunk */
+/* may still be on its way out, with what was acknowledged of its flow updated */
+static void
+ioman_resend_chunk(ioman_t man, resend_chunk_t c, sid_t acked){
+  msg_info_t minfo = msg_info_create();
+  msg_buff_t copy = msg_buff_create(msg_buff_len(c -> buff));
+  const void* head = c -> buff -> data;
+  void* p = copy -> data;
+  channel_t next;
+  int i, n, lane, nextpid;
+
+  msg_info_unpack(minfo, &head);
+  minfo -> cong = 0;
+  minfo -> flow_acked = acked;
+  std_memcpy(copy -> data, c -> buff -> data, msg_buff_len(copy));
+  msg_info_pack(minfo, &p);
+  copy -> tail = copy -> data + msg_buff_len(copy);
+
+  /* no next hop is looked up through ioman_get_nexthop_channel(), */
+  /* which may reroute while the kept chunks are walked */
+  if(minfo -> kind != MSG_TYPE_MCAST){
+    nextpid = comm_node_lookup_rt_path(man -> comm, man -> node_id, minfo -> dst_id, minfo -> path, &lane);
+    if(nextpid != -1 && (next = man -> channel_map[nextpid]) != NULL
+       && (next = channel_select_lane(next, lane)) != NULL)
+      channel_requeue_chunk(next, msg_buff_share(copy), minfo);
+  }else{
+    n = comm_node_lookup_mcast(man -> comm, minfo -> dst_id, man -> node_id, man -> node_id, man -> mcast_nexts, man -> mcast_lanes);
+    for(i = 0; i < n; i++)
+      if((next = man -> channel_map[man -> mcast_nexts[i]]) != NULL
+	 && (next = channel_select_lane(next, man -> mcast_lanes[i])) != NULL)
+	channel_requeue_chunk(next, msg_buff_share(copy), minfo);
+  }
+  msg_buff_destroy(copy);
+  msg_info_destroy(minfo);
+}
+
+/* send again the kept chunks of a flow last sent at or before 'before' */
+static void
+ioman_resend_flow(ioman_t man, int f, double before, double now){
+  resend_msg_list_t msgs = man -> resend -> flows[f].msgs;
+  sid_t acked = resend_flow_acked(man -> resend, f);
+  resend_msg_list_cell_t mcell;
+  resend_chunk_list_cell_t cell;
+  resend_msg_t m;
+  resend_chunk_t c;
+
+  for(mcell = resend_msg_list_head(msgs); mcell != resend_msg_list_end(msgs); mcell = resend_msg_list_cell_next(mcell)){
+    m = resend_msg_list_cell_data(mcell);
+    for(cell = resend_chunk_list_head(m -> chunks); cell != resend_chunk_list_end(m -> chunks); cell = resend_chunk_list_cell_next(cell)){
+      c = resend_chunk_list_cell_data(cell);
+      if(c -> sent <= before){
+	ioman_resend_chunk(man, c, acked);
+	c -> sent = now;
+      }
+    }
+  }
+}
+
+/* routes changed: chunks not acknowledged yet may have been lost with a failed link, */
+/* or dropped on their way for want of a next hop. they are all sent again by the */
+/* new routes, once the events at hand are handled, so that reroutes coming */
+/* together send them once. copies that got through are dropped by their destination */
+void
+ioman_resend(ioman_t man){
+  man -> resend_all = 1;
+}
+
+/* flows that went without acknowledgements for IOMAN_RESEND_TIMEOUT have their chunks */
+/* sent again: lost on a route changed once more while they were on it, or dropped */
+/* by a relay that had not heard of the change yet */
+static void
+ioman_resend_stalled(ioman_t man, double now){
+  resend_t r = man -> resend;
+  int f;
+
+  for(f = 0; f < r -> nflows; f++){
+    if(resend_msg_list_size(r -> flows[f].msgs) > 0 && now - r -> flows[f].last_ack >= IOMAN_RESEND_TIMEOUT){
+      ioman_resend_flow(man, f, now - IOMAN_RESEND_TIMEOUT, now);
+      man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+    }
+  }
+}
+
+/* resend what is due, and return the time select() may block until it looks again */
+static struct timeval*
+ioman_resend_timeout(ioman_t man, struct timeval *tv, struct timeval *timeout){
+  double now, wait;
+  int f;
+
+  if(man -> resend -> nchunks == 0){
+    man -> resend_all = 0;
+    return timeout;
+  }
+
+  now = get_curr_time();
+  if(man -> resend_all){
+    man -> resend_all = 0;
+    for(f = 0; f < man -> resend -> nflows; f++)
+      ioman_resend_flow(man, f, now, now);
+    man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+  }
+  if(now >= man -> resend_check){
+    ioman_resend_stalled(man, now);
+    man -> resend_check = now + IOMAN_RESEND_CHECK;
+  }
+
+  wait = man -> resend_check - now;
+  if(timeout != NULL && timeout -> tv_sec + timeout -> tv_usec * 1e-6 <= wait)
+    return timeout;
+  tv -> tv_sec = (long)wait;
+  tv -> tv_usec = (long)((wait - tv -> tv_sec) * 1e6);
+  return tv;
+}
+
+/* node from got chunk seq of message sid, sent from this node */
+void
+ioman_ack_chunk(ioman_t man, int from, sid_t sid, int seq){
+  resend_ack(man -> resend, from, sid, seq, get_curr_time());
+}
+
+/* node pid left, chunks are no longer kept for it */
+void
+ioman_forget_peer(ioman_t man, int pid){
+  resend_forget_peer(man -> resend, pid);
+}
+
+/* mark the chunk with how full the queue it joins is, so that its destination */
+/* can report congestion back to the source, and have sources carry that report */
+static void
+ioman_stamp_chunk(ioman_t man, channel_t chan, channel_t next_chan){
+  msg_info_t minfo = chan -> msg_info;
+  long occ = ioman_queued_bytes(man, next_chan -> peer_id) * 100 / CHANNEL_QUEUE_BUDGET;
+
+  if(occ > 100)
+    occ = 100;
+  if(occ > minfo -> cong)
+    minfo -> cong = occ;
+  if(minfo -> src_id == man -> node_id)
+    minfo -> echo = comm_node_cong_echo(man -> comm, minfo -> dst_id);
+
+  channel_repack_header(chan);
+}
+
+/* set the next channels of a multicast chunk, by the routes from its source */
+/* to the group members, and return how many there are */
+static int
+ioman_mcast_fanout(ioman_t man, channel_t chan){
+  msg_info_t minfo = chan -> msg_info;
+  int from = minfo -> src_id == man -> node_id ? man -> node_id : chan -> peer_id;
+  int i, n;
+  channel_t next;
+
+  n = comm_node_lookup_mcast(man -> comm, minfo -> dst_id, minfo -> src_id, from, man -> mcast_nexts, man -> mcast_lanes);
+  channel_fanout_reset(chan);
+  for(i = 0; i < n; i++){
+    /* members past a failed link miss it */
+    if((next = man -> channel_map[man -> mcast_nexts[i]]) != NULL
+       && (next = channel_select_lane(next, man -> mcast_lanes[i])) != NULL)
+      channel_fanout_add(chan, next);
+  }
+  return chan -> nfanout;
+}
+
+/* a member that relays no further reads directly into the message */
+static void
+ioman_setup_mcast(ioman_t man, channel_t chan){
+  if(ioman_mcast_fanout(man, chan) == 0 && comm_node_group_member(man -> comm, chan -> msg_info -> dst_id, man -> node_id))
+    comm_node_setup_chunk(man -> comm, chan, chan -> msg_info);
+  else
+    channel_setup_chunk(chan, man -> pool);
+}
+
+static int
+ioman_read_mcast(ioman_t man, channel_t chan){
+  msg_info_t minfo = chan -> msg_info;
+  msg_buff_t msg;
+  int stat;
+
+  if((stat = channel_read_chunk(chan, &msg)) != CHANNEL_READ_DONE)
+    return stat;
+
+  if(chan -> nfanout == 0){
+    if(comm_node_group_member(man -> comm, minfo -> dst_id, man -> node_id))
+      comm_node_handle_chunk(man -> comm, chan, minfo, msg);
+    else
+      msg_buff_destroy(msg); /* a relay cut off by failed links */
+    chan -> curr_buff = NULL;
+  }else{
+    if(comm_node_group_member(man -> comm, minfo -> dst_id, man -> node_id))
+      comm_node_copy_chunk(man -> comm, chan, minfo, *msg_buff_head(msg) + CHANNEL_MSG_HEADERLEN);
+    channel_pipeline_fanout(chan);
+    man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
   }
-  assert(nexthop != NULL);
-  return nexthop;
+  assert(minfo -> remain == 0);
+  return stat;
 }
 
 int
@@ -414,12 +922,42 @@ ioman_process_local_channel_read(ioman_t man, channel_t chan){
   chan -> curr_buff = channel_local_pop_chunk(chan);
   
   //printf("%d: local_channel_read: ", man -> node_id);msg_info_print(chan -> msg_info); fflush(stdout);
+  if(chan -> msg_info -> kind == MSG_TYPE_MCAST){
+    ioman_keep_chunk(man, chan);
+    if(ioman_mcast_fanout(man, chan) == 0){ /* no member but this node, or all cut off */
+      msg_buff_destroy(chan -> curr_buff);
+      chan -> curr_buff = NULL;
+    }else
+      channel_pipeline_fanout(chan);
+    man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+    return 0;
+  }
+  if(chan -> msg_info -> kind != MSG_TYPE_DATA && chan -> msg_info -> kind != MSG_TYPE_AGGR){
+    /* a control message for a neighbor, see ioman_send_ctrl() */
+    if((next_chan = man -> channel_map[chan -> msg_info -> dst_id]) != NULL)
+      ioman_sys_send_msg(man, next_chan, chan -> msg_info -> kind, chan -> msg_info -> dst_id,
+			 *msg_buff_head(chan -> curr_buff) + CHANNEL_MSG_HEADERLEN, chan -> msg_info -> len);
+    else
+      ioman_drop_msg(man, chan -> msg_info -> kind, chan -> msg_info -> dst_id);
+    msg_buff_destroy(chan -> curr_buff);
+    chan -> curr_buff = NULL;
+    man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+    return 0;
+  }
   assert(chan -> msg_info -> src_id != chan -> msg_info -> dst_id);
+  ioman_keep_chunk(man, chan);
   
   /* acquire connect to next hop */
   next_chan = ioman_get_nexthop_channel(man,
 					chan -> msg_info -> src_id,
-					chan -> msg_info -> dst_id);
+					chan -> msg_info -> dst_id,
+					chan -> msg_info -> path);
+  if(next_chan == NULL){ /* sent again once rerouted */
+    msg_buff_destroy(chan -> curr_buff);
+    chan -> curr_buff = NULL;
+    return 0;
+  }
+  ioman_stamp_chunk(man, chan, next_chan);
   
   /* pass on to responsible next hop */
   /* pipeline that can fail to push, if so, need to block */
@@ -437,6 +975,10 @@ ioman_process_channel_read(ioman_t man, channel_t chan){
   channel_t next_chan;
   msg_buff_t msg;
 
+  /* zerocopy completions also make the socket readable */
+  if(channel_zc_release(chan) == -1)
+    return -1;
+
   /* read header to allocate buffer */
 /*   if(chan -> msg_info -> remain == 0){ */
   if(chan -> curr_buff == NULL){
@@ -450,7 +992,7 @@ ioman_process_channel_read(ioman_t man, channel_t chan){
 
 /*     printf("%d: read header: ", man -> node_id); msg_info_print(chan -> msg_info); fflush(stdout); */
     
-    if(msg_kind == MSG_TYPE_DATA){
+    if(msg_kind == MSG_TYPE_DATA || msg_kind == MSG_TYPE_AGGR){
       
 
       if(chan -> msg_info -> dst_id == man -> node_id){
@@ -458,16 +1000,18 @@ ioman_process_channel_read(ioman_t man, channel_t chan){
 	comm_node_setup_chunk(man -> comm, chan, chan -> msg_info);
       }else{
 	/* alloc chunk-size buff */
-	channel_setup_chunk(chan); 
+	channel_setup_chunk(chan, man -> pool);
       }
     }
+    else if(msg_kind == MSG_TYPE_MCAST)
+      ioman_setup_mcast(man, chan);
     else
       channel_setup_msg(chan); /* alloc FULL msg size buff */
   }
 
   /* printf("%d: reading body: ", man -> node_id); msg_info_print(chan -> msg_info); fflush(stdout); */
   /* read body */
-  if(chan -> msg_info -> kind == MSG_TYPE_DATA){
+  if(chan -> msg_info -> kind == MSG_TYPE_DATA || chan -> msg_info -> kind == MSG_TYPE_AGGR){
     /* pass on to next node */
     if((stat = channel_read_chunk(chan, &msg)) == CHANNEL_READ_DONE){
       if(chan -> msg_info -> dst_id == man -> node_id){
@@ -477,9 +1021,15 @@ ioman_process_channel_read(ioman_t man, channel_t chan){
       }else{
 	next_chan = ioman_get_nexthop_channel(man,
 					      chan -> msg_info -> src_id,
-					      chan -> msg_info -> dst_id);
-
-	channel_pipeline_chunk(chan, next_chan);
+					      chan -> msg_info -> dst_id,
+					      chan -> msg_info -> path);
+	if(next_chan == NULL){ /* its source sends it again */
+	  msg_buff_destroy(chan -> curr_buff);
+	  chan -> curr_buff = NULL;
+	}else{
+	  ioman_stamp_chunk(man, chan, next_chan);
+	  channel_pipeline_chunk(chan, next_chan);
+	}
 
 	man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
       }
@@ -487,6 +1037,8 @@ ioman_process_channel_read(ioman_t man, channel_t chan){
       assert(chan -> msg_info -> remain == 0);
     }
   }
+  else if(chan -> msg_info -> kind == MSG_TYPE_MCAST)
+    stat = ioman_read_mcast(man, chan);
   else{
     /* receive message */
     if((stat = channel_read_msg(chan, &msg)) == CHANNEL_READ_DONE){
@@ -532,16 +1084,137 @@ ioman_process_channel_write(ioman_t man, channel_t chan){
     if((stat = channel_write(chan, &unblock)) == CHANNEL_WRITE_ERR)
       return -1;
 
-    /* need to re-set fdset if send-queue becomes empty or some producer is unblocked */
-    if(stat == CHANNEL_WRITE_OK || unblock)
+    /* need to re-set fdset if send-queue becomes empty or some producer is unblocked, */
+    /* or if a shared memory ring filled up */
+    if(stat == CHANNEL_WRITE_OK || unblock || sock_is_tx_blocked(channel_get_sock(chan)))
       man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
   }
   return 0;
 }
 
+/* shared memory channels: the socket only rings a doorbell, */
+/* readiness is decided by the rings. returns -1 if the peer is gone */
+static int
+ioman_process_shm_doorbell(ioman_t man, channel_t chan, int rung){
+  sock_t sk = channel_get_sock(chan);
+
+  if(rung && sock_shm_doorbell(sk) != SOCK_RECV_OK){
+    /* nothing more will arrive, and nothing queued can be sent */
+    if(sock_is_tx_blocked(sk) || sock_shm_rx_pending(sk) == 0)
+      return -1;
+  }
+
+  if(sock_shm_tx_unblock(sk))
+    man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+
+  return channel_is_readable(chan) && sock_shm_rx_pending(sk) > 0;
+}
+
+/* whether select() must not block because a shared memory ring has data */
+static int
+ioman_shm_pending(ioman_t man){
+  channel_t chan;
+  channel_list_cell_t chan_cell;
+  int seen = 0;
+
+  for(chan_cell = channel_list_head(man -> channels);
+      chan_cell != channel_list_end(man -> channels) && seen < man -> nshm_rx;
+      chan_cell = channel_list_cell_next(chan_cell)){
+    chan = channel_list_cell_data(chan_cell);
+
+    if(!sock_is_shm_rx(channel_get_sock(chan)))
+      continue;
+    seen ++;
+    if(channel_is_readable(chan) && sock_shm_rx_arm(channel_get_sock(chan)) > 0)
+      return 1;
+  }
+  return 0;
+}
+
+/* the peer switched chan to shared memory, read from the ring from now on */
+void
+ioman_shm_start_rx(ioman_t man, channel_t chan){
+  sock_shm_start_rx(channel_get_sock(chan));
+  man -> nshm_rx ++;
+}
+
+static void
+ioman_forget_channel(channel_list_t chans, channel_t gone){
+  channel_list_cell_t cell;
+
+  for(cell = channel_list_head(chans); cell != channel_list_end(chans); cell = channel_list_cell_next(cell))
+    channel_forget(channel_list_cell_data(cell), gone);
+}
+
+/* a connection broke. if it was the last one of its link, routes taking the link */
+/* are changed on every node. the data chunks it held, and those blocked on it, */
+/* go on by the new routes where they have a next hop. those dropped here, those */
+/* already handed to its socket, and one it was reading are sent again by their sources */
+static void
+ioman_fail_channel(ioman_t man, channel_t chan){
+  msg_buff_list_t chunks = msg_buff_list_create();
+  channel_list_t waiters = channel_list_create();
+  msg_info_t minfo = msg_info_create();
+  int peer = chan -> peer_id;
+  int lane = chan -> lane;
+  channel_t waiter, next;
+  msg_buff_t buff;
+  const void* head;
+
+  if(sock_is_shm_rx(channel_get_sock(chan)))
+    man -> nshm_rx --;
+  if(chan -> curr_buff != NULL && chan -> state != CHANNEL_BLOCKING
+     && (chan -> msg_info -> kind == MSG_TYPE_DATA || chan -> msg_info -> kind == MSG_TYPE_AGGR
+	 || chan -> msg_info -> kind == MSG_TYPE_MCAST))
+    comm_node_abort_chunk(man -> comm, chan -> msg_info, chan -> curr_buff);
+  channel_salvage(chan, chunks, waiters);
+  ioman_forget_channel(man -> channels, chan);
+  ioman_forget_channel(man -> local_chans, chan);
+  ioman_delete_channel(man, chan);
+  /* routes keep to their lanes to stay deadlock free, */
+  /* so a link that lost one of its lanes is routed around as if it was gone */
+  if(peer != CHANNEL_PEER_UNKNOWN && (man -> channel_map[peer] == NULL || lane > 0)){
+    /* printf("%d: lost link to %d\n", man -> node_id, peer);fflush(stdout); */
+    comm_node_link_down(man -> comm, man -> node_id, peer);
+  }
+
+  while(msg_buff_list_size(chunks)){
+    buff = msg_buff_list_popleft(chunks);
+    head = buff -> data;
+    msg_info_unpack(minfo, &head);
+    if((minfo -> kind == MSG_TYPE_DATA || minfo -> kind == MSG_TYPE_AGGR)
+       && (next = ioman_get_nexthop_channel(man, minfo -> src_id, minfo -> dst_id, minfo -> path)) != NULL)
+      channel_requeue_chunk(next, buff, minfo);
+    else
+      msg_buff_destroy(buff);
+  }
+
+  while(channel_list_size(waiters)){
+    waiter = channel_list_popleft(waiters);
+    if(waiter -> msg_info -> kind != MSG_TYPE_MCAST){
+      next = ioman_get_nexthop_channel(man, waiter -> msg_info -> src_id, waiter -> msg_info -> dst_id, waiter -> msg_info -> path);
+      channel_fanout_reset(waiter);
+      if(next != NULL)
+	channel_fanout_add(waiter, next);
+    }
+    if(waiter -> nfanout > 0)
+      channel_pipeline_fanout(waiter);
+    else{
+      msg_buff_destroy(waiter -> curr_buff);
+      waiter -> curr_buff = NULL;
+      waiter -> state = CHANNEL_ACTIVE;
+    }
+  }
+
+  msg_buff_list_destroy(chunks);
+  channel_list_destroy(waiters);
+  msg_info_destroy(minfo);
+  man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+}
+
 int
 ioman_handle_readables(ioman_t man, fd_set *R_fds){
-  int fd, stat;
+  int fd, stat, ready;
   sock_t new_sock;
   channel_t chan, new_chan;
   channel_list_cell_t chan_cell, dead_cell;
@@ -560,33 +1233,44 @@ ioman_handle_readables(ioman_t man, fd_set *R_fds){
 
     /* add channel to list */
     new_chan = channel_active_create(new_sock);
+    ioman_setup_channel(man, new_chan);
     channel_list_append(man -> channels, new_chan);
 
     man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
   }
 
-  /* local chan */
-  fd = sock_fileno(channel_get_sock(man -> local_chan));
-  if(FD_ISSET(fd, R_fds)){
-    stat =ioman_process_local_channel_read(man, man -> local_chan);
-    assert(stat == 0);
+  /* local chans */
+  for(chan_cell = channel_list_head(man -> local_chans);
+      chan_cell != channel_list_end(man -> local_chans);
+      chan_cell = channel_list_cell_next(chan_cell)){
+    chan = channel_list_cell_data(chan_cell);
+    fd = sock_fileno(channel_get_sock(chan));
+
+    if(FD_ISSET(fd, R_fds)){
+      stat = ioman_process_local_channel_read(man, chan);
+      assert(stat == 0);
+    }
   }
 
   /* handle active channels */
   for(chan_cell = channel_list_head(man -> channels); chan_cell != channel_list_end(man -> channels);){
     chan = channel_list_cell_data(chan_cell);
     fd = sock_fileno(channel_get_sock(chan));
+    ready = FD_ISSET(fd, R_fds);
 
-    if(FD_ISSET(fd, R_fds)){
+    if(sock_is_shm_rx(channel_get_sock(chan)))
+      ready = ioman_process_shm_doorbell(man, chan, ready);
+
+    if(ready){
       //printf("%d: ioman_handle_readables fd: %d \n", man -> node_id, fd);fflush(stdout);
-      if(ioman_process_channel_read(man, chan) != 0){
+      if(ready == -1 || ioman_process_channel_read(man, chan) != 0){
 	/* if channel is dead, remove channel */
 	dead_cell = chan_cell;
 	chan_cell = channel_list_cell_next(dead_cell);
 	
 	channel_list_remove(man -> channels, dead_cell);
 /* 	printf("%d: error in channel_read :%d\n", man -> node_id, chan -> peer_id);fflush(stdout); */
-	ioman_delete_channel(man, chan);
+	ioman_fail_channel(man, chan);
 	continue;
       }
     }
@@ -621,7 +1305,7 @@ ioman_handle_writables(ioman_t man, fd_set *W_fds){
 	
 	channel_list_remove(man -> channels, dead_cell);
 /* 	printf("%d: error in channel_write :%d\n", man -> node_id, chan -> peer_id);fflush(stdout); */
-	ioman_delete_channel(man, chan);
+	ioman_fail_channel(man, chan);
 	continue;
       }
     }
@@ -636,11 +1320,31 @@ ioman_handle_writables(ioman_t man, fd_set *W_fds){
 
 void
 ioman_send_msg(ioman_t man, int kind, int dst_id, const void* buff, int len){
-  channel_t chan = man -> channel_map[dst_id];
-  assert(chan != NULL);
-  ioman_sys_send_msg(man, chan, kind, dst_id, buff, len);
-  /* notify io thread */
-  ioman_notify_newmsg(man);
+  int e = IOMAN_EVENT_SENDMSG;
+  void* local_buff;
+  channel_t chan;
+
+  /* the ioman thread owns the channel queues, so queue directly */
+  if(pthread_equal(pthread_self(), man -> handler)){
+    chan = man -> channel_map[dst_id];
+    assert(chan != NULL);
+    ioman_sys_send_msg(man, chan, kind, dst_id, buff, len);
+    man -> fdset_valid = IOMAN_FDSET_CACHE_INVALID;
+    return;
+  }
+
+  /* other threads hand over a copy of the message */
+  local_buff = std_malloc(len);
+  std_memcpy(local_buff, buff, len);
+
+  std_pthread_mutex_lock(&man -> lock);
+  std_write(man -> pipe_R[1], &e, sizeof(int));
+
+  std_write(man -> pipe_R[1], &kind, sizeof(int));
+  std_write(man -> pipe_R[1], &dst_id, sizeof(int));
+  std_write(man -> pipe_R[1], &local_buff, sizeof(void*));
+  std_write(man -> pipe_R[1], &len, sizeof(int));
+  std_pthread_mutex_unlock(&man -> lock);
 }
 
 void
@@ -660,11 +1364,14 @@ ioman_bcast_msg(ioman_t man, int kind, const void* buff, int len){
   std_pthread_mutex_unlock(&man -> lock);
 }
 
-void
-ioman_send_chunk(ioman_t man, int dst_id, sid_t sid, int tot_len, int seq, const void* buff, int len){
+static void
+ioman_send_chunk_of_kind(ioman_t man, channel_t via, int kind, int dst_id, int prio, int path, int tag, sid_t sid, int tot_len, int seq, int off, const void* buff, int len){
   msg_info_t minfo = msg_info_create();
 
-  minfo -> kind   = MSG_TYPE_DATA;
+  minfo -> kind   = kind;
+  minfo -> prio   = prio;
+  minfo -> path   = path;
+  minfo -> tag    = tag;
   minfo -> dst_id = dst_id;
   minfo -> src_id = man -> node_id;
   minfo -> len    = len;
@@ -673,16 +1380,187 @@ ioman_send_chunk(ioman_t man, int dst_id, sid_t sid, int tot_len, int seq, const
   minfo -> tot_len    = tot_len;
   minfo -> sid    = sid;
   minfo -> seq    = seq;
+  minfo -> off    = off;
 
-  /* push to local channel */
-  channel_local_push_chunk(man -> local_chan, minfo, buff, len);
+  /* push to the submission queue (normally of this thread); */
+  /* its pipe wakes up the ioman thread, so no global notify is needed */
+  channel_local_push_chunk(via, minfo, buff, len);
 
-  /* notify io thread */
-  ioman_notify_newmsg(man);
-  
   msg_info_destroy(minfo);
 }
 
+void
+ioman_send_chunk(ioman_t man, int dst_id, int prio, int path, int tag, sid_t sid, int tot_len, int seq, int off, const void* buff, int len){
+  ioman_send_chunk_of_kind(man, ioman_get_local_channel(man), MSG_TYPE_DATA, dst_id, prio, path, tag, sid, tot_len, seq, off, buff, len);
+}
+
+/* one chunk of small messages packed by the comm layer, pushed to via, */
+/* the submission queue of the thread that sent the messages */
+void
+ioman_send_aggr(ioman_t man, channel_t via, int dst_id, sid_t sid, const void* buff, int len){
+  ioman_send_chunk_of_kind(man, via, MSG_TYPE_AGGR, dst_id, MSG_PRIO_NORMAL, 0, 0, sid, len, 0, 0, buff, len);
+}
+
+/* a control message to the neighbor dst_id, through the submission queue */
+/* of this thread like chunks, but queued ahead of them all the way */
+void
+ioman_send_ctrl(ioman_t man, int kind, int dst_id, const void* buff, int len){
+  msg_info_t minfo = msg_info_create();
+
+  minfo -> kind   = kind;
+  minfo -> dst_id = dst_id;
+  minfo -> src_id = man -> node_id;
+  minfo -> len    = len;
+
+  channel_local_push_chunk(ioman_get_local_channel(man), minfo, buff, len);
+
+  msg_info_destroy(minfo);
+}
+
+/* one chunk of a message to every member of group gid */
+void
+ioman_send_mcast(ioman_t man, int gid, int tag, sid_t sid, int tot_len, int seq, int off, const void* buff, int len){
+  ioman_send_chunk_of_kind(man, ioman_get_local_channel(man), MSG_TYPE_MCAST, gid, MSG_PRIO_NORMAL, 0, tag, sid, tot_len, seq, off, buff, len);
+}
+
+#if IOMAN_TUNE_SOCK_BUFF
+
+/* re-size socket buffers of all links from the RTT currently seen by TCP */
+static void
+ioman_tune_channels(ioman_t man){
+  channel_t chan;
+  channel_list_cell_t chan_cell;
+  struct tcp_info info;
+
+  for(chan_cell = channel_list_head(man -> channels);
+      chan_cell != channel_list_end(man -> channels);
+      chan_cell = channel_list_cell_next(chan_cell)){
+    chan = channel_list_cell_data(chan_cell);
+
+    if(chan -> peer_id == CHANNEL_PEER_UNKNOWN || chan -> state == CHANNEL_SETUP ||
+       sock_is_shm_rx(channel_get_sock(chan)))
+      continue;
+
+    info = sock_tcp_info(channel_get_sock(chan));
+    if(info.tcpi_rtt > 0)
+      channel_tune_buffers(chan, info.tcpi_rtt * 1e-6, man -> comm -> link_widths[chan -> peer_id]);
+  }
+}
+
+/* time select() may block until the next tuning */
+static struct timeval*
+ioman_tune_timeout(ioman_t man, struct timeval *tv){
+  double now = get_curr_time();
+  double wait;
+
+  if(now - man -> last_tune >= IOMAN_TUNE_INTERVAL){
+    ioman_tune_channels(man);
+    man -> last_tune = now;
+  }
+  wait = man -> last_tune + IOMAN_TUNE_INTERVAL - now;
+  tv -> tv_sec = (long)wait;
+  tv -> tv_usec = (long)((wait - tv -> tv_sec) * 1e6);
+  return tv;
+}
+
+#endif // IOMAN_TUNE_SOCK_BUFF
+
+/* io_uring replacement for ioman_set_fds() and select(): */
+/* fds are reported ready when their operation completed, */
+/* or when a channel has to be called to post its next operation */
+static int
+ioman_uring_collect(ioman_t man, fd_set *R_fds, fd_set *W_fds){
+  channel_t chan;
+  channel_list_cell_t chan_cell;
+  sock_t sk;
+  int fd, nready = 0;
+
+  FD_ZERO(R_fds);
+  FD_ZERO(W_fds);
+
+  /* notify pipe */
+  if(man -> pipe_slot.state == URING_SLOT_DONE){
+    man -> pipe_slot.state = URING_SLOT_IDLE;
+    FD_SET(man -> pipe_R[0], R_fds);
+    nready ++;
+  }else if(man -> pipe_slot.state == URING_SLOT_IDLE)
+    uring_prep_poll(man -> uring, &man -> pipe_slot, man -> pipe_R[0], POLLIN);
+
+  /* listen sock */
+  if(sock_uring_poll(man -> lsock, POLLIN)){
+    FD_SET(sock_fileno(man -> lsock), R_fds);
+    nready ++;
+  }
+
+  /* local channels */
+  for(chan_cell = channel_list_head(man -> local_chans);
+      chan_cell != channel_list_end(man -> local_chans);
+      chan_cell = channel_list_cell_next(chan_cell)){
+    chan = channel_list_cell_data(chan_cell);
+    sk = channel_get_sock(chan);
+    if(channel_is_readable(chan) && sock_uring_poll(sk, POLLIN)){
+      FD_SET(sock_fileno(sk), R_fds);
+      nready ++;
+    }
+  }
+
+  /* channels */
+  for(chan_cell = channel_list_head(man -> channels);
+      chan_cell != channel_list_end(man -> channels);
+      chan_cell = channel_list_cell_next(chan_cell)){
+    chan = channel_list_cell_data(chan_cell);
+    sk = channel_get_sock(chan);
+    fd = sock_fileno(sk);
+
+    /* connect in progress */
+    if(chan -> state == CHANNEL_SETUP){
+      if(sock_uring_poll(sk, POLLOUT)){
+	FD_SET(fd, W_fds);
+	nready ++;
+      }
+      continue;
+    }
+
+    if(sock_is_shm_rx(sk)){
+      /* doorbells are polled, handle_readables looks at the rings */
+      if((channel_is_readable(chan) || sock_is_tx_blocked(sk)) && sock_uring_poll(sk, POLLIN)){
+	FD_SET(fd, R_fds);
+	nready ++;
+      }else if(channel_is_readable(chan) && sock_shm_rx_arm(sk) > 0)
+	nready ++;
+    }else if(channel_is_readable(chan) && !sock_uring_rx_busy(sk)){
+      FD_SET(fd, R_fds);
+      nready ++;
+    }
+
+    if(channel_is_writable(chan) && !sock_uring_tx_busy(sk)){
+      FD_SET(fd, W_fds);
+      nready ++;
+    }
+  }
+
+  return nready;
+}
+
+static void
+ioman_uring_wait(ioman_t man, fd_set *R_fds, fd_set *W_fds, struct timeval *timeout){
+  while(1){
+    if(timeout != NULL && man -> timer_slot.state == URING_SLOT_IDLE)
+      uring_prep_timeout(man -> uring, &man -> timer_slot, timeout);
+
+    if(ioman_uring_collect(man, R_fds, W_fds))
+      break;
+    if(man -> timer_slot.state == URING_SLOT_DONE){
+      man -> timer_slot.state = URING_SLOT_IDLE;
+      break;
+    }
+    /* nothing to do until something completes */
+    uring_submit(man -> uring, 1);
+  }
+  /* operations posted while handling these are submitted together next time */
+  uring_submit(man -> uring, 0);
+}
+
 void
 ioman_print_raw_set_fds(ioman_t man, int maxfd, fd_set *fds){
   int i;
@@ -701,15 +1579,30 @@ ioman_handler_loop(void* _man){
   fd_set R_fds, W_fds;
   int maxfd;
   int nready;
+  struct timeval tv, *timeout;
 
   while(1){
-    ioman_set_fds(man, &R_fds, &W_fds, &maxfd);
-
-    //printf("%d: select ... maxfd %d\n", man -> node_id, maxfd);fflush(stdout);
-    //printf("%d: waiting: \n", man -> node_id);fflush(stdout);
-    //printf("%d: R: ", man -> node_id); ioman_check_set_fds(man, &R_fds);fflush(stdout);
-    //printf("%d: W: ", man -> node_id); ioman_check_set_fds(man, &W_fds);fflush(stdout);
-    nready = std_select(maxfd + 1, &R_fds, &W_fds, NULL, NULL);
+    comm_node_flush_acks(man -> comm);
+    timeout = NULL;
+#if IOMAN_TUNE_SOCK_BUFF
+    timeout = ioman_tune_timeout(man, &tv);
+#endif
+    timeout = ioman_resend_timeout(man, &tv, timeout);
+    if(man -> uring != NULL)
+      ioman_uring_wait(man, &R_fds, &W_fds, timeout);
+    else{
+      ioman_set_fds(man, &R_fds, &W_fds, &maxfd);
+
+      //printf("%d: select ... maxfd %d\n", man -> node_id, maxfd);fflush(stdout);
+      //printf("%d: waiting: \n", man -> node_id);fflush(stdout);
+      //printf("%d: R: ", man -> node_id); ioman_check_set_fds(man, &R_fds);fflush(stdout);
+      //printf("%d: W: ", man -> node_id); ioman_check_set_fds(man, &W_fds);fflush(stdout);
+      if(man -> nshm_rx > 0 && ioman_shm_pending(man)){
+	tv.tv_sec = tv.tv_usec = 0;
+	timeout = &tv;
+      }
+      nready = std_select(maxfd + 1, &R_fds, &W_fds, NULL, timeout);
+    }
 
     //ioman_print_raw_set_fds(man, maxfd + 1, &R_fds);
     /* printf("%d: loop... ready %d maxfd %d\n", man -> node_id, nready, maxfd);fflush(stdout); */
@@ -729,5 +1622,6 @@ ioman_handler_loop(void* _man){
 void
 ioman_start(ioman_t man){
   man -> lsock = listen_sock_create(0, 128);
+  sock_set_uring(man -> lsock, man -> uring);
   std_pthread_create(&man -> handler, NULL, ioman_handler_loop, (void*)man);
 }
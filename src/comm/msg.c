@@ -10,7 +10,7 @@
 LIST_MAKE_TYPE_IMPLEMENTATION(msg_buff);
 
 LIST_MAKE_TYPE_IMPLEMENTATION(data_msg);
-HASHMAP_MAKE_TYPE_IMPLEMENTATION(data_msg);
+OPENMAP_MAKE_TYPE_IMPLEMENTATION(data_msg);
 
 msg_info_t
 msg_info_create(){
@@ -25,13 +25,21 @@ msg_info_create(){
   minfo -> sid = -1;
   minfo -> tot_len = -1;
   minfo -> seq = -1;
+  minfo -> off = -1;
+  minfo -> prio = MSG_PRIO_NORMAL;
+  minfo -> path = 0;
+  minfo -> cong = 0;
+  minfo -> echo = -1;
+  minfo -> tag = 0;
+  minfo -> flow_seq = 0;
+  minfo -> flow_acked = 0;
 
   return minfo;
 }
 
 void
 msg_info_print(msg_info_t minfo){
-  printf("minfo(kind:%d, dst:%d, src:%d, len:%d, remain:%d sid:%llu tot:%d seq:%d)\n",
+  printf("minfo(kind:%d, dst:%d, src:%d, len:%d, remain:%d sid:%llu tot:%d seq:%d off:%d)\n",
 	 minfo -> kind,
 	 minfo -> dst_id,
 	 minfo -> src_id,
@@ -39,7 +47,8 @@ msg_info_print(msg_info_t minfo){
 	 minfo -> remain,
 	 minfo -> sid,
 	 minfo -> tot_len,
-	 minfo -> seq);
+	 minfo -> seq,
+	 minfo -> off);
 }
 
 void
@@ -57,6 +66,14 @@ msg_info_unpack(msg_info_t minfo, const void** header){
   minfo -> sid = unpack_uint64(p);
   minfo -> tot_len = unpack_int(p);
   minfo -> seq = unpack_int(p);
+  minfo -> off = unpack_int(p);
+  minfo -> prio = unpack_int(p);
+  minfo -> path = unpack_int(p);
+  minfo -> cong = unpack_int(p);
+  minfo -> echo = unpack_int(p);
+  minfo -> tag = unpack_int(p);
+  minfo -> flow_seq = unpack_uint64(p);
+  minfo -> flow_acked = unpack_uint64(p);
   minfo -> remain = minfo -> len;
 }
 
@@ -71,6 +88,14 @@ msg_info_pack(msg_info_t minfo, void **header){
   pack_uint64(p, minfo -> sid);
   pack_int(p, minfo -> tot_len);
   pack_int(p, minfo -> seq);
+  pack_int(p, minfo -> off);
+  pack_int(p, minfo -> prio);
+  pack_int(p, minfo -> path);
+  pack_int(p, minfo -> cong);
+  pack_int(p, minfo -> echo);
+  pack_int(p, minfo -> tag);
+  pack_uint64(p, minfo -> flow_seq);
+  pack_uint64(p, minfo -> flow_acked);
 }
 
 /* msg_buff_t */
@@ -83,6 +108,35 @@ msg_info_pack(msg_info_t minfo, void **header){
 /*   return buff; */
 /* } */
 
+msg_buff_pool_t
+msg_buff_pool_create(int nbuffs, int buff_len){
+  msg_buff_pool_t pool = std_malloc(sizeof(msg_buff_pool));
+  int i;
+
+  pool -> base = std_malloc((long)nbuffs * buff_len);
+  pool -> buff_len = buff_len;
+  pool -> nbuffs = nbuffs;
+  pool -> free_buffs = std_malloc(sizeof(void*) * nbuffs);
+  for(i = 0; i < nbuffs; i++)
+    pool -> free_buffs[i] = pool -> base + (long)i * buff_len;
+  pool -> nfree = nbuffs;
+
+  return pool;
+}
+
+void
+msg_buff_pool_destroy(msg_buff_pool_t pool){
+  assert(pool -> nfree == pool -> nbuffs);
+  std_free(pool -> free_buffs);
+  std_free(pool -> base);
+  std_free(pool);
+}
+
+long
+msg_buff_pool_size(msg_buff_pool_t pool){
+  return (long)pool -> nbuffs * pool -> buff_len;
+}
+
 msg_buff_t
 msg_buff_create_on_buff(int len, void* buff_to_use){
   msg_buff_t buff = (msg_buff_t)std_malloc(sizeof(msg_buff));
@@ -97,6 +151,10 @@ msg_buff_create_on_buff(int len, void* buff_to_use){
     buff -> data = std_malloc(len);
     buff -> using_ext_buff = 0;
   }
+  buff -> pool = NULL;
+  buff -> zc_id = 0;
+  buff -> refs = 1;
+  buff -> owner = NULL;
   
   buff -> head = buff -> data;
   buff -> tail = buff -> data;
@@ -110,10 +168,50 @@ msg_buff_create(int len){
   return msg_buff_create_on_buff(len, NULL);
 }
 
+/* NULL if the pool is exhausted or its buffers are too small */
+msg_buff_t
+msg_buff_create_from_pool(msg_buff_pool_t pool, int len){
+  msg_buff_t buff;
+
+  if(pool == NULL || pool -> nfree == 0 || len > pool -> buff_len)
+    return NULL;
+
+  buff = msg_buff_create_on_buff(len, pool -> free_buffs[-- pool -> nfree]);
+  buff -> pool = pool;
+  return buff;
+}
+
+/* the same data with cursors of its own, to be sent on another channel */
+/* without copying. data is released when the last share is destroyed */
+msg_buff_t
+msg_buff_share(msg_buff_t buff){
+  msg_buff_t owner = buff -> owner != NULL ? buff -> owner : buff;
+  msg_buff_t share = (msg_buff_t)std_malloc(sizeof(msg_buff));
+
+  *share = *buff;
+  share -> zc_id = 0;
+  share -> owner = owner;
+  __sync_fetch_and_add(&owner -> refs, 1);
+
+  return share;
+}
+
 void
 msg_buff_destroy(msg_buff_t buff){
+  msg_buff_t owner = buff -> owner;
+
+  if(owner != NULL){
+    std_free(buff);
+    msg_buff_destroy(owner);
+    return;
+  }
+  if(__sync_sub_and_fetch(&buff -> refs, 1) > 0)
+    return;
+
   /* only free buffer if internally allocated */
-  if(buff -> using_ext_buff == 0)
+  if(buff -> pool != NULL)
+    buff -> pool -> free_buffs[buff -> pool -> nfree ++] = buff -> data;
+  else if(buff -> using_ext_buff == 0)
     std_free(buff -> data);
   
   std_free(buff);
@@ -153,9 +251,12 @@ data_msg_create(int len, int src_id, double t){
   msg -> src_id = src_id;
   msg -> recvd = 0;
   msg -> chunk_list = msg_buff_list_create();
+  msg -> chunk_state = NULL;
+  msg -> nchunk_state = 0;
   msg -> user_msg_data = (void*) std_malloc(len);
 
   msg -> seq = -1;
+  msg -> tag = 0;
   msg -> start_time = t;
 
   return msg;
@@ -170,26 +271,31 @@ data_msg_destroy(data_msg_t msg){
     msg_buff_destroy(chunk);
   }
   msg_buff_list_destroy(msg -> chunk_list);
+  if(msg -> chunk_state != NULL)
+    std_free(msg -> chunk_state);
 
   std_free(msg);
   return data;
 }
 
 void*
-data_msg_buff_tail(data_msg_t msg){
-  return (msg -> user_msg_data + msg -> recvd);
+data_msg_buff_at(data_msg_t msg, int off){
+  assert(off >= 0 && off < msg -> len);
+  return (msg -> user_msg_data + off);
 }
 
 int
 data_msg_push_chunk(data_msg_t msg, const msg_info_t header, const msg_buff_t chunk){
-  int dseq;
   assert(header -> src_id == msg -> src_id);
 
-  /* assert that seq is same or is only 1 apart */
-  dseq = header -> seq - msg -> seq;
-  assert(dseq == 0 || dseq == 1);
+  /* chunks may arrive out of order when striped over parallel streams, */
+  /* each was already placed at its offset, so only count bytes here */
+  assert(header -> off + msg_buff_len(chunk) <= msg -> len);
+  assert(data_msg_chunk_state(msg, header -> seq) != DATA_MSG_CHUNK_RECVD);
 
-  msg -> seq = header -> seq;
+  if(header -> seq > msg -> seq)
+    msg -> seq = header -> seq;
+  data_msg_set_chunk_state(msg, header -> seq, DATA_MSG_CHUNK_RECVD);
   
   msg_buff_list_append(msg -> chunk_list, chunk);
 
@@ -203,3 +309,23 @@ data_msg_push_chunk(data_msg_t msg, const msg_info_t header, const msg_buff_t ch
   else
     return DATA_MSG_MORE;
 }
+
+int
+data_msg_chunk_state(data_msg_t msg, int seq){
+  return seq < msg -> nchunk_state ? msg -> chunk_state[seq] : DATA_MSG_CHUNK_NONE;
+}
+
+void
+data_msg_set_chunk_state(data_msg_t msg, int seq, int state){
+  int n = msg -> nchunk_state;
+
+  assert(seq >= 0);
+  if(seq >= n){
+    msg -> nchunk_state = n ? 2 * n : 8;
+    while(seq >= msg -> nchunk_state)
+      msg -> nchunk_state *= 2;
+    msg -> chunk_state = std_realloc(msg -> chunk_state, msg -> nchunk_state);
+    memset(msg -> chunk_state + n, DATA_MSG_CHUNK_NONE, msg -> nchunk_state - n);
+  }
+  msg -> chunk_state[seq] = state;
+}
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <std/std.h>
+#include <struct/rtable.h>
+#include "impl/reroute.h"
+
+static overlay_rtable_entry_t
+reroute_get_entry(comm_node_t node, int src, int dst){
+  overlay_rtable_t rt = node -> rts[src];
+  return dst < rt -> nentry ? overlay_rtable_get_entry(rt, dst) : NULL;
+}
+
+/* directed link from u to v, -1 if no route takes it */
+static int
+reroute_link(reroute_t r, int u, int v){
+  return r -> link_id[u * r -> npeers + v] - 1;
+}
+
+/* channel of hop i of a route */
+static int
+reroute_hop_chan(reroute_t r, overlay_rtable_entry_t e, int i){
+  return reroute_link(r, e -> path[i], e -> path[i + 1]) * COMM_MAX_LANES + e -> lanes[i];
+}
+
+static int
+reroute_pair_cmp(const void* a, const void* b){
+  const int *x = a, *y = b;
+  return x[0] != y[0] ? x[0] - y[0] : x[1] - y[1];
+}
+
+/* adjacency lists of n vertices from (from, to) pairs, sorted and without duplicates */
+static void
+reroute_make_adj(int n, int* pairs, int npairs, int** first, int** adj){
+  int i, k;
+
+  qsort(pairs, npairs, 2 * sizeof(int), reroute_pair_cmp);
+  *first = std_calloc(n + 1, sizeof(int));
+  *adj = std_malloc(sizeof(int) * (npairs + 1));
+  for(k = 0, i = 0; i < npairs; i++){
+    if(i > 0 && pairs[2 * i] == pairs[2 * i - 2] && pairs[2 * i + 1] == pairs[2 * i - 1])
+      continue;
+    (*adj)[k ++] = pairs[2 * i + 1];
+    (*first)[pairs[2 * i] + 1] ++;
+  }
+  for(i = 0; i < n; i++)
+    (*first)[i + 1] += (*first)[i];
+}
+
+reroute_t
+reroute_create(comm_node_t node){
+  reroute_t r = std_malloc(sizeof(reroute));
+  overlay_rtable_entry_t e;
+  int n, s, d, i, l, c0, c1;
+  int *succ_pairs = NULL, *pred_pairs = NULL, npairs = 0, cap = 0;
+
+  for(n = 0; n < COMM_MAX_PEER && node -> rts[n] != NULL; n++);
+  r -> npeers = n;
+  r -> orig = std_calloc((long)n * n, sizeof(overlay_rtable_entry_t));
+  r -> link_id = std_calloc((long)n * n, sizeof(int));
+  r -> link_src = std_malloc(sizeof(int) * n * n);
+  r -> link_dst = std_malloc(sizeof(int) * n * n);
+  r -> nlinks = 0;
+
+  /* number the links the routes take */
+  for(s = 0; s < n; s++){
+    for(d = 0; d < n; d++){
+      if(s == d || (e = reroute_get_entry(node, s, d)) == NULL)
+	continue;
+      r -> orig[s * n + d] = e;
+      for(; e != NULL; e = e -> alt){
+	for(i = 0; i < e -> hops; i++){
+	  assert(e -> path[i + 1] < n && e -> lanes[i] < COMM_MAX_LANES);
+	  if(reroute_link(r, e -> path[i], e -> path[i + 1]) != -1)
+	    continue;
+	  l = r -> nlinks ++;
+	  r -> link_id[e -> path[i] * n + e -> path[i + 1]] = l + 1;
+	  r -> link_src[l] = e -> path[i];
+	  r -> link_dst[l] = e -> path[i + 1];
+	}
+      }
+    }
+  }
+
+  /* and the turns they make */
+  r -> nchans = r -> nlinks * COMM_MAX_LANES;
+  r -> used = std_calloc(r -> nchans, sizeof(char));
+  for(s = 0; s < n * n; s++){
+    for(e = r -> orig[s]; e != NULL; e = e -> alt){
+      for(i = 0; i < e -> hops; i++){
+	c1 = reroute_hop_chan(r, e, i);
+	r -> used[c1] = 1;
+	if(i == 0)
+	  continue;
+	c0 = reroute_hop_chan(r, e, i - 1);
+	if(npairs == cap){
+	  cap = cap ? 2 * cap : 1024;
+	  succ_pairs = std_realloc(succ_pairs, sizeof(int) * 2 * cap);
+	  pred_pairs = std_realloc(pred_pairs, sizeof(int) * 2 * cap);
+	}
+	succ_pairs[2 * npairs] = c0;
+	succ_pairs[2 * npairs + 1] = c1;
+	pred_pairs[2 * npairs] = c1;
+	pred_pairs[2 * npairs + 1] = c0;
+	npairs ++;
+      }
+    }
+  }
+  reroute_make_adj(r -> nchans, succ_pairs, npairs, &r -> succ_first, &r -> succs);
+  reroute_make_adj(r -> nchans, pred_pairs, npairs, &r -> pred_first, &r -> preds);
+  if(succ_pairs != NULL){
+    std_free(succ_pairs);
+    std_free(pred_pairs);
+  }
+
+  r -> dead = std_calloc(r -> nlinks + 1, sizeof(char));
+  r -> retired = NULL;
+  r -> nretired = 0;
+  r -> retired_cap = 0;
+  return r;
+}
+
+void
+reroute_destroy(reroute_t r, comm_node_t node){
+  int s, d, n = r -> npeers, i;
+
+  /* originals still in the routing tables go with them */
+  for(s = 0; s < n; s++)
+    for(d = 0; d < n; d++)
+      if(r -> orig[s * n + d] != NULL && reroute_get_entry(node, s, d) != r -> orig[s * n + d])
+	overlay_rtable_entry_destroy(r -> orig[s * n + d]);
+  for(i = 0; i < r -> nretired; i++)
+    overlay_rtable_entry_destroy(r -> retired[i]);
+  if(r -> retired != NULL)
+    std_free(r -> retired);
+
+  std_free(r -> orig);
+  std_free(r -> link_id);
+  std_free(r -> link_src);
+  std_free(r -> link_dst);
+  std_free(r -> used);
+  std_free(r -> succ_first);
+  std_free(r -> succs);
+  std_free(r -> pred_first);
+  std_free(r -> preds);
+  std_free(r -> dead);
+  std_free(r);
+}
+
+static int
+reroute_chan_live(reroute_t r, int c){
+  return r -> used[c] && !r -> dead[c / COMM_MAX_LANES];
+}
+
+/* whether a single route takes a failed link */
+static int
+reroute_entry_dead_one(reroute_t r, overlay_rtable_entry_t e){
+  int i;
+  for(i = 0; i < e -> hops; i++)
+    if(r -> dead[reroute_link(r, e -> path[i], e -> path[i + 1])])
+      return 1;
+  return 0;
+}
+
+/* whether a route, or one of its alternatives, takes a failed link */
+int
+reroute_entry_dead(reroute_t r, overlay_rtable_entry_t e){
+  for(; e != NULL; e = e -> alt)
+    if(reroute_entry_dead_one(r, e))
+      return 1;
+  return 0;
+}
+
+/* hops from each live channel to dst over allowed turns, -1 if it cannot reach it */
+static void
+reroute_dists(reroute_t r, int dst, int* dist, int* queue){
+  int c, p, k, head = 0, tail = 0;
+
+  for(c = 0; c < r -> nchans; c++){
+    dist[c] = -1;
+    if(reroute_chan_live(r, c) && r -> link_dst[c / COMM_MAX_LANES] == dst){
+      dist[c] = 0;
+      queue[tail ++] = c;
+    }
+  }
+  while(head < tail){
+    c = queue[head ++];
+    for(k = r -> pred_first[c]; k < r -> pred_first[c + 1]; k++){
+      p = r -> preds[k];
+      if(dist[p] == -1 && reroute_chan_live(r, p)){
+	dist[p] = dist[c] + 1;
+	queue[tail ++] = p;
+      }
+    }
+  }
+}
+
+static overlay_rtable_entry_t
+reroute_copy_entry(overlay_rtable_entry_t e){
+  overlay_rtable_entry_t copy = overlay_rtable_entry_create(e -> dst_pid, e -> path, e -> hops, e -> metric, e -> width);
+  overlay_rtable_entry_set_lanes(copy, e -> lanes);
+  return copy;
+}
+
+/* new route(s) from src to dst: the original alternatives left, if any, */
+/* else the shortest one over allowed turns, taking the lowest numbered channel */
+/* where there is a choice, so that every node derives the same route. */
+/* NULL if dst cannot be reached */
+static overlay_rtable_entry_t
+reroute_route(reroute_t r, int src, int dst, const int* dist){
+  overlay_rtable_entry_t orig = r -> orig[src * r -> npeers + dst], e, route = NULL;
+  int c, k, i, hops, *path, *lanes;
+
+  for(e = orig; e != NULL; e = e -> alt){
+    if(reroute_entry_dead_one(r, e))
+      continue;
+    if(route == NULL)
+      route = reroute_copy_entry(e);
+    else
+      overlay_rtable_entry_add_alt(route, reroute_copy_entry(e));
+  }
+  if(route != NULL)
+    return route;
+
+  for(c = -1, k = 0; k < r -> nchans; k++)
+    if(r -> link_src[k / COMM_MAX_LANES] == src && dist[k] >= 0 && (c == -1 || dist[k] < dist[c]))
+      c = k;
+  if(c == -1)
+    return NULL;
+
+  hops = dist[c] + 1;
+  path = std_malloc(sizeof(int) * (hops + 1));
+  lanes = std_malloc(sizeof(int) * hops);
+  path[0] = src;
+  for(i = 0; ; i++){
+    path[i + 1] = r -> link_dst[c / COMM_MAX_LANES];
+    lanes[i] = c % COMM_MAX_LANES;
+    if(i + 1 == hops)
+      break;
+    for(k = r -> succ_first[c]; dist[r -> succs[k]] != dist[c] - 1; k++);
+    c = r -> succs[k];
+  }
+  route = overlay_rtable_entry_create(dst, path, hops, hops, orig -> width);
+  overlay_rtable_entry_set_lanes(route, lanes);
+  std_free(path);
+  std_free(lanes);
+  return route;
+}
+
+static void
+reroute_retire(reroute_t r, overlay_rtable_entry_t e){
+  if(r -> nretired == r -> retired_cap){
+    r -> retired_cap = r -> retired_cap ? 2 * r -> retired_cap : 64;
+    r -> retired = std_realloc(r -> retired, sizeof(overlay_rtable_entry_t) * r -> retired_cap);
+  }
+  r -> retired[r -> nretired ++] = e;
+}
+
+/* replace the routes of all sources that take a failed link */
+static void
+reroute_update(reroute_t r, comm_node_t node){
+  overlay_rtable_entry_t e, route;
+  int s, d, have, n = r -> npeers;
+  int nrerouted = 0, nlost = 0;
+  int *dist, *queue;
+
+  dist = std_malloc(sizeof(int) * (r -> nchans + 1));
+  queue = std_malloc(sizeof(int) * (r -> nchans + 1));
+  for(d = 0; d < n; d++){
+    have = 0;
+    for(s = 0; s < n; s++){
+      if(s == d || (e = reroute_get_entry(node, s, d)) == NULL || !reroute_entry_dead(r, e))
+	continue;
+      if(!have){
+	reroute_dists(r, d, dist, queue);
+	have = 1;
+      }
+      if((route = reroute_route(r, s, d, dist)) == NULL){
+	nlost ++;
+	continue;
+      }
+      /* readers see either route whole */
+      __sync_synchronize();
+      node -> rts[s] -> entries[d] = route;
+      if(e != r -> orig[s * n + d])
+	reroute_retire(r, e);
+      nrerouted ++;
+    }
+  }
+  std_free(dist);
+  std_free(queue);
+
+  /* printf("%d: %d routes changed, %d unreachable\n", node -> node_id, nrerouted, nlost);fflush(stdout); */
+}
+
+static int
+reroute_mark_dead(reroute_t r, int l){
+  if(l == -1 || r -> dead[l])
+    return 0;
+  r -> dead[l] = 1;
+  return 1;
+}
+
+/* the link between u and v failed. */
+/* returns 0 if it was known already, or if no route takes it */
+int
+reroute_link_down(reroute_t r, comm_node_t node, int u, int v){
+  int changed;
+
+  if(u < 0 || v < 0 || u >= r -> npeers || v >= r -> npeers)
+    return 0;
+  changed = reroute_mark_dead(r, reroute_link(r, u, v));
+  changed |= reroute_mark_dead(r, reroute_link(r, v, u));
+  if(changed)
+    reroute_update(r, node);
+  return changed;
+}
+
+/* node pid left: all its links are taken as failed */
+int
+reroute_node_down(reroute_t r, comm_node_t node, int pid){
+  int l, changed = 0;
+
+  for(l = 0; l < r -> nlinks; l++)
+    if(r -> link_src[l] == pid || r -> link_dst[l] == pid)
+      changed |= reroute_mark_dead(r, l);
+  if(changed)
+    reroute_update(r, node);
+  return changed;
+}
+
+/* start over from the routes as they are now, after a node joined: */
+/* links that failed stay failed, and replaced routes are kept for readers */
+reroute_t
+reroute_renew(reroute_t r, comm_node_t node){
+  reroute_t renewed = reroute_create(node);
+  int s, d, l, k, n = r -> npeers;
+
+  for(l = 0; l < r -> nlinks; l++)
+    if(r -> dead[l])
+      reroute_mark_dead(renewed, reroute_link(renewed, r -> link_src[l], r -> link_dst[l]));
+
+  for(s = 0; s < n; s++)
+    for(d = 0; d < n; d++)
+      if(r -> orig[s * n + d] != NULL && reroute_get_entry(node, s, d) != r -> orig[s * n + d])
+	reroute_retire(renewed, r -> orig[s * n + d]);
+  for(k = 0; k < r -> nretired; k++)
+    reroute_retire(renewed, r -> retired[k]);
+  r -> nretired = 0;
+  for(s = 0; s < n * n; s++)
+    r -> orig[s] = NULL;
+  reroute_destroy(r, node);
+  return renewed;
+}
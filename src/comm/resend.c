@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <std/std.h>
+#include "impl/resend.h"
+
+LIST_MAKE_TYPE_IMPLEMENTATION(resend_chunk);
+LIST_MAKE_TYPE_IMPLEMENTATION(resend_msg);
+OPENMAP_MAKE_TYPE_IMPLEMENTATION(resend_msg);
+
+resend_t
+resend_create(int maxpeers, int maxgroups){
+  resend_t r = std_malloc(sizeof(resend));
+  int f;
+
+  r -> maxpeers = maxpeers;
+  r -> nflows = maxpeers + maxgroups;
+  r -> flows = std_malloc(sizeof(resend_flow) * r -> nflows);
+  for(f = 0; f < r -> nflows; f++){
+    r -> flows[f].next_seq = 0;
+    r -> flows[f].msgs = resend_msg_list_create();
+    r -> flows[f].last_ack = 0.0;
+  }
+  r -> msgs = resend_msg_open_map_create(128);
+  r -> nchunks = 0;
+
+  return r;
+}
+
+static void
+resend_chunk_destroy(resend_chunk_t c){
+  msg_buff_destroy(c -> buff);
+  if(c -> waiting != NULL)
+    std_free(c -> waiting);
+  std_free(c);
+}
+
+static void
+resend_msg_destroy(resend_msg_t m){
+  while(resend_chunk_list_size(m -> chunks))
+    resend_chunk_destroy(resend_chunk_list_popleft(m -> chunks));
+  resend_chunk_list_destroy(m -> chunks);
+  std_free(m);
+}
+
+void
+resend_destroy(resend_t r){
+  int f;
+
+  for(f = 0; f < r -> nflows; f++){
+    while(resend_msg_list_size(r -> flows[f].msgs))
+      resend_msg_destroy(resend_msg_list_popleft(r -> flows[f].msgs));
+    resend_msg_list_destroy(r -> flows[f].msgs);
+  }
+  std_free(r -> flows);
+  resend_msg_open_map_destroy(r -> msgs);
+  std_free(r);
+}
+
+/* forget a message once all of its chunks were taken and acknowledged */
+static void
+resend_msg_check_done(resend_t r, resend_msg_t m){
+  resend_msg_list_t msgs = r -> flows[m -> flow].msgs;
+  resend_msg_list_cell_t cell;
+
+  if(m -> left > 0 || resend_chunk_list_size(m -> chunks) > 0)
+    return;
+  resend_msg_open_map_pop(r -> msgs, m -> sid);
+  /* mostly the oldest of its flow */
+  for(cell = resend_msg_list_head(msgs); resend_msg_list_cell_data(cell) != m; cell = resend_msg_list_cell_next(cell));
+  resend_msg_list_remove(msgs, cell);
+  resend_msg_destroy(m);
+}
+
+/* messages of the flow numbered below were acknowledged in full */
+sid_t
+resend_flow_acked(resend_t r, int flow){
+  resend_msg_list_t msgs = r -> flows[flow].msgs;
+
+  if(resend_msg_list_size(msgs) == 0)
+    return r -> flows[flow].next_seq;
+  return resend_msg_list_cell_data(resend_msg_list_head(msgs)) -> flow_seq;
+}
+
+/* keep a share of a data chunk taken from a submission queue, until acknowledged */
+/* by its destination, or by members (other than this node) of its multicast group. */
+/* the number of its message, and what was acknowledged of its flow, go in minfo */
+void
+resend_keep(resend_t r, msg_info_t minfo, msg_buff_t chunk, const int* members, int nmembers, double now){
+  int flow = minfo -> kind == MSG_TYPE_MCAST ? r -> maxpeers + minfo -> dst_id : minfo -> dst_id;
+  resend_msg_t m = resend_msg_open_map_find(r -> msgs, minfo -> sid);
+  resend_chunk_t c;
+
+  assert(flow < r -> nflows);
+  if(m == NULL){
+    m = std_malloc(sizeof(resend_msg));
+    m -> sid = minfo -> sid;
+    m -> flow = flow;
+    m -> flow_seq = r -> flows[flow].next_seq ++;
+    m -> left = minfo -> tot_len;
+    m -> chunks = resend_chunk_list_create();
+    resend_msg_open_map_add(r -> msgs, m -> sid, m);
+    resend_msg_list_append(r -> flows[flow].msgs, m);
+  }
+
+  c = std_malloc(sizeof(resend_chunk));
+  c -> buff = msg_buff_share(chunk);
+  c -> seq = minfo -> seq;
+  c -> sent = now;
+  c -> waiting = NULL;
+  c -> nwaiting = 1;
+  if(members != NULL){
+    c -> waiting = std_malloc(sizeof(int) * (nmembers + 1));
+    std_memcpy(c -> waiting, members, sizeof(int) * nmembers);
+    c -> nwaiting = nmembers;
+  }
+  resend_chunk_list_append(m -> chunks, c);
+  r -> nchunks ++;
+  m -> left -= minfo -> len;
+
+  minfo -> flow_seq = m -> flow_seq;
+  minfo -> flow_acked = resend_flow_acked(r, flow);
+}
+
+/* take a member off the chunk at cell, and drop the chunk if none is left */
+static void
+resend_chunk_acked(resend_t r, resend_msg_t m, resend_chunk_list_cell_t cell, int from){
+  resend_chunk_t c = resend_chunk_list_cell_data(cell);
+  int i;
+
+  if(c -> waiting == NULL)
+    c -> nwaiting = 0;
+  else{
+    for(i = 0; i < c -> nwaiting && c -> waiting[i] != from; i++);
+    if(i == c -> nwaiting) /* acknowledged already */
+      return;
+    c -> waiting[i] = c -> waiting[-- c -> nwaiting];
+  }
+  if(c -> nwaiting == 0){
+    resend_chunk_list_remove(m -> chunks, cell);
+    resend_chunk_destroy(c);
+    r -> nchunks --;
+  }
+}
+
+/* node from got chunk seq of message sid. acknowledgements may come more than once */
+void
+resend_ack(resend_t r, int from, sid_t sid, int seq, double now){
+  resend_msg_t m = resend_msg_open_map_find(r -> msgs, sid);
+  resend_chunk_list_cell_t cell;
+
+  if(m == NULL)
+    return;
+  r -> flows[m -> flow].last_ack = now;
+  /* chunks are mostly acknowledged in order */
+  for(cell = resend_chunk_list_head(m -> chunks); cell != resend_chunk_list_end(m -> chunks); cell = resend_chunk_list_cell_next(cell)){
+    if(resend_chunk_list_cell_data(cell) -> seq == seq){
+      resend_chunk_acked(r, m, cell, from);
+      break;
+    }
+  }
+  resend_msg_check_done(r, m);
+}
+
+/* node pid left: no acknowledgement is to come from it */
+void
+resend_forget_peer(resend_t r, int pid){
+  resend_msg_list_cell_t mcell;
+  resend_chunk_list_cell_t cell, next;
+  resend_msg_t m;
+  int f;
+
+  for(f = 0; f < r -> nflows; f++){
+    if(f < r -> maxpeers && f != pid)
+      continue;
+    for(mcell = resend_msg_list_head(r -> flows[f].msgs); mcell != resend_msg_list_end(r -> flows[f].msgs);){
+      m = resend_msg_list_cell_data(mcell);
+      mcell = resend_msg_list_cell_next(mcell);
+      for(cell = resend_chunk_list_head(m -> chunks); cell != resend_chunk_list_end(m -> chunks); cell = next){
+	next = resend_chunk_list_cell_next(cell);
+	resend_chunk_acked(r, m, cell, pid);
+      }
+      /* chunks of the message still to come are of no use to anybody */
+      if(f == pid)
+	m -> left = 0;
+      resend_msg_check_done(r, m);
+    }
+  }
+}
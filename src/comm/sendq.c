@@ -0,0 +1,164 @@
+#include <assert.h>
+
+#include <std/std.h>
+#include <std/list.h>
+#include <std/map.h>
+#include "impl/msg.h"
+#include "impl/sendq.h"
+
+#define SENDQ_MAP_SIZE (16)
+
+LIST_MAKE_TYPE_IMPLEMENTATION(sendq_flow);
+OPENMAP_MAKE_TYPE_IMPLEMENTATION(sendq_flow);
+
+/* node ids are below 2^20 (see comm_node_get_new_sid) */
+unsigned long
+sendq_flow_key(int src_id, int dst_id, int prio){
+  return ((unsigned long)src_id << 28) | ((unsigned long)dst_id << 8) | (unsigned long)prio;
+}
+
+static sendq_flow_t
+sendq_flow_create(unsigned long key, int prio){
+  sendq_flow_t flow = std_malloc(sizeof(sendq_flow));
+  flow -> key = key;
+  flow -> weight = SENDQ_FLOW_WEIGHT(prio);
+  /* a new flow may send right away */
+  flow -> deficit = SENDQ_QUANTUM * flow -> weight;
+  flow -> queue = msg_buff_list_create();
+  return flow;
+}
+
+static void
+sendq_flow_destroy(sendq_flow_t flow){
+  while(msg_buff_list_size(flow -> queue))
+    msg_buff_destroy(msg_buff_list_popleft(flow -> queue));
+  msg_buff_list_destroy(flow -> queue);
+  std_free(flow);
+}
+
+sendq_t
+sendq_create(){
+  sendq_t q = std_malloc(sizeof(sendq));
+  q -> control = msg_buff_list_create();
+  q -> flows = sendq_flow_open_map_create(SENDQ_MAP_SIZE);
+  q -> active = sendq_flow_list_create();
+  q -> head = NULL;
+  q -> last = NULL;
+  q -> size = 0;
+  q -> bytes = 0;
+  return q;
+}
+
+/* destroys the chunks still queued */
+void
+sendq_destroy(sendq_t q){
+  while(msg_buff_list_size(q -> control))
+    msg_buff_destroy(msg_buff_list_popleft(q -> control));
+  msg_buff_list_destroy(q -> control);
+  while(sendq_flow_list_size(q -> active))
+    sendq_flow_destroy(sendq_flow_list_popleft(q -> active));
+  sendq_flow_list_destroy(q -> active);
+  sendq_flow_open_map_destroy(q -> flows);
+  if(q -> head != NULL)
+    msg_buff_destroy(q -> head);
+  std_free(q);
+}
+
+void
+sendq_push(sendq_t q, msg_buff_t buff, unsigned long key, int prio){
+  sendq_flow_t flow = sendq_flow_open_map_find(q -> flows, key);
+
+  if(flow == NULL){
+    flow = sendq_flow_create(key, prio);
+    sendq_flow_open_map_add(q -> flows, key, flow);
+    sendq_flow_list_append(q -> active, flow);
+  }
+  msg_buff_list_append(flow -> queue, buff);
+
+  q -> last = buff;
+  q -> size ++;
+  q -> bytes += msg_buff_len(buff);
+}
+
+/* control messages (pings, routing tables, handshakes) go ahead of all data, */
+/* so RTT probes see no queueing behind bulk chunks */
+void
+sendq_push_control(sendq_t q, msg_buff_t buff){
+  msg_buff_list_append(q -> control, buff);
+
+  q -> last = buff;
+  q -> size ++;
+  q -> bytes += msg_buff_len(buff);
+}
+
+/* next chunk to send, NULL if empty. */
+/* it stays the head until popped, so it is never interleaved with another */
+msg_buff_t
+sendq_head(sendq_t q){
+  sendq_flow_t flow;
+  int len;
+
+  if(q -> head != NULL)
+    return q -> head;
+
+  if(msg_buff_list_size(q -> control)){
+    q -> head = msg_buff_list_popleft(q -> control);
+    return q -> head;
+  }
+
+  if(sendq_flow_list_size(q -> active) == 0)
+    return NULL;
+
+  /* a flow sends while its deficit covers the chunk at its front, */
+  /* then earns another quantum and goes to the back */
+  while(1){
+    flow = sendq_flow_list_cell_data(sendq_flow_list_head(q -> active));
+    len = msg_buff_len(msg_buff_list_cell_data(msg_buff_list_head(flow -> queue)));
+    if(flow -> deficit >= len)
+      break;
+    flow -> deficit += SENDQ_QUANTUM * flow -> weight;
+    sendq_flow_list_append(q -> active, sendq_flow_list_popleft(q -> active));
+  }
+
+  q -> head = msg_buff_list_popleft(flow -> queue);
+  flow -> deficit -= len;
+
+  /* idle flows keep no state */
+  if(msg_buff_list_size(flow -> queue) == 0){
+    sendq_flow_list_popleft(q -> active);
+    sendq_flow_open_map_pop(q -> flows, flow -> key);
+    sendq_flow_destroy(flow);
+  }
+
+  return q -> head;
+}
+
+/* remove the head, once it was sent */
+msg_buff_t
+sendq_pop(sendq_t q){
+  msg_buff_t buff = sendq_head(q);
+
+  assert(buff != NULL);
+  q -> head = NULL;
+  if(buff == q -> last)
+    q -> last = NULL;
+  q -> size --;
+  q -> bytes -= msg_buff_len(buff);
+  return buff;
+}
+
+/* NULL once it was sent */
+msg_buff_t
+sendq_last(sendq_t q){
+  return q -> last;
+}
+
+int
+sendq_size(sendq_t q){
+  return q -> size;
+}
+
+long
+sendq_bytes(sendq_t q){
+  return q -> bytes;
+}
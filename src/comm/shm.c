@@ -0,0 +1,188 @@
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <std/std.h>
+#include "impl/shm.h"
+
+#define Min(a, b) ((a) < (b) ? (a) : (b))
+
+static shm_t
+base_shm_create(const char* name, int fd, int side){
+  shm_t sh;
+  void* p = mmap(NULL, sizeof(shm_seg), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  close(fd);
+  if(p == MAP_FAILED){
+    perror("mmap");
+    return NULL;
+  }
+
+  sh = std_malloc(sizeof(shm));
+  strncpy(sh -> name, name, SHM_NAME_LEN - 1);
+  sh -> name[SHM_NAME_LEN - 1] = '\0';
+  sh -> linked = 1;
+  sh -> seg = p;
+  sh -> tx = &sh -> seg -> ring[side];
+  sh -> rx = &sh -> seg -> ring[1 - side];
+
+  return sh;
+}
+
+/* create a new segment as the connecting side, NULL on failure */
+shm_t
+shm_create(){
+  static int count = 0;
+  char name[SHM_NAME_LEN];
+  int fd;
+
+  snprintf(name, sizeof(name), "/dlfree-%d-%d", (int)getpid(), __sync_fetch_and_add(&count, 1));
+
+  if((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) == -1){
+    perror("shm_open");
+    return NULL;
+  }
+  /* a fresh segment is zero-filled, so both rings start empty */
+  if(ftruncate(fd, sizeof(shm_seg)) == -1){
+    perror("ftruncate");
+    close(fd);
+    shm_unlink(name);
+    return NULL;
+  }
+
+  return base_shm_create(name, fd, SHM_SIDE_CONNECTOR);
+}
+
+/* map the segment created by the peer, NULL on failure */
+shm_t
+shm_attach(const char* name){
+  int fd;
+  struct stat st;
+
+  if((fd = shm_open(name, O_RDWR, 0600)) == -1){
+    perror("shm_open");
+    return NULL;
+  }
+  if(fstat(fd, &st) == -1 || st.st_size != sizeof(shm_seg)){
+    fprintf(stderr, "shm_attach: %s has unexpected size\n", name);
+    close(fd);
+    return NULL;
+  }
+
+  return base_shm_create(name, fd, SHM_SIDE_ACCEPTOR);
+}
+
+/* once both sides have mapped it, the name is no longer needed */
+void
+shm_unlink_name(shm_t sh){
+  if(sh -> linked){
+    shm_unlink(sh -> name);
+    sh -> linked = 0;
+  }
+}
+
+void
+shm_destroy(shm_t sh){
+  munmap(sh -> seg, sizeof(shm_seg));
+  std_free(sh);
+}
+
+const char*
+shm_name(shm_t sh){
+  return sh -> name;
+}
+
+/* copy up to n bytes into the tx ring, return bytes copied. */
+/* *bell is set if the peer is waiting for data */
+int
+shm_write(shm_t sh, const void* buf, int n, int* bell){
+  shm_ring_t r = sh -> tx;
+  long head = r -> head;
+  int off = head & (SHM_RING_SIZE - 1);
+  int len = Min(n, SHM_RING_SIZE - (int)(head - r -> tail));
+  int first = Min(len, SHM_RING_SIZE - off);
+
+  *bell = 0;
+  if(len == 0)
+    return 0;
+
+  /* tail must be read before overwriting the space it freed */
+  __sync_synchronize();
+  memcpy(r -> data + off, buf, first);
+  memcpy(r -> data, (const char*)buf + first, len - first);
+
+  /* publish data, then see if consumer sleeps */
+  __sync_synchronize();
+  r -> head = head + len;
+  __sync_synchronize();
+  if(r -> rx_wait && __sync_bool_compare_and_swap(&r -> rx_wait, 1, 0))
+    *bell = 1;
+
+  return len;
+}
+
+/* copy up to n bytes out of the rx ring, return bytes copied. */
+/* *bell is set if the peer is waiting for space */
+int
+shm_read(shm_t sh, void* buf, int n, int* bell){
+  shm_ring_t r = sh -> rx;
+  long tail = r -> tail;
+  int off = tail & (SHM_RING_SIZE - 1);
+  int len = Min(n, (int)(r -> head - tail));
+  int first = Min(len, SHM_RING_SIZE - off);
+
+  *bell = 0;
+  if(len == 0)
+    return 0;
+
+  /* head must be read before the data it covers */
+  __sync_synchronize();
+  memcpy(buf, r -> data + off, first);
+  memcpy((char*)buf + first, r -> data, len - first);
+
+  /* release space, then see if producer sleeps */
+  __sync_synchronize();
+  r -> tail = tail + len;
+  __sync_synchronize();
+  if(r -> tx_wait && __sync_bool_compare_and_swap(&r -> tx_wait, 1, 0))
+    *bell = 1;
+
+  return len;
+}
+
+int
+shm_rx_pending(shm_t sh){
+  return (int)(sh -> rx -> head - sh -> rx -> tail);
+}
+
+int
+shm_tx_space(shm_t sh){
+  return SHM_RING_SIZE - (int)(sh -> tx -> head - sh -> tx -> tail);
+}
+
+/* before sleeping on an empty ring: ask the producer for a doorbell, */
+/* return bytes pending (0 if it is safe to sleep) */
+int
+shm_rx_arm(shm_t sh){
+  if(shm_rx_pending(sh))
+    return shm_rx_pending(sh);
+
+  sh -> rx -> rx_wait = 1;
+  __sync_synchronize();
+  return shm_rx_pending(sh);
+}
+
+/* before sleeping on a full ring: ask the consumer for a doorbell, */
+/* return free space (0 if it is safe to sleep) */
+int
+shm_tx_arm(shm_t sh){
+  if(shm_tx_space(sh))
+    return shm_tx_space(sh);
+
+  sh -> tx -> tx_wait = 1;
+  __sync_synchronize();
+  return shm_tx_space(sh);
+}
@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <assert.h>
+#include <linux/errqueue.h>
 //#include <linux/tcp.h>
 
 #include <std/std.h>
@@ -17,6 +19,24 @@ base_sock_create(int fd, inet_iface_t dst_iface, int port){
   sk -> port = port;
   sk -> dst_iface = dst_iface;
   sk -> fd = fd;
+
+  sk -> shm = NULL;
+  sk -> shm_tx = 0;
+  sk -> shm_rx = 0;
+  sk -> tx_blocked = 0;
+  sk -> bell_pending = 0;
+  sk -> peer_closed = 0;
+
+  sk -> uring = NULL;
+  uring_slot_init(&sk -> rx_slot);
+  uring_slot_init(&sk -> tx_slot);
+  uring_slot_init(&sk -> poll_slot);
+
+  sk -> zerocopy = 0;
+  sk -> zc_sent = 0;
+  sk -> zc_done = 0;
+  sk -> zc_copied = 0;
+  sk -> io_timeout = 0;
   
   return sk;
 }
@@ -24,10 +44,19 @@ base_sock_create(int fd, inet_iface_t dst_iface, int port){
 void
 sock_destroy(sock_t sk){
   int fd = sk -> fd;
+
+  if(sk -> uring != NULL)
+    sock_uring_cancel(sk);
+
   if(fd >= 0){
     sk -> fd = -1;
     std_close(fd);
   }
+
+  if(sk -> shm != NULL){
+    shm_unlink_name(sk -> shm);
+    shm_destroy(sk -> shm);
+  }
   
   inet_iface_destroy(sk -> dst_iface);
   std_free(sk);
@@ -56,7 +85,87 @@ sock_tcp_info(sock_t sk){ /* TODO: not portable code */
 
   return info; /* return struct copy */
 }
+
+/* read the n-th integer of a sysctl file, or return defval */
+static int
+read_sysctl_int(const char *path, int nth, int defval){
+  int i, val = defval;
+  FILE *fp = fopen(path, "r");
+
+  if(fp == NULL)
+    return defval;
+  for(i = 0; i <= nth; i++){
+    if(fscanf(fp, "%d", &val) != 1){
+      val = defval;
+      break;
+    }
+  }
+  fclose(fp);
+
+  return val;
+}
+
+/* largest receive buffer the kernel autotuning grows to (tcp_rmem max) */
+int
+sock_autotune_max(){
+  static int max = -1;
+  if(max < 0)
+    max = read_sysctl_int("/proc/sys/net/ipv4/tcp_rmem", 2, SOCK_DEFAULT_MAX_WINDOW);
+  return max;
+}
+
+/* largest buffer that can be set explicitly with SO_RCVBUF (rmem_max) */
+int
+sock_setopt_max(){
+  static int max = -1;
+  if(max < 0)
+    max = read_sysctl_int("/proc/sys/net/core/rmem_max", 0, SOCK_DEFAULT_MAX_WINDOW);
+  return max;
+}
+
+/* largest receive window a single TCP stream can open */
+int
+sock_max_window(){
+  int a = sock_autotune_max(), s = sock_setopt_max();
+  return a > s ? a : s;
+}
+
+/* fix send and receive buffer sizes, this disables kernel autotuning */
+void
+sock_set_buffers(sock_t sk, int size){
+  std_setsockopt(sk -> fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  std_setsockopt(sk -> fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
 			
+/* have a link that stops acknowledging (or goes quiet) fail within about */
+/* timeout seconds, instead of after the kernel's minutes of retransmissions */
+void
+sock_set_fail_timeout(sock_t sk, int timeout){
+  const int on = 1, cnt = 3;
+  int idle = timeout > 1 ? timeout / 2 : 1, intvl = timeout > 5 ? timeout / 6 : 1;
+  unsigned int ms = timeout * 1000;
+
+  std_setsockopt(sk -> fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+  std_setsockopt(sk -> fd, SOL_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+  std_setsockopt(sk -> fd, SOL_TCP, TCP_KEEPINTVL, &intvl, sizeof(intvl));
+  std_setsockopt(sk -> fd, SOL_TCP, TCP_KEEPCNT, &cnt, sizeof(cnt));
+  std_setsockopt(sk -> fd, SOL_TCP, TCP_USER_TIMEOUT, &ms, sizeof(ms));
+}
+
+/* have sock_recv_n() and sock_send_n() fail once the peer makes them wait */
+/* timeout seconds, e.g. one that stopped answering without closing */
+void
+sock_set_io_timeout(sock_t sk, int timeout){
+  sk -> io_timeout = timeout;
+}
+
+/* wait for sk to be readable or writable, 0 if it was not within sk -> io_timeout */
+static int
+sock_wait(sock_t sk, fd_set *readfd, fd_set *writefd){
+  struct timeval timeout = {sk -> io_timeout, 0};
+
+  return std_select(sk -> fd + 1, readfd, writefd, NULL, sk -> io_timeout > 0 ? &timeout : NULL);
+}
 
 void
 sock_set_nonblocking(sock_t sk, const int on){
@@ -193,8 +302,19 @@ sock_accept(sock_t sk){
   return connected_sock_create(dstfd, peer_addr, peer_port);
 }
 
+static int sock_shm_try_recv_n(sock_t sk, void* buf, int n, int *nr);
+static int sock_shm_try_send_n(sock_t sk, const void* buf, int n, int *nr);
+static int sock_uring_try_recv_n(sock_t sk, void* buf, int n, int *nr);
+static int sock_uring_try_send_n(sock_t sk, const void* buf, int n, int *nr);
+static int sock_zc_try_send_n(sock_t sk, const void* buf, int n, int *nr);
+
 int
 sock_try_recv_n(sock_t sk, void* buf, int n, int *nr){
+  if(sk -> shm_rx)
+    return sock_shm_try_recv_n(sk, buf, n, nr);
+  if(sk -> uring != NULL)
+    return sock_uring_try_recv_n(sk, buf, n, nr);
+
   if((*nr = recv(sk -> fd, buf, n, 0)) == -1){
     if(errno == EAGAIN){
       return SOCK_RECV_EAGAIN;
@@ -228,7 +348,8 @@ sock_recv_n(sock_t sk, void *buf, int len){
       /* select and wait */
       FD_ZERO(&readfd);
       FD_SET(sk -> fd, &readfd);
-      std_select(sk -> fd + 1, &readfd, NULL, NULL, NULL);
+      if(sock_wait(sk, &readfd, NULL) == 0)
+	return SOCK_RECV_ERR;
       break;
     case SOCK_RECV_EOF:
       return stat;
@@ -245,6 +366,13 @@ sock_recv_n(sock_t sk, void *buf, int len){
 
 int
 sock_try_send_n(sock_t sk, const void* buf, int n, int* nr){
+  if(sk -> shm_tx)
+    return sock_shm_try_send_n(sk, buf, n, nr);
+  if(sk -> uring != NULL)
+    return sock_uring_try_send_n(sk, buf, n, nr);
+  if(sk -> zerocopy && n >= SOCK_ZEROCOPY_MIN)
+    return sock_zc_try_send_n(sk, buf, n, nr);
+
   if((*nr = send(sk -> fd, buf, n, 0)) == -1){
     if(errno == EAGAIN){
       return SOCK_SEND_EAGAIN;
@@ -274,7 +402,8 @@ sock_send_n(sock_t sk, const void* buf, int len){
       /* select and wait */
       FD_ZERO(&writefd);
       FD_SET(sk -> fd, &writefd);
-      std_select(sk -> fd + 1, NULL, &writefd, NULL, NULL);
+      if(sock_wait(sk, NULL, &writefd) == 0)
+	return SOCK_SEND_ERR;
       break;
     case SOCK_SEND_ERR:
       return stat;
@@ -286,3 +415,345 @@ sock_send_n(sock_t sk, const void* buf, int len){
   
   return stat;
 }
+
+/* shared memory mode: */
+/* the connector creates the segment and the acceptor attaches to it. */
+/* a direction switches to its ring right after a marker message */
+/* has gone through TCP, so the two byte streams never interleave */
+
+/* connecting side, returns the segment name to hand to the peer */
+const char*
+sock_shm_create(sock_t sk){
+  assert(sk -> shm == NULL);
+  if((sk -> shm = shm_create()) == NULL)
+    return NULL;
+  return shm_name(sk -> shm);
+}
+
+/* accepting side */
+int
+sock_shm_attach(sock_t sk, const char* name){
+  assert(sk -> shm == NULL);
+  if((sk -> shm = shm_attach(name)) == NULL)
+    return SOCK_CONNECT_ERR;
+  /* both sides have it mapped now */
+  shm_unlink_name(sk -> shm);
+  return SOCK_CONNECT_OK;
+}
+
+/* give up the segment, e.g. when the peer could not attach to it */
+void
+sock_shm_abort(sock_t sk){
+  assert(!sk -> shm_tx && !sk -> shm_rx);
+  shm_unlink_name(sk -> shm);
+  shm_destroy(sk -> shm);
+  sk -> shm = NULL;
+}
+
+static void
+sock_shm_ring_bell(sock_t sk){
+  const char b = 0;
+
+  /* a doorbell must not overtake the marker still queued for TCP */
+  if(!sk -> shm_tx){
+    sk -> bell_pending = 1;
+    return;
+  }
+  /* if the socket is full, the peer has doorbells to read anyway */
+  send(sk -> fd, &b, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+void
+sock_shm_start_tx(sock_t sk){
+  assert(sk -> shm != NULL);
+  sk -> shm_tx = 1;
+  if(sk -> bell_pending){
+    sk -> bell_pending = 0;
+    sock_shm_ring_bell(sk);
+  }
+}
+
+void
+sock_shm_start_rx(sock_t sk){
+  assert(sk -> shm != NULL);
+  sk -> shm_rx = 1;
+}
+
+int
+sock_is_shm_rx(sock_t sk){
+  return sk -> shm_rx;
+}
+
+int
+sock_is_tx_blocked(sock_t sk){
+  return sk -> tx_blocked;
+}
+
+int
+sock_shm_rx_pending(sock_t sk){
+  return shm_rx_pending(sk -> shm);
+}
+
+/* to be called before sleeping in select(), returns bytes already pending */
+int
+sock_shm_rx_arm(sock_t sk){
+  return shm_rx_arm(sk -> shm);
+}
+
+/* consume doorbell bytes, the rings themselves tell what changed */
+int
+sock_shm_doorbell(sock_t sk){
+  char buf[64];
+  int n;
+
+  while((n = recv(sk -> fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    ;
+  if(n == 0){
+    sk -> peer_closed = 1;
+    return SOCK_RECV_EOF;
+  }
+  if(errno != EAGAIN){
+    perror("recv");
+    return SOCK_RECV_ERR;
+  }
+  return SOCK_RECV_OK;
+}
+
+/* returns 1 if the tx ring was full and now has space */
+int
+sock_shm_tx_unblock(sock_t sk){
+  if(sk -> tx_blocked && shm_tx_space(sk -> shm) > 0){
+    sk -> tx_blocked = 0;
+    return 1;
+  }
+  return 0;
+}
+
+static int
+sock_shm_try_recv_n(sock_t sk, void* buf, int n, int *nr){
+  int bell;
+
+  if((*nr = shm_read(sk -> shm, buf, n, &bell)) == 0){
+    if(shm_rx_arm(sk -> shm) == 0)
+      return sk -> peer_closed ? SOCK_RECV_EOF : SOCK_RECV_EAGAIN;
+    *nr = shm_read(sk -> shm, buf, n, &bell);
+  }
+  if(bell)
+    sock_shm_ring_bell(sk);
+  return SOCK_RECV_OK;
+}
+
+static int
+sock_shm_try_send_n(sock_t sk, const void* buf, int n, int *nr){
+  int bell;
+
+  if(sk -> peer_closed)
+    return SOCK_SEND_ERR;
+
+  if((*nr = shm_write(sk -> shm, buf, n, &bell)) == 0){
+    if(shm_tx_arm(sk -> shm) == 0){
+      sk -> tx_blocked = 1;
+      return SOCK_SEND_EAGAIN;
+    }
+    *nr = shm_write(sk -> shm, buf, n, &bell);
+  }
+  if(bell)
+    sock_shm_ring_bell(sk);
+  return SOCK_SEND_OK;
+}
+
+/* io_uring mode: */
+/* the channel layer keeps calling try_recv/try_send with the same buffer */
+/* until it gets a result, so posting on the first call and answering */
+/* a later one keeps its state machines unchanged */
+
+void
+sock_set_uring(sock_t sk, uring_t ring){
+  sk -> uring = ring;
+}
+
+int
+sock_uring_rx_busy(sock_t sk){
+  return sk -> rx_slot.state == URING_SLOT_BUSY;
+}
+
+int
+sock_uring_tx_busy(sock_t sk){
+  return sk -> tx_slot.state == URING_SLOT_BUSY;
+}
+
+/* returns 1 once the fd became ready for events, otherwise makes sure a poll is posted */
+int
+sock_uring_poll(sock_t sk, int events){
+  switch(sk -> poll_slot.state){
+  case URING_SLOT_IDLE:
+    uring_prep_poll(sk -> uring, &sk -> poll_slot, sk -> fd, events);
+    return 0;
+  case URING_SLOT_BUSY:
+    return 0;
+  }
+  sk -> poll_slot.state = URING_SLOT_IDLE;
+  return 1;
+}
+
+/* the kernel must be done with our buffers before they are freed */
+void
+sock_uring_cancel(sock_t sk){
+  uring_slot_t slots[3] = {&sk -> rx_slot, &sk -> tx_slot, &sk -> poll_slot};
+  int i, busy;
+
+  do{
+    busy = 0;
+    for(i = 0; i < 3; i++){
+      if(slots[i] -> state == URING_SLOT_BUSY){
+	uring_prep_cancel(sk -> uring, slots[i]);
+	busy = 1;
+      }
+    }
+    if(busy)
+      uring_submit(sk -> uring, 1);
+  }while(busy);
+}
+
+static int
+sock_uring_try_recv_n(sock_t sk, void* buf, int n, int *nr){
+  uring_slot_t slot = &sk -> rx_slot;
+
+  switch(slot -> state){
+  case URING_SLOT_IDLE:
+    uring_prep_recv(sk -> uring, slot, sk -> fd, buf, n);
+    return SOCK_RECV_EAGAIN;
+  case URING_SLOT_BUSY:
+    return SOCK_RECV_EAGAIN;
+  }
+
+  assert(slot -> buf == buf);
+  slot -> state = URING_SLOT_IDLE;
+  *nr = slot -> res;
+  if(slot -> res == -EAGAIN)
+    return SOCK_RECV_EAGAIN;
+  if(slot -> res < 0){
+    errno = - slot -> res;
+    perror("recv");
+    return SOCK_RECV_ERR;
+  }
+  if(slot -> res == 0)
+    return SOCK_RECV_EOF;
+  return SOCK_RECV_OK;
+}
+
+static int
+sock_uring_try_send_n(sock_t sk, const void* buf, int n, int *nr){
+  uring_slot_t slot = &sk -> tx_slot;
+
+  switch(slot -> state){
+  case URING_SLOT_IDLE:
+    uring_prep_send(sk -> uring, slot, sk -> fd, buf, n);
+    return SOCK_SEND_EAGAIN;
+  case URING_SLOT_BUSY:
+    return SOCK_SEND_EAGAIN;
+  }
+
+  assert(slot -> buf == buf);
+  slot -> state = URING_SLOT_IDLE;
+  *nr = slot -> res;
+  if(slot -> res == -EAGAIN)
+    return SOCK_SEND_EAGAIN;
+  if(slot -> res < 0){
+    errno = - slot -> res;
+    perror("send");
+    return SOCK_SEND_ERR;
+  }
+  return SOCK_SEND_OK;
+}
+
+/* MSG_ZEROCOPY mode: */
+/* the kernel sends from the caller's pages, which must stay untouched */
+/* until the send id is reported by sock_zc_reap() */
+
+/* returns -1 if the kernel does not support it, the socket then keeps copying */
+int
+sock_enable_zerocopy(sock_t sk){
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  const int on = 1;
+  if(setsockopt(sk -> fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == -1){
+    perror("setsockopt(SO_ZEROCOPY)");
+    return -1;
+  }
+  sk -> zerocopy = 1;
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+/* id of the next zerocopy send, data sent so far is released once it is done */
+unsigned int
+sock_zc_sent(sock_t sk){
+  return sk -> zc_sent;
+}
+
+/* whether all zerocopy sends before id have completed */
+int
+sock_zc_done(sock_t sk, unsigned int id){
+  return (int)(sk -> zc_done - id) >= 0;
+}
+
+/* read completions off the error queue, returns -1 on a real socket error */
+int
+sock_zc_reap(sock_t sk){
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  struct msghdr msg;
+  struct cmsghdr *cm;
+  struct sock_extended_err *serr;
+  char control[128];
+
+  while(sk -> zc_sent != sk -> zc_done){
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if(recvmsg(sk -> fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1){
+      if(errno == EAGAIN)
+	return 0;
+      perror("recvmsg(MSG_ERRQUEUE)");
+      return -1;
+    }
+
+    for(cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)){
+      serr = (struct sock_extended_err*)CMSG_DATA(cm);
+      if(serr -> ee_errno != 0 || serr -> ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+	continue;
+
+      /* completions of a TCP socket arrive in order, [ee_info, ee_data] */
+      sk -> zc_done = serr -> ee_data + 1;
+
+      /* e.g. loopback: the kernel had to copy anyway, so stop paying for notifications */
+      if((serr -> ee_code & SO_EE_CODE_ZEROCOPY_COPIED) && ++ sk -> zc_copied >= SOCK_ZEROCOPY_MAX_COPIED)
+	sk -> zerocopy = 0;
+    }
+  }
+#endif
+  return 0;
+}
+
+static int
+sock_zc_try_send_n(sock_t sk, const void* buf, int n, int *nr){
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  if((*nr = send(sk -> fd, buf, n, MSG_ZEROCOPY)) == -1){
+    if(errno == EAGAIN)
+      return SOCK_SEND_EAGAIN;
+    /* out of optmem for notifications: copy this time */
+    if(errno == ENOBUFS){
+      if((*nr = send(sk -> fd, buf, n, 0)) != -1)
+	return SOCK_SEND_OK;
+      if(errno == EAGAIN)
+	return SOCK_SEND_EAGAIN;
+    }
+    perror("send");
+    return SOCK_SEND_ERR;
+  }
+  sk -> zc_sent ++;
+#endif
+  return SOCK_SEND_OK;
+}
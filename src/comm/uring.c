@@ -0,0 +1,266 @@
+#include <config.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+#include <std/std.h>
+#include "impl/uring.h"
+
+void
+uring_slot_init(uring_slot_t slot){
+  slot -> state = URING_SLOT_IDLE;
+  slot -> res = 0;
+  slot -> buf = NULL;
+}
+
+#if HAVE_LINUX_IO_URING_H
+
+#include <linux/io_uring.h>
+
+static int
+sys_io_uring_setup(unsigned entries, struct io_uring_params *p){
+  return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags){
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int
+sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args){
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* NULL if the kernel does not provide io_uring */
+uring_t
+uring_create(int entries){
+  struct io_uring_params p;
+  uring_t ring;
+  int fd;
+
+  memset(&p, 0, sizeof(p));
+  if((fd = sys_io_uring_setup(entries, &p)) == -1){
+    perror("io_uring_setup");
+    return NULL;
+  }
+
+  ring = std_malloc(sizeof(uring));
+  memset(ring, 0, sizeof(uring));
+  ring -> fd = fd;
+
+  ring -> sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring -> cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  ring -> sq_ptr = mmap(NULL, ring -> sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  ring -> cq_ptr = mmap(NULL, ring -> cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  ring -> sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  if(ring -> sq_ptr == MAP_FAILED || ring -> cq_ptr == MAP_FAILED || ring -> sqes == MAP_FAILED){
+    perror("mmap");
+    exit(1);
+  }
+
+  ring -> sq_head  = ring -> sq_ptr + p.sq_off.head;
+  ring -> sq_tail  = ring -> sq_ptr + p.sq_off.tail;
+  ring -> sq_mask  = ring -> sq_ptr + p.sq_off.ring_mask;
+  ring -> sq_array = ring -> sq_ptr + p.sq_off.array;
+  ring -> sq_entries = p.sq_entries;
+
+  ring -> cq_head = ring -> cq_ptr + p.cq_off.head;
+  ring -> cq_tail = ring -> cq_ptr + p.cq_off.tail;
+  ring -> cq_mask = ring -> cq_ptr + p.cq_off.ring_mask;
+  ring -> cqes    = ring -> cq_ptr + p.cq_off.cqes;
+
+  return ring;
+}
+
+void
+uring_destroy(uring_t ring){
+  munmap(ring -> sqes, ring -> sq_entries * sizeof(struct io_uring_sqe));
+  munmap(ring -> cq_ptr, ring -> cq_size);
+  munmap(ring -> sq_ptr, ring -> sq_size);
+  std_close(ring -> fd);
+  std_free(ring);
+}
+
+/* register one buffer region, returns -1 if the kernel refuses (e.g. memlock limit) */
+int
+uring_register_buffer(uring_t ring, void* base, long len){
+  struct iovec iov;
+
+  iov.iov_base = base;
+  iov.iov_len = len;
+  if(sys_io_uring_register(ring -> fd, IORING_REGISTER_BUFFERS, &iov, 1) == -1){
+    perror("io_uring_register");
+    return -1;
+  }
+  ring -> fixed_base = base;
+  ring -> fixed_len = len;
+  return 0;
+}
+
+static void
+uring_reap(uring_t ring){
+  struct io_uring_cqe *cqe;
+  uring_slot_t slot;
+  unsigned head = *ring -> cq_head;
+
+  while(head != __atomic_load_n(ring -> cq_tail, __ATOMIC_ACQUIRE)){
+    cqe = (struct io_uring_cqe*)ring -> cqes + (head & *ring -> cq_mask);
+    slot = (uring_slot_t)(uintptr_t)cqe -> user_data;
+    if(slot != NULL){ /* cancel requests carry no slot */
+      slot -> res = cqe -> res;
+      slot -> state = URING_SLOT_DONE;
+    }
+    head ++;
+  }
+  __atomic_store_n(ring -> cq_head, head, __ATOMIC_RELEASE);
+}
+
+/* submit prepared operations, and if wait is set block for at least one completion */
+void
+uring_submit(uring_t ring, int wait){
+  int n;
+
+  while(ring -> nprep || wait){
+    n = sys_io_uring_enter(ring -> fd, ring -> nprep, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+    if(n == -1){
+      if(errno == EINTR) continue;
+      perror("io_uring_enter");
+      exit(1);
+    }
+    ring -> nprep -= n;
+    wait = 0;
+  }
+  uring_reap(ring);
+}
+
+static struct io_uring_sqe*
+uring_get_sqe(uring_t ring, uring_slot_t slot){
+  struct io_uring_sqe *sqe;
+  unsigned tail = *ring -> sq_tail;
+  unsigned idx;
+
+  /* submission queue full: hand it to the kernel first */
+  if(tail - __atomic_load_n(ring -> sq_head, __ATOMIC_ACQUIRE) == ring -> sq_entries){
+    uring_submit(ring, 0);
+    tail = *ring -> sq_tail;
+  }
+
+  idx = tail & *ring -> sq_mask;
+  sqe = (struct io_uring_sqe*)ring -> sqes + idx;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe -> user_data = (uintptr_t)slot;
+  ring -> sq_array[idx] = idx;
+  __atomic_store_n(ring -> sq_tail, tail + 1, __ATOMIC_RELEASE);
+  ring -> nprep ++;
+
+  if(slot != NULL)
+    slot -> state = URING_SLOT_BUSY;
+
+  return sqe;
+}
+
+static int
+uring_is_fixed(uring_t ring, const void* buf, int len){
+  return ring -> fixed_base != NULL
+    && (const char*)buf >= ring -> fixed_base
+    && (const char*)buf + len <= ring -> fixed_base + ring -> fixed_len;
+}
+
+/* receive until len bytes, EOF or error */
+void
+uring_prep_recv(uring_t ring, uring_slot_t slot, int fd, void* buf, int len){
+  struct io_uring_sqe *sqe = uring_get_sqe(ring, slot);
+
+  sqe -> fd = fd;
+  sqe -> addr = (uintptr_t)buf;
+  sqe -> len = len;
+  if(uring_is_fixed(ring, buf, len)){
+    sqe -> opcode = IORING_OP_READ_FIXED;
+    sqe -> buf_index = 0;
+  }else{
+    sqe -> opcode = IORING_OP_RECV;
+    sqe -> msg_flags = MSG_WAITALL;
+  }
+  slot -> buf = buf;
+}
+
+/* send until len bytes or error */
+void
+uring_prep_send(uring_t ring, uring_slot_t slot, int fd, const void* buf, int len){
+  struct io_uring_sqe *sqe = uring_get_sqe(ring, slot);
+
+  sqe -> fd = fd;
+  sqe -> addr = (uintptr_t)buf;
+  sqe -> len = len;
+  if(uring_is_fixed(ring, buf, len)){
+    sqe -> opcode = IORING_OP_WRITE_FIXED;
+    sqe -> buf_index = 0;
+  }else{
+    sqe -> opcode = IORING_OP_SEND;
+    sqe -> msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+  }
+  slot -> buf = buf;
+}
+
+/* one-shot readiness, events as in poll(2) */
+void
+uring_prep_poll(uring_t ring, uring_slot_t slot, int fd, int events){
+  struct io_uring_sqe *sqe = uring_get_sqe(ring, slot);
+
+  sqe -> opcode = IORING_OP_POLL_ADD;
+  sqe -> fd = fd;
+  sqe -> poll32_events = events;
+  slot -> buf = NULL;
+}
+
+/* only one timeout may be outstanding per ring */
+void
+uring_prep_timeout(uring_t ring, uring_slot_t slot, const struct timeval* tv){
+  struct io_uring_sqe *sqe = uring_get_sqe(ring, slot);
+
+  ring -> timeout[0] = tv -> tv_sec;
+  ring -> timeout[1] = tv -> tv_usec * 1000LL;
+
+  sqe -> opcode = IORING_OP_TIMEOUT;
+  sqe -> fd = -1;
+  sqe -> addr = (uintptr_t)ring -> timeout;
+  sqe -> len = 1;
+  slot -> buf = NULL;
+}
+
+/* the slot completes (possibly with -ECANCELED) at a later uring_submit() */
+void
+uring_prep_cancel(uring_t ring, uring_slot_t slot){
+  struct io_uring_sqe *sqe = uring_get_sqe(ring, NULL);
+
+  sqe -> opcode = IORING_OP_ASYNC_CANCEL;
+  sqe -> fd = -1;
+  sqe -> addr = (uintptr_t)slot;
+}
+
+#else // HAVE_LINUX_IO_URING_H
+
+uring_t
+uring_create(int entries){
+  fprintf(stderr, "uring_create: built without io_uring support\n");
+  return NULL;
+}
+
+void uring_destroy(uring_t ring){}
+int uring_register_buffer(uring_t ring, void* base, long len){ return -1; }
+void uring_prep_recv(uring_t ring, uring_slot_t slot, int fd, void* buf, int len){}
+void uring_prep_send(uring_t ring, uring_slot_t slot, int fd, const void* buf, int len){}
+void uring_prep_poll(uring_t ring, uring_slot_t slot, int fd, int events){}
+void uring_prep_timeout(uring_t ring, uring_slot_t slot, const struct timeval* tv){}
+void uring_prep_cancel(uring_t ring, uring_slot_t slot){}
+void uring_submit(uring_t ring, int wait){}
+
+#endif // HAVE_LINUX_IO_URING_H
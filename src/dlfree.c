@@ -1,5 +1,6 @@
 #include <dlfree/dlfree.h>
 #include <comm/comm.h>
+#include <comm/coll.h>
 
 /**
    Node communicator constructor
@@ -10,6 +11,19 @@ dlfree_comm_node_create(int node_id){
   return comm_node_create(node_id);
 }
 
+/**
+   Node communicator constructor with a choice of I/O backend.
+   With DLFREE_IO_URING, reads and writes of all channels are posted to an
+   io_uring and submitted in batches, instead of select() followed by a
+   recv()/send() per channel. Falls back to select() if io_uring is unavailable.
+   \param node_id a unique integer node id
+   \param io_backend DLFREE_IO_SELECT or DLFREE_IO_URING
+*/
+dlfree_comm_node_t
+dlfree_comm_node_create_with_io(int node_id, int io_backend){
+  return comm_node_create_with_io(node_id, io_backend == DLFREE_IO_URING ? COMM_IO_URING : COMM_IO_SELECT);
+}
+
 /**
    Node communicator destructor
    \param node node communicator
@@ -19,6 +33,64 @@ dlfree_comm_node_destroy(dlfree_comm_node_t node){
   comm_node_destroy(node);
 }
 
+/**
+   Send large chunks with MSG_ZEROCOPY, so the kernel transmits from the
+   chunk buffer without copying it. Applies to links connected afterwards,
+   select() backend only. A link goes back to copying sends if the kernel
+   does not support it or keeps copying anyway (e.g. loopback).
+   \param node node communicator
+   \param on non-zero to enable
+*/
+void
+dlfree_comm_node_set_zerocopy(dlfree_comm_node_t node, int on){
+  comm_node_set_zerocopy(node, on);
+}
+
+/**
+   Coalesce small messages to the same destination into one chunk.
+   The chunk is sent when it fills up or shortly after its first message
+   was packed, relayed as a unit, and split again at the destination, so
+   each message is still received individually.
+   \param node node communicator
+   \param on non-zero to enable, zero to disable (flushes packed messages)
+*/
+void
+dlfree_comm_node_set_aggregation(dlfree_comm_node_t node, int on){
+  comm_node_set_aggregation(node, on);
+}
+
+/**
+   Send all small messages packed so far, without waiting for the timer
+   \param node node communicator
+*/
+void
+dlfree_comm_node_flush(dlfree_comm_node_t node){
+  comm_node_flush(node);
+}
+
+/**
+   Choose how messages are cut into chunks for each destination.
+   DLFREE_CHUNK_FIXED uses one size everywhere. DLFREE_CHUNK_WIDTH scales it
+   by the path width relative to the widest path. DLFREE_CHUNK_ADAPTIVE picks
+   small chunks for many-hop paths, so relays overlap, and large chunks for
+   single links or when the first hop is backlogged.
+   \param node node communicator
+   \param policy DLFREE_CHUNK_FIXED, DLFREE_CHUNK_WIDTH or DLFREE_CHUNK_ADAPTIVE
+*/
+void
+dlfree_comm_node_set_chunk_policy(dlfree_comm_node_t node, int policy){
+  switch(policy){
+  case DLFREE_CHUNK_WIDTH:
+    comm_node_set_chunk_policy(node, COMM_CHUNK_WIDTH);
+    break;
+  case DLFREE_CHUNK_ADAPTIVE:
+    comm_node_set_chunk_policy(node, COMM_CHUNK_ADAPTIVE);
+    break;
+  default:
+    comm_node_set_chunk_policy(node, COMM_CHUNK_FIXED);
+  }
+}
+
 /**
    Get the node communicator listen port
    \param node node communicator
@@ -42,6 +114,38 @@ long dlfree_comm_node_async_connect(dlfree_comm_node_t node, const char* addr, i
   return comm_node_async_connect(node, addr, port);
 }
 
+/**
+   Asynchronously open an extra parallel TCP stream to a node communicator
+   that is already connected. Chunks sent over the link are striped over all its streams.
+   \param node   node communicator
+   \param dst_id the connected node communicator id
+   \param addr   destination IP address
+   \param port   destination (listen) port
+   
+   \return handle that can be used to synchronously wait for completion
+*/
+unsigned
+long dlfree_comm_node_async_connect_stream(dlfree_comm_node_t node, int dst_id, const char* addr, int port){
+  return comm_node_async_connect_stream(node, dst_id, addr, port);
+}
+
+/**
+   Asynchronously open the TCP connection carrying a virtual lane of a link
+   to a node communicator that is already connected. Routing tables computed
+   with lanes send each hop over the lane it was assigned.
+   \param node   node communicator
+   \param dst_id the connected node communicator id
+   \param lane   lane number, from 1 (lane 0 is the link itself)
+   \param addr   destination IP address
+   \param port   destination (listen) port
+   
+   \return handle that can be used to synchronously wait for completion
+*/
+unsigned
+long dlfree_comm_node_async_connect_lane(dlfree_comm_node_t node, int dst_id, int lane, const char* addr, int port){
+  return comm_node_async_connect_lane(node, dst_id, lane, addr, port);
+}
+
 /**
    Synchronously wait for a dispatched connection request
    \param node   node communicator
@@ -55,6 +159,37 @@ dlfree_comm_node_connect_wait(dlfree_comm_node_t node, unsigned long handle, int
   return comm_node_connect_wait(node, handle, dst_id);
 }
 
+/**
+   Join an overlay that is already running, in place of computing and
+   exchanging routing tables. Connect to the neighbors first; the node id
+   must be the number of nodes so far, counting any that left. The new node
+   hangs below its neighbors, so no existing route changes, and it relays
+   nothing itself. Groups other than DLFREE_GROUP_ALL must be created again,
+   in the same order as on the other nodes, and DLFREE_GROUP_ALL split again
+   with dlfree_coll_hier_create() on every node if it was split. One node may
+   join or leave at a time.
+   \param node node communicator
+   \return 0 once every node can route to and from it, or -1 if some node
+   could only be reached over failed links (nothing is changed; destroy the
+   node or join again with other neighbors)
+*/
+int
+dlfree_comm_node_join(dlfree_comm_node_t node){
+  return comm_node_join(node);
+}
+
+/**
+   Leave the overlay: the other nodes route around this one, as around failed
+   links, and drop it from DLFREE_GROUP_ALL, which is then no longer split by
+   dlfree_coll_hier_create(). Destroy the node afterwards;
+   chunks already on their way through it are relayed until then.
+   \param node node communicator
+*/
+void
+dlfree_comm_node_leave(dlfree_comm_node_t node){
+  comm_node_leave(node);
+}
+
 /**
    returns the RTT (Round Trip Time) with another node communicator
    \param node   node communicator
@@ -71,6 +206,8 @@ dlfree_comm_node_peer_rtt(dlfree_comm_node_t node, int dst_id){
    Synchronously send a message to another node communicator.
    Internally, the message is segmented into 'message chunks' and queued on the
    internal finite queue. The function unblocks when all chunks are enqueued.
+   It is thread-safe: each calling thread queues on its own submission queue,
+   which the I/O thread drains, so concurrent senders do not contend on a lock.
    
    \param node     node communicator
    \param dst_id   the destination node communicator id
@@ -82,6 +219,242 @@ dlfree_comm_node_send_data(dlfree_comm_node_t node, int dst_id, const void *buff
   comm_node_send_data(node, dst_id, buff, buffsize);
 }
 
+/**
+   Send a message with a priority class.
+   Every link on the path schedules its queued chunks per flow (source,
+   destination and class), and a flow gets link time in proportion to the
+   weight of its class, so small urgent messages need not wait behind a
+   bulk transfer. dlfree_comm_node_send_data() uses DLFREE_PRIO_NORMAL.
+   \param node     node communicator
+   \param dst_id   the destination node communicator id
+   \param buff     pointer to the head of the data
+   \param buffsize size of the buffer
+   \param prio     DLFREE_PRIO_LOW, DLFREE_PRIO_NORMAL or DLFREE_PRIO_HIGH
+*/
+void
+dlfree_comm_node_send_data_prio(dlfree_comm_node_t node, int dst_id, const void *buff, int buffsize, int prio){
+  comm_node_send_data_prio(node, dst_id, buff, buffsize, prio == DLFREE_PRIO_HIGH ? COMM_PRIO_HIGH : prio == DLFREE_PRIO_LOW ? COMM_PRIO_LOW : COMM_PRIO_NORMAL);
+}
+
+/**
+   Create a multicast group.
+   Groups are numbered in the order they are created, so every node
+   communicator must create the same groups in the same order, and before
+   a message multicast to the group reaches it. DLFREE_GROUP_ALL, the group
+   of all node communicators, exists once routing tables are exchanged.
+   \param node    node communicator
+   \param members node communicator ids of the members
+   \param n       number of members
+
+   \return the group id
+*/
+int
+dlfree_comm_node_group_create(dlfree_comm_node_t node, const int* members, int n){
+  return comm_node_group_create(node, members, n);
+}
+
+/**
+   Send a message to every member of a group, except the sender.
+   The message follows the routes to the members, and nodes where these part
+   pass the same chunks on to each next hop, so each link carries it once.
+   Members receive it with dlfree_comm_node_recv_data().
+   \param node     node communicator
+   \param gid      group id, from dlfree_comm_node_group_create() or DLFREE_GROUP_ALL
+   \param buff     pointer to the head of the data
+   \param buffsize size of the buffer
+*/
+void
+dlfree_comm_node_mcast_data(dlfree_comm_node_t node, int gid, const void *buff, int buffsize){
+  comm_node_mcast_data(node, gid, buff, buffsize);
+}
+
+const dlfree_op_t dlfree_op_sum_int = coll_op_sum_int;
+const dlfree_op_t dlfree_op_sum_long = coll_op_sum_long;
+const dlfree_op_t dlfree_op_sum_float = coll_op_sum_float;
+const dlfree_op_t dlfree_op_sum_double = coll_op_sum_double;
+const dlfree_op_t dlfree_op_max_double = coll_op_max_double;
+const dlfree_op_t dlfree_op_min_double = coll_op_min_double;
+
+/**
+   Barrier among the members of a group, with small messages over the overlay.
+   It takes log2 of the group size rounds of one-way messages, and can be used
+   in place of gxp_man_sync() once the routing tables have been exchanged.
+   \param node     node communicator
+   \param gid      group id
+*/
+void
+dlfree_coll_barrier(dlfree_comm_node_t node, int gid){
+  coll_barrier(node, gid);
+}
+
+/**
+   Broadcast a message from one member of a group to the others.
+   The message is multicast along the routes from the root, chunk by chunk.
+   Every member of a group must call the collective operations on it
+   in the same order.
+   \param node     node communicator
+   \param gid      group id
+   \param root_id  node communicator id of the sending member
+   \param buff     data at the root, filled in on the other members
+   \param buffsize size of the buffer, the same on all members
+*/
+void
+dlfree_coll_bcast(dlfree_comm_node_t node, int gid, int root_id, void* buff, int buffsize){
+  coll_bcast(node, gid, root_id, buff, buffsize);
+}
+
+/**
+   Reduce vectors of all members of a group into the root.
+   \param node      node communicator
+   \param gid       group id
+   \param root_id   node communicator id of the member receiving the result
+   \param buff      vector of count elements. Holds the result at the root,
+                    and is overwritten on the other members
+   \param count     number of elements
+   \param elem_size size of an element
+   \param op        reduction operator, e.g. dlfree_op_sum_double
+*/
+void
+dlfree_coll_reduce(dlfree_comm_node_t node, int gid, int root_id, void* buff, int count, int elem_size, dlfree_op_t op){
+  coll_reduce(node, gid, root_id, buff, count, elem_size, op);
+}
+
+/**
+   Reduce vectors of all members of a group, leaving the result on all of them.
+   Large vectors are reduce-scattered and then allgathered around a ring of
+   the members, ordered from the routing tables so that neighbors in the ring
+   are close, with segments pipelined around it.
+   \param node      node communicator
+   \param gid       group id
+   \param buff      vector of count elements, replaced by the result
+   \param count     number of elements
+   \param elem_size size of an element
+   \param op        reduction operator, e.g. dlfree_op_sum_double
+*/
+void
+dlfree_coll_allreduce(dlfree_comm_node_t node, int gid, void* buff, int count, int elem_size, dlfree_op_t op){
+  coll_allreduce(node, gid, buff, count, elem_size, op);
+}
+
+/**
+   Reduce vectors of all members of a group, leaving one block of the result
+   on each member. The rest of the vector is overwritten.
+   \param node      node communicator
+   \param gid       group id
+   \param buff      vector of count elements
+   \param count     number of elements
+   \param elem_size size of an element
+   \param op        reduction operator, e.g. dlfree_op_sum_double
+*/
+void
+dlfree_coll_reduce_scatter(dlfree_comm_node_t node, int gid, void* buff, int count, int elem_size, dlfree_op_t op){
+  coll_reduce_scatter(node, gid, buff, count, elem_size, op);
+}
+
+/**
+   Tell the block of a member, as left by dlfree_coll_reduce_scatter().
+   Blocks are in the order members were given to the group.
+   \param node      node communicator
+   \param gid       group id
+   \param member_id node communicator id of the member
+   \param count     number of elements of the vector
+   \param off       first element of the block
+   \param n         number of elements of the block
+*/
+void
+dlfree_coll_block(dlfree_comm_node_t node, int gid, int member_id, int count, int* off, int* n){
+  coll_block(node, gid, member_id, count, off, n);
+}
+
+/**
+   Gather a message from each member of a group on all of them.
+   \param node     node communicator
+   \param gid      group id
+   \param sendbuff data of this member
+   \param recvbuff buffsize bytes from each member, in the order members were given
+   \param buffsize size of the data of each member
+*/
+void
+dlfree_coll_allgather(dlfree_comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int buffsize){
+  coll_allgather(node, gid, sendbuff, recvbuff, buffsize);
+}
+
+/**
+   Send a distinct message from each member of a group to each other member.
+   Flows are scheduled in phases in which no two of them share a link.
+   \param node     node communicator
+   \param gid      group id
+   \param sendbuff buffsize bytes for each member, in the order members were given
+   \param recvbuff buffsize bytes from each member, in the same order
+   \param buffsize size of the data sent to each member
+*/
+void
+dlfree_coll_alltoall(dlfree_comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int buffsize){
+  coll_alltoall(node, gid, sendbuff, recvbuff, buffsize);
+}
+
+/**
+   Split a group into clusters, e.g. the hosts under one switch or site, for the
+   dlfree_coll_hier_*() operations. These aggregate within each cluster and
+   only let its leader talk to the other clusters.
+   Like dlfree_comm_node_group_create(), every node must call it with the
+   same arguments. A join or leave replaces DLFREE_GROUP_ALL with a group that
+   is not split, so split it again afterwards.
+   \param node      node communicator
+   \param gid       group id
+   \param clusters  cluster of each member, from 0 to nclusters - 1, in the order members were given
+   \param nclusters number of clusters
+   \param leaders   node communicator id of the leader of each cluster
+   \return 0, or -1 if no more groups can be created (the group is left as is)
+*/
+int
+dlfree_coll_hier_create(dlfree_comm_node_t node, int gid, const int* clusters, int nclusters, const int* leaders){
+  return coll_hier_create(node, gid, clusters, nclusters, leaders);
+}
+
+/**
+   dlfree_coll_bcast() through the cluster leaders of a group split by
+   dlfree_coll_hier_create().
+   \param node     node communicator
+   \param gid      group id
+   \param root_id  node communicator id of the sending member
+   \param buff     data at the root, filled in on the other members
+   \param buffsize size of the buffer, the same on all members
+*/
+void
+dlfree_coll_hier_bcast(dlfree_comm_node_t node, int gid, int root_id, void* buff, int buffsize){
+  coll_hier_bcast(node, gid, root_id, buff, buffsize);
+}
+
+/**
+   dlfree_coll_allreduce() that reduces within each cluster of a group split by
+   dlfree_coll_hier_create(), then among the cluster leaders.
+   \param node      node communicator
+   \param gid       group id
+   \param buff      vector of count elements, replaced by the result
+   \param count     number of elements
+   \param elem_size size of an element
+   \param op        reduction operator, e.g. dlfree_op_sum_double
+*/
+void
+dlfree_coll_hier_allreduce(dlfree_comm_node_t node, int gid, void* buff, int count, int elem_size, dlfree_op_t op){
+  coll_hier_allreduce(node, gid, buff, count, elem_size, op);
+}
+
+/**
+   dlfree_coll_alltoall() that packs the messages between two clusters of a group
+   split by dlfree_coll_hier_create() into one, exchanged by their leaders.
+   \param node     node communicator
+   \param gid      group id
+   \param sendbuff buffsize bytes for each member, in the order members were given
+   \param recvbuff buffsize bytes from each member, in the same order
+   \param buffsize size of the data sent to each member
+*/
+void
+dlfree_coll_hier_alltoall(dlfree_comm_node_t node, int gid, const void* sendbuff, void* recvbuff, int buffsize){
+  coll_hier_alltoall(node, gid, sendbuff, recvbuff, buffsize);
+}
+
 /**
    Synchronously wait for a message from a specific node communicator.
    The function unblocks if a message from a given node is fully received.
@@ -1,6 +1,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <std/std.h>
@@ -79,23 +80,51 @@ alloc_edges(leveled_dijkstra_t dijk, int num_nodes, int num_levels){
 
 leveled_dijkstra_t
 leveled_dijkstra_create(overlay_node_vector_t nodes, int num_levels){
+  return leveled_dijkstra_create_with_lanes(nodes, num_levels, 1);
+}
+
+/* routes may use up to num_lanes virtual lanes per link */
+leveled_dijkstra_t
+leveled_dijkstra_create_with_lanes(overlay_node_vector_t nodes, int num_levels, int num_lanes){
   leveled_dijkstra_t dijk = (leveled_dijkstra_t) std_malloc(sizeof(leveled_dijkstra));
   int num_nodes = overlay_node_vector_size(nodes);
 
+  assert(num_lanes >= 1);
   dijk -> num_nodes = num_nodes; 
   dijk -> num_levels = num_levels;
+  dijk -> num_lanes = num_lanes;
+  dijk -> num_states = num_levels * num_lanes;
+  dijk -> src_dist = NULL;
+  dijk -> src_prev = NULL;
+  dijk -> src_prev_level = NULL;
 
-  alloc_nodes(dijk, nodes, num_nodes, num_levels);
-  alloc_edges(dijk, num_nodes, num_levels);
+  alloc_nodes(dijk, nodes, num_nodes, dijk -> num_states);
+  alloc_edges(dijk, num_nodes, dijk -> num_states);
 
   return dijk;
 }
 
 void
 leveled_dijkstra_destroy(leveled_dijkstra_t dijk){
-  int i;
+  int i, src;
   std_free(dijk -> pid_to_node);
 
+  if(dijk -> src_dist != NULL){
+    for(src = 0; src < dijk -> num_nodes; src++){
+      for(i = 0; i < dijk -> num_nodes; i ++){
+	std_free(dijk -> src_dist[src][i]);
+	std_free(dijk -> src_prev[src][i]);
+	std_free(dijk -> src_prev_level[src][i]);
+      }
+      std_free(dijk -> src_dist[src]);
+      std_free(dijk -> src_prev[src]);
+      std_free(dijk -> src_prev_level[src]);
+    }
+    std_free(dijk -> src_dist);
+    std_free(dijk -> src_prev);
+    std_free(dijk -> src_prev_level);
+  }
+
   for(i = 0; i < dijk -> num_nodes; i ++){
     std_free(dijk -> prev[i]);
     std_free(dijk -> prev_level[i]);
@@ -153,20 +182,23 @@ setup(leveled_dijkstra_t dijk, router_graph_link_list_t links, int seed){
 }
 
 /* extract closest un-extracted node */
-/* if the distance is the same, choose smaller pid, larger level */
+/* if the distance is the same, choose smaller pid, smaller lane, larger level */
 static int
 extract_min_node(leveled_dijkstra_t dijk, int *pid, int *level){
-  int p, l;
+  int p, k, l, s;
   float val = MAX_DIJKSTRA_DIST;
   *pid = -1; *level = -1;
   for(p = 0; p < dijk -> num_nodes; p++){
-    for(l = dijk -> num_levels - 1; l >= 0; l--){
+    for(k = 0; k < dijk -> num_lanes; k++){
+      for(l = dijk -> num_levels - 1; l >= 0; l--){
 /*     for(l = 0; l < dijk -> num_levels; l++){ */
-      if(dijk -> reached[p][l]) /* if node removed, ignore */
-	continue;
-      if(dijk -> dist[p][l] < val){
-	val = dijk -> dist[p][l];
-	*pid = p; *level = l;
+	s = k * dijk -> num_levels + l;
+	if(dijk -> reached[p][s]) /* if node removed, ignore */
+	  continue;
+	if(dijk -> dist[p][s] < val){
+	  val = dijk -> dist[p][s];
+	  *pid = p; *level = s;
+	}
       }
     }
   }
@@ -179,11 +211,50 @@ extract_min_node(leveled_dijkstra_t dijk, int *pid, int *level){
   }
 }
 
+/* relax edge u -> v from state (u, state). with reopen, settled states of v */
+/* that get closer are searched again. returns 1 if any state of v got closer */
+static int
+relax(leveled_dijkstra_t dijk, int u, int state, int v, int reopen){
+  int l, s, next_lane, improved = 0;
+  int lane = state / dijk -> num_levels;
+  int level = state % dijk -> num_levels;
+
+  if(dijk -> levels[u][v] == -1) /* no edge */
+    return 0;
+
+  /* lower edge level: only possible on the next lane */
+  if(dijk -> levels[u][v] >= level)
+    next_lane = lane;
+  else if(lane + 1 < dijk -> num_lanes)
+    next_lane = lane + 1;
+  else
+    return 0;
+
+  /* try out (v, l) such that l >= edge level */
+  for(l = dijk -> levels[u][v]; l < dijk -> num_levels; l++){
+    s = next_lane * dijk -> num_levels + l;
+    if(dijk -> dist[u][state] + dijk -> metrics[u][v] < dijk -> dist[v][s]){
+      dijk -> dist[v][s] = dijk -> dist[u][state] + dijk -> metrics[u][v];
+
+      if(reopen)
+	dijk -> reached[v][s] = 0;
+      assert(dijk -> reached[v][s] == 0);
+      /* set prev pointer */
+      dijk -> prev[v][s] = u;
+      dijk -> prev_level[v][s] = state;
+      improved = 1;
+
+      /*  printf("(%d,%d) -%.3f(%d)-> (%d, %d): %.3f\n", u, state, dijk -> metrics[u][v], dijk -> levels[u][v], v, s, dijk -> dist[v][s]);fflush(stdout); */
+    }
+  }
+  return improved;
+}
+
 static void
 compute(leveled_dijkstra_t dijk, overlay_node_t src){
   int l;
   int u, v;
-  int level;
+  int state;
 /*   int total = dijk -> num_nodes * dijk -> num_levels; */
   /* init source node */
   int src_pid = src -> pid;
@@ -201,31 +272,14 @@ compute(leveled_dijkstra_t dijk, overlay_node_t src){
   /* for(i = 0; i < total; i ++){ */
   while(1){
     /* find next closest (u, l) node */
-    if(extract_min_node(dijk, &u, &level) == -1)
+    if(extract_min_node(dijk, &u, &state) == -1)
       break; /* if no more reachable nodes, exit */
 
-    /* printf("extracted (%d, %d)\n", u, level);fflush(stdout); */
+    /* printf("extracted (%d, %d)\n", u, state);fflush(stdout); */
 
     /* cycle through neighbor edges */
-    for(v = 0; v < dijk -> num_nodes; v++){
-      /* if lower edge level, ignore */
-      if(dijk -> levels[u][v] < level)
-	continue;
-
-      /* try out (v, l) such that l >= edge level */
-      for(l = dijk -> levels[u][v]; l < dijk -> num_levels; l++){
-	if(dijk -> dist[u][level] + dijk -> metrics[u][v] < dijk -> dist[v][l]){
-	  dijk -> dist[v][l] = dijk -> dist[u][level] + dijk -> metrics[u][v];
-
-	  assert(dijk -> reached[v][l] == 0);
-	  /* set prev pointer */
-	  dijk -> prev[v][l] = u;
-	  dijk -> prev_level[v][l] = level;
-
-	 /*  printf("(%d,%d) -%.3f(%d)-> (%d, %d): %.3f\n", u, level, dijk -> metrics[u][v], dijk -> levels[u][v], v, l, dijk -> dist[v][l]);fflush(stdout); */
-	}
-      }
-    }
+    for(v = 0; v < dijk -> num_nodes; v++)
+      relax(dijk, u, state, v, 0);
   }
 }
 
@@ -234,13 +288,83 @@ compute(leveled_dijkstra_t dijk, overlay_node_t src){
 /*   printf("%ld", pid); */
 /* } */
 
-static overlay_rtable_t
-calc_rt(leveled_dijkstra_t dijk, overlay_node_t src){
-  int dst, l, i, hops, metric, *path;
+/* route to dst found by the last compute(), NULL if unreachable */
+static overlay_rtable_entry_t
+calc_entry(leveled_dijkstra_t dijk, int dst){
+  int k, l, s, i, hops, metric, *path, *lanes;
   int node, level, tmp_n, tmp_l;
   float min_dist;
   float min_width;
-  long_vector_t node_stack = long_vector_create(1);
+  long_vector_t node_stack;
+  long_vector_t lane_stack;
+  overlay_rtable_entry_t rentry;
+
+  /* figure out level that yields shortest path */
+  min_dist = MAX_DIJKSTRA_DIST;
+  level = -1;
+  /* can better diversify path if we try to choose high level paths, */
+  /* but stay on low lanes */
+  for(k = 0; k < dijk -> num_lanes; k++){
+    for(l = dijk -> num_levels - 1; l >= 0; l--){
+      s = k * dijk -> num_levels + l;
+      if(dijk -> dist[dst][s] < min_dist){
+	min_dist = dijk -> dist[dst][s];
+	level = s;
+      }
+    }
+  }
+  if(level == -1)
+    return NULL;
+
+  /* figure out path from src to dst node */
+  node_stack = long_vector_create(1);
+  lane_stack = long_vector_create(1);
+  node = dst;
+  min_width = MAX_DIJKSTRA_WIDTH;
+  /* printf("level: "); */
+  while(1){
+    /* printf("%d, ", level); */
+    long_vector_add(node_stack, node);
+    tmp_l = dijk -> prev_level[node][level];
+    tmp_n = dijk -> prev[node][level];
+
+    if(tmp_n == -1)
+      break;
+    long_vector_add(lane_stack, level / dijk -> num_levels); /* lane of hop tmp_n -> node */
+      
+    min_width = min_width < dijk -> width[tmp_n][node] ? min_width : dijk -> width[tmp_n][node];
+    node = tmp_n; level = tmp_l;
+  }
+  /* long_vector_print(node_stack, print_pid_for_vec); */
+
+  /* store routing information in routing table */
+  long_vector_reverse(node_stack);
+  hops = long_vector_size(node_stack) - 1; /* because srcnode is included in path */
+  path = (int*) std_malloc(sizeof(int) * (hops + 1));
+  for(i = 0; i < hops + 1; i++){
+    path[i] = (int)long_vector_get(node_stack, i);
+  }
+  long_vector_reverse(lane_stack);
+  lanes = (int*) std_malloc(sizeof(int) * (hops + 1));
+  for(i = 0; i < hops; i++){
+    lanes[i] = (int)long_vector_get(lane_stack, i);
+  }
+
+  metric = (int)(min_dist);
+  rentry = overlay_rtable_entry_create(dst, path, hops, metric, min_width);
+  overlay_rtable_entry_set_lanes(rentry, lanes);
+
+  std_free(path);
+  std_free(lanes);
+  long_vector_destroy(node_stack);
+  long_vector_destroy(lane_stack);
+
+  return rentry;
+}
+
+static overlay_rtable_t
+calc_rt(leveled_dijkstra_t dijk, overlay_node_t src){
+  int dst;
   overlay_rtable_t rt;
   overlay_rtable_entry_t rentry;
 
@@ -250,61 +374,77 @@ calc_rt(leveled_dijkstra_t dijk, overlay_node_t src){
   for(dst = 0; dst < dijk -> num_nodes; dst ++){
     if(dst == src_pid)
       continue;
-    /* for each dst, figure out level that yields shortest path */
-    min_dist = MAX_DIJKSTRA_DIST;
-    level = -1;
-    /* can better diversify path if we try to choose high level paths */
-    for(l = dijk -> num_levels - 1; l >= 0; l--){
-      if(dijk -> dist[dst][l] < min_dist){
-	min_dist = dijk -> dist[dst][l];
-	level = l;
-      }
-    }
-    if(level == -1){
+    if((rentry = calc_entry(dijk, dst)) == NULL){
       fprintf(stderr, "dstid: %d is unreachable from srcpid: %d\n", dst, src_pid);
       exit(1);
     }
-
-    /* figure out path from src to dst node */
-    node = dst;
-    min_width = MAX_DIJKSTRA_WIDTH;
-    /* printf("level: "); */
-    while(1){
-      /* printf("%d, ", level); */
-      long_vector_add(node_stack, node);
-      tmp_l = dijk -> prev_level[node][level];
-      tmp_n = dijk -> prev[node][level];
-
-      if(tmp_n == -1)
-	break;
-      
-      min_width = min_width < dijk -> width[tmp_n][node] ? min_width : dijk -> width[tmp_n][node];
-      node = tmp_n; level = tmp_l;
-    }
-    /* long_vector_print(node_stack, print_pid_for_vec); */
-
-    /* store routing information in routing table */
-    long_vector_reverse(node_stack);
-    hops = long_vector_size(node_stack) - 1; /* because srcnode is included in path */
-    path = (int*) std_malloc(sizeof(int) * (hops + 1));
-    for(i = 0; i < hops + 1; i++){
-      path[i] = (int)long_vector_get(node_stack, i);
-    }
-
-    metric = (int)(min_dist);
-    rentry = overlay_rtable_entry_create(dst, path, hops, metric, min_width);
     overlay_rtable_add_entry(rt, rentry);
+  }
 
-    std_free(path);
+  /* overlay_rtable_print(rt); */
 
-    long_vector_clear(node_stack);
+  return rt;
+}
+
+/* forget distances of the last compute() */
+static void
+reset(leveled_dijkstra_t dijk){
+  int pid, s;
+  for(pid = 0; pid < dijk -> num_nodes; pid++){
+    for(s = 0; s < dijk -> num_states; s++){
+      dijk -> dist[pid][s] = MAX_DIJKSTRA_DIST;
+      dijk -> prev[pid][s] = -1;
+      dijk -> prev_level[pid][s] = -1;
+      dijk -> reached[pid][s] = 0;
+    }
   }
+}
 
-  long_vector_destroy(node_stack);
+/* further routes to the destination of 'entry' that share no directed */
+/* link with the ones found so far. each obeys the same level and lane order, */
+/* so all of them together stay deadlock-free */
+static void
+calc_alt_entries(leveled_dijkstra_t dijk, overlay_node_t src, overlay_rtable_entry_t entry, int npaths){
+  overlay_rtable_entry_t e, alt;
+  long_vector_t removed = long_vector_create(1);
+  int i, k, u, v;
+
+  for(k = 1; k < npaths; k++){
+    /* take out links of the routes so far */
+    for(e = entry; e != NULL; e = e -> alt){
+      for(i = 0; i < e -> hops; i++){
+	u = e -> path[i]; v = e -> path[i + 1];
+	if(dijk -> levels[u][v] == -1)
+	  continue;
+	long_vector_add(removed, (long)u * dijk -> num_nodes + v);
+	long_vector_add(removed, dijk -> levels[u][v]);
+	dijk -> levels[u][v] = -1;
+      }
+    }
 
-  /* overlay_rtable_print(rt); */
+    reset(dijk);
+    compute(dijk, src);
+    alt = calc_entry(dijk, entry -> dst_pid);
 
-  return rt;
+    /* put the links back */
+    for(i = 0; i < long_vector_size(removed); i += 2){
+      u = long_vector_get(removed, i) / dijk -> num_nodes;
+      v = long_vector_get(removed, i) % dijk -> num_nodes;
+      dijk -> levels[u][v] = (int)long_vector_get(removed, i + 1);
+    }
+    long_vector_clear(removed);
+
+    /* a long detour costs more latency than its bandwidth is worth */
+    if(alt == NULL)
+      break;
+    if(alt -> metric > entry -> metric * MULTIPATH_MAX_STRETCH){
+      overlay_rtable_entry_destroy(alt);
+      break;
+    }
+    overlay_rtable_entry_add_alt(entry, alt);
+  }
+
+  long_vector_destroy(removed);
 }
 
 overlay_rtable_t
@@ -313,3 +453,248 @@ leveled_dijkstra_run(leveled_dijkstra_t dijk, router_graph_link_list_t links, ov
   compute(dijk, srcnode);
   return calc_rt(dijk, srcnode);
 }
+
+/* as leveled_dijkstra_run(), with up to npaths link-disjoint routes per destination */
+overlay_rtable_t
+leveled_dijkstra_run_multipath(leveled_dijkstra_t dijk, router_graph_link_list_t links, overlay_node_t srcnode, int seed, int npaths){
+  overlay_rtable_t rt = leveled_dijkstra_run(dijk, links, srcnode, seed);
+  int dst;
+
+  for(dst = 0; dst < dijk -> num_nodes && npaths > 1; dst ++){
+    if(dst == srcnode -> pid)
+      continue;
+    calc_alt_entries(dijk, srcnode, overlay_rtable_get_entry(rt, dst), npaths);
+  }
+  return rt;
+}
+
+/* exchange the kept tree of src with the one searched, a second call swaps back */
+static void
+swap_tree(leveled_dijkstra_t dijk, int src){
+  float** dist = dijk -> dist;
+  int** prev = dijk -> prev;
+  int** prev_level = dijk -> prev_level;
+
+  dijk -> dist = dijk -> src_dist[src];
+  dijk -> prev = dijk -> src_prev[src];
+  dijk -> prev_level = dijk -> src_prev_level[src];
+  dijk -> src_dist[src] = dist;
+  dijk -> src_prev[src] = prev;
+  dijk -> src_prev_level[src] = prev_level;
+}
+
+/* routes of every source, searched once and kept for leveled_dijkstra_update() */
+overlay_rtable_vector_t
+leveled_dijkstra_run_all(leveled_dijkstra_t dijk, router_graph_link_list_t links, int seed){
+  int src, pid, n = dijk -> num_nodes;
+
+  assert(dijk -> src_dist == NULL);
+  dijk -> src_dist = (float***) std_malloc(sizeof(float**) * n);
+  dijk -> src_prev = (int***) std_malloc(sizeof(int**) * n);
+  dijk -> src_prev_level = (int***) std_malloc(sizeof(int**) * n);
+  for(src = 0; src < n; src++){
+    dijk -> src_dist[src] = (float**) std_malloc(sizeof(float*) * n);
+    dijk -> src_prev[src] = (int**) std_malloc(sizeof(int*) * n);
+    dijk -> src_prev_level[src] = (int**) std_malloc(sizeof(int*) * n);
+    for(pid = 0; pid < n; pid++){
+      dijk -> src_dist[src][pid] = (float*) std_malloc(sizeof(float) * dijk -> num_states);
+      dijk -> src_prev[src][pid] = (int*) std_malloc(sizeof(int) * dijk -> num_states);
+      dijk -> src_prev_level[src][pid] = (int*) std_malloc(sizeof(int) * dijk -> num_states);
+    }
+  }
+
+  setup(dijk, links, seed);
+  for(src = 0; src < n; src++){
+    swap_tree(dijk, src);
+    reset(dijk);
+    compute(dijk, dijk -> pid_to_node[src]);
+    swap_tree(dijk, src);
+  }
+
+  return leveled_dijkstra_calc_all(dijk);
+}
+
+/* routing tables of every source from the kept trees, in pid order */
+overlay_rtable_vector_t
+leveled_dijkstra_calc_all(leveled_dijkstra_t dijk){
+  overlay_rtable_vector_t rt_vec = overlay_rtable_vector_create(1);
+  int src;
+
+  assert(dijk -> src_dist != NULL);
+  for(src = 0; src < dijk -> num_nodes; src++){
+    swap_tree(dijk, src);
+    overlay_rtable_vector_add(rt_vec, calc_rt(dijk, dijk -> pid_to_node[src]));
+    swap_tree(dijk, src);
+  }
+  return rt_vec;
+}
+
+/* mark[pid * num_states + state] = 1 if the tree path to the state takes */
+/* the edge u -> v, 2 if not */
+static void
+mark_subtree(leveled_dijkstra_t dijk, int u, int v, char* mark, int* stack){
+  int p, s, q, t, x, n, found;
+  int ns = dijk -> num_states;
+
+  memset(mark, 0, dijk -> num_nodes * ns);
+  for(p = 0; p < dijk -> num_nodes; p++){
+    for(s = 0; s < ns; s++){
+      /* walk up to the source or to a state already known */
+      q = p; t = s; n = 0; found = 2;
+      while(mark[q * ns + t] == 0){
+	stack[n++] = q * ns + t;
+	x = dijk -> prev[q][t];
+	if(x == -1)
+	  break;
+	if(q == v && x == u){
+	  found = 1;
+	  break;
+	}
+	t = dijk -> prev_level[q][t]; q = x;
+      }
+      if(mark[q * ns + t] != 0)
+	found = mark[q * ns + t];
+      while(n)
+	mark[stack[--n]] = found;
+    }
+  }
+}
+
+/* bring the searched tree up to date after the edge u -> v changed from */
+/* (old_level, old_metric). states routed over the edge are searched again */
+/* unless it only got cheaper */
+static void
+repair(leveled_dijkstra_t dijk, int u, int v, int old_level, float old_metric, char* mark, int* stack){
+  int p, s, w, sw, x;
+  int ns = dijk -> num_states;
+  int worse = old_level != -1 &&
+    (old_level != dijk -> levels[u][v] || old_metric < dijk -> metrics[u][v]);
+
+  for(p = 0; p < dijk -> num_nodes; p++)
+    for(s = 0; s < ns; s++)
+      dijk -> reached[p][s] = 1;
+
+  if(worse){
+    /* forget the subtree below the edge ... */
+    mark_subtree(dijk, u, v, mark, stack);
+    for(p = 0; p < dijk -> num_nodes; p++){
+      for(s = 0; s < ns; s++){
+	if(mark[p * ns + s] != 1)
+	  continue;
+	dijk -> dist[p][s] = MAX_DIJKSTRA_DIST;
+	dijk -> prev[p][s] = -1;
+	dijk -> prev_level[p][s] = -1;
+	dijk -> reached[p][s] = 0;
+      }
+    }
+    /* ... and reach it again from the states left */
+    for(x = 0; x < dijk -> num_nodes; x++){
+      for(s = 0; s < ns && mark[x * ns + s] != 1; s++)
+	;
+      if(s == ns)
+	continue;
+      for(w = 0; w < dijk -> num_nodes; w++){
+	if(dijk -> levels[w][x] == -1)
+	  continue;
+	for(sw = 0; sw < ns; sw++)
+	  if(dijk -> reached[w][sw] && dijk -> dist[w][sw] < MAX_DIJKSTRA_DIST)
+	    relax(dijk, w, sw, x, 1);
+      }
+    }
+  }
+
+  /* the edge itself may now give shorter routes */
+  for(s = 0; s < ns; s++)
+    if(dijk -> reached[u][s] && dijk -> dist[u][s] < MAX_DIJKSTRA_DIST)
+      relax(dijk, u, s, v, 1);
+
+  /* continue the search from the states that moved */
+  while(extract_min_node(dijk, &x, &s) != -1){
+    for(w = 0; w < dijk -> num_nodes; w++)
+      relax(dijk, x, s, w, 1);
+  }
+}
+
+/* directed edge i (0: n0 -> n1, 1: n1 -> n0) of link */
+static void
+link_edge(router_graph_link_t link, int i, int* u, int* v, int* level){
+  *u = (i == 0 ? link -> conn -> n0 : link -> conn -> n1) -> pid;
+  *v = (i == 0 ? link -> conn -> n1 : link -> conn -> n0) -> pid;
+  *level = (i == 0 ? link -> level_0 : link -> level_1);
+}
+
+/* number of directed edges in links that got longer or changed level */
+static int
+count_worse(leveled_dijkstra_t dijk, router_graph_link_list_t links){
+  router_graph_link_list_cell_t link_cell;
+  router_graph_link_t link;
+  int i, u, v, level, worse = 0;
+
+  for(link_cell = router_graph_link_list_head(links);
+      link_cell != router_graph_link_list_end(links);
+      link_cell = router_graph_link_list_cell_next(link_cell)){
+    link = router_graph_link_list_cell_data(link_cell);
+    for(i = 0; i < 2; i++){
+      link_edge(link, i, &u, &v, &level);
+      if(dijk -> levels[u][v] != -1 &&
+	 (dijk -> levels[u][v] != level || dijk -> metrics[u][v] < link -> conn -> len))
+	worse++;
+    }
+  }
+  return worse;
+}
+
+/* take the links given, added or with a new level or metric, into the trees */
+/* kept by leveled_dijkstra_run_all(). only the parts of each tree that the */
+/* changed edges affect are searched again, unless so many edges got worse that */
+/* searching every tree from scratch is cheaper. */
+/* links must not be removed. returns the number of directed edges changed */
+int
+leveled_dijkstra_update(leveled_dijkstra_t dijk, router_graph_link_list_t links){
+  router_graph_link_list_cell_t link_cell;
+  router_graph_link_t link;
+  int src, i, u, v, level, old_level, rebuild, changes = 0;
+  float w, old_metric;
+  char* mark = (char*) std_malloc(dijk -> num_nodes * dijk -> num_states);
+  int* stack = (int*) std_malloc(sizeof(int) * dijk -> num_nodes * dijk -> num_states);
+
+  assert(dijk -> src_dist != NULL);
+  rebuild = count_worse(dijk, links) > dijk -> num_nodes / MAX_DIJKSTRA_UPDATE_RATIO;
+  for(link_cell = router_graph_link_list_head(links);
+      link_cell != router_graph_link_list_end(links);
+      link_cell = router_graph_link_list_cell_next(link_cell)){
+
+    link = router_graph_link_list_cell_data(link_cell);
+    w = link -> conn -> len; /* metric for distance, as in setup() */
+    assert(link -> conn -> width > 0.0); assert(w > 0.0);
+
+    for(i = 0; i < 2; i++){
+      link_edge(link, i, &u, &v, &level);
+      dijk -> width[u][v] = link -> conn -> width;
+      if(dijk -> levels[u][v] == level && dijk -> metrics[u][v] == w)
+	continue;
+
+      old_level = dijk -> levels[u][v];
+      old_metric = dijk -> metrics[u][v];
+      dijk -> levels[u][v] = level;
+      dijk -> metrics[u][v] = w;
+      for(src = 0; src < dijk -> num_nodes && !rebuild; src++){
+	swap_tree(dijk, src);
+	repair(dijk, u, v, old_level, old_metric, mark, stack);
+	swap_tree(dijk, src);
+      }
+      changes++;
+    }
+  }
+
+  for(src = 0; src < dijk -> num_nodes && rebuild; src++){
+    swap_tree(dijk, src);
+    reset(dijk);
+    compute(dijk, dijk -> pid_to_node[src]);
+    swap_tree(dijk, src);
+  }
+
+  std_free(mark);
+  std_free(stack);
+  return changes;
+}
@@ -5,31 +5,54 @@
 
 #define MAX_DIJKSTRA_DIST (10000000.0)
 #define MAX_DIJKSTRA_WIDTH (1000000000.0)
+#define MULTIPATH_MAX_STRETCH (2)   // alternative routes longer than this times the shortest are dropped
+#define MAX_DIJKSTRA_UPDATE_RATIO (2) // an update searches all trees again once over num_nodes / this edges got worse
 
+/* search state of a node: (lane, level) folded into lane * num_levels + level. */
+/* levels must not decrease within a lane, moving to the next virtual lane */
+/* lets a route start over from a lower level */
 typedef struct leveled_dijkstra{
   overlay_node_t* pid_to_node; // [pid] -> node : these are weak refs
-  float** dist; // [pid][level] -> dist
+  float** dist; // [pid][state] -> dist
 
-  int** prev; // [pid][level] -> pid
-  int** prev_level; // [pid][level] -> level
+  int** prev; // [pid][state] -> pid
+  int** prev_level; // [pid][state] -> state
 
   int** levels; // [pid][pid] -> level
   float** metrics; // [pid][pid] -> value
   float** width; // [pid][pid] -> value
 
-  int** reached; // [pid][level] -> 0 or 1
+  int** reached; // [pid][state] -> 0 or 1
+
+  /* search trees of every source, kept by leveled_dijkstra_run_all() so that */
+  /* leveled_dijkstra_update() only has to repair them. NULL otherwise */
+  float*** src_dist; // [src][pid][state]
+  int*** src_prev;
+  int*** src_prev_level;
   
   int num_nodes;
   int num_levels;
+  int num_lanes;
+  int num_states;
   
 } leveled_dijkstra, *leveled_dijkstra_t;
 
 leveled_dijkstra_t
 leveled_dijkstra_create(overlay_node_vector_t nodes, int num_levels);
+leveled_dijkstra_t
+leveled_dijkstra_create_with_lanes(overlay_node_vector_t nodes, int num_levels, int num_lanes);
 void
 leveled_dijkstra_destroy(leveled_dijkstra_t dijk);
 overlay_rtable_t
 leveled_dijkstra_run(leveled_dijkstra_t dijk, router_graph_link_list_t links, overlay_node_t srcnode, int seed);
+overlay_rtable_t
+leveled_dijkstra_run_multipath(leveled_dijkstra_t dijk, router_graph_link_list_t links, overlay_node_t srcnode, int seed, int npaths);
+overlay_rtable_vector_t
+leveled_dijkstra_run_all(leveled_dijkstra_t dijk, router_graph_link_list_t links, int seed);
+int
+leveled_dijkstra_update(leveled_dijkstra_t dijk, router_graph_link_list_t links);
+overlay_rtable_vector_t
+leveled_dijkstra_calc_all(leveled_dijkstra_t dijk);
 
 
 
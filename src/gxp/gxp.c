@@ -6,9 +6,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include <sys/time.h>
+#include <sys/select.h>
 #include <time.h>
 
 #include <std/std.h>
@@ -18,6 +20,8 @@
 #include <sim/rtable_stat.h>
 #include <iface/iface.h>
 #include <comm/impl/comm.h>
+#include <comm/impl/sock.h>
+#include <xml/infer.h>
 #include "impl/gxp.h"
 #include "impl/gxp_router.h"
 
@@ -118,6 +122,9 @@ gxp_man_create(){
   man ->ep_prio_pats = NULL;
   man ->ep_prio_count = 0;
 
+  man -> num_lanes = 1;
+  man -> num_paths = 1;
+
   return man;
 }
 
@@ -241,7 +248,7 @@ gxp_man_sync(gxp_man_t man){
 }
 
 static void
-gxp_man_exchange_ports(gxp_man_t man, int my_port){
+gxp_man_exchange_ports(gxp_man_t man, int my_port, inet_ep_t *eps){
   inet_iface_t my_iface;
   int i;
 
@@ -264,7 +271,7 @@ gxp_man_exchange_ports(gxp_man_t man, int my_port){
   for(i = 0; i < man -> gxp_num_execs; i++){
     fscanf(man -> rfp, "%d %s %d", &peer_idx, buff, &peer_port);
 
-    man -> peer_eps[peer_idx] = inet_ep_create_by_str(buff, peer_port);
+    eps[peer_idx] = inet_ep_create_by_str(buff, peer_port);
   }
   
   inet_iface_destroy(my_iface);
@@ -320,7 +327,7 @@ gxp_man_connect(gxp_man_t man, dlfree_comm_node_t comm, int *plan){
 
   /* exchange endpoint information */
   int my_port = dlfree_comm_node_listen_port(comm);
-  gxp_man_exchange_ports(man, my_port);
+  gxp_man_exchange_ports(man, my_port, man -> peer_eps);
 
   /* do async. connect to all planned peers */
   for(idx = 0; idx < man -> gxp_num_execs; idx++){
@@ -658,6 +665,175 @@ gxp_man_connect_locality_aware(gxp_man_t man, dlfree_comm_node_t comm, const cha
   return conn_mat;
 }
 
+/**
+   Tells the node communicator the bandwidth of each overlay link, as given
+   by the XML topology file. Socket buffers of each link are then re-sized
+   from its bandwidth-delay product, which kernel autotuning is left to
+   otherwise. Must be performed after one of the gxp_man_connect_*()
+   operations, which decide the links; streams opened afterwards by
+   gxp_man_connect_streams() share the buffer size of their link.
+   
+   \param man          gxp interface instance
+   \param comm         node communicator instance
+   \param xml_filename XML topology filename used to determine link bandwidth
+*/
+void
+gxp_man_set_link_widths(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filename){
+  xml_topology_t xml_top;
+  xml_topology_parser_t parser = xml_topology_parser_create();
+  xml_top_node_vector_t path = xml_top_node_vector_create(1);
+  int idx;
+  float len, width;
+
+  xml_top = xml_topology_parser_run(parser, xml_filename);
+  xml_topology_parser_destroy(parser);
+
+  for(idx = 0; idx < man -> gxp_num_execs; idx++){
+    if(man -> conn_mat[man -> gxp_idx][idx] == GXP_NO_RTT &&
+       man -> conn_mat[idx][man -> gxp_idx] == GXP_NO_RTT)
+      continue;
+
+    if(xml_topology_traverse(xml_top, man -> gxp_hostname, man -> peer_hostnames[idx], path, &len, &width))
+      comm_node_set_link_width((comm_node_t)comm, idx, width);
+    xml_top_node_vector_clear(path);
+  }
+
+  xml_top_node_vector_destroy(path);
+  xml_topology_destroy(xml_top);
+}
+
+/**
+   GXP operation to open parallel TCP streams on overlay links with a large
+   bandwidth-delay product, which a single TCP stream cannot fill.
+   For each link this node initiated, the number of streams is chosen from the
+   RTT measured at connect time and the link bandwidth in the XML topology file.
+   Chunks sent over the link are then striped over its streams.
+   Must be performed after one of the gxp_man_connect_*() operations.
+   
+   \param man          gxp interface instance
+   \param comm         node communicator instance
+   \param xml_filename XML topology filename used to determine link bandwidth
+   \param max_streams  max number of streams per link (1 opens no extra streams)
+*/
+void
+gxp_man_connect_streams(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filename, int max_streams){
+  xml_topology_t xml_top;
+  xml_topology_parser_t parser = xml_topology_parser_create();
+  xml_top_node_vector_t path = xml_top_node_vector_create(1);
+  unsigned long *handles = std_calloc(man -> gxp_num_execs * max_streams, sizeof(unsigned long));
+  int idx, i, k, nhandles = 0, dst_id;
+  float len, width;
+  inet_ep_t ep;
+
+  xml_top = xml_topology_parser_run(parser, xml_filename);
+  xml_topology_parser_destroy(parser);
+
+  for(idx = 0; idx < man -> gxp_num_execs; idx++){
+    /* only the side that connected knows the listen endpoint of the peer */
+    if(man -> conn_mat[man -> gxp_idx][idx] == GXP_NO_RTT)
+      continue;
+
+    if(!xml_topology_traverse(xml_top, man -> gxp_hostname, man -> peer_hostnames[idx], path, &len, &width)){
+      xml_top_node_vector_clear(path);
+      continue;
+    }
+    xml_top_node_vector_clear(path);
+
+    /* comm_node_t and dlfree_comm_node_t are the same */
+    comm_node_set_link_width((comm_node_t)comm, idx, width);
+    k = comm_node_calc_streams((comm_node_t)comm, idx, width, max_streams);
+    ep = man -> peer_eps[idx];
+    for(i = 1; i < k; i++){
+      handles[nhandles ++] = dlfree_comm_node_async_connect_stream(comm, idx,
+								   inet_iface_in_addr_str(inet_ep_iface(ep)),
+								   inet_ep_port(ep));
+    }
+  }
+
+  for(i = 0; i < nhandles; i++){
+    if(dlfree_comm_node_connect_wait(comm, handles[i], &dst_id) != 0)
+      fprintf(stderr, "%d: connect stream fail\n", man -> gxp_idx);
+  }
+  if(nhandles > 0 && man -> gxp_idx == 0){
+    printf("%d: opened %d extra streams\n", man -> gxp_idx, nhandles);fflush(stdout);
+  }
+
+  xml_top_node_vector_destroy(path);
+  xml_topology_destroy(xml_top);
+  std_free(handles);
+
+  gxp_man_sync(man);
+}
+
+/**
+   GXP operation to open virtual lanes on all overlay links. Each lane is a
+   TCP connection of its own, so a chunk blocked on one lane does not hold up
+   the others. Routing tables computed afterwards may then take a hop on a
+   higher lane where the ordered levels would otherwise forbid it, which gives
+   shorter deadlock-free routes.
+   If any lane fails to connect, on any node, routes keep to lane 0 as if
+   nlanes was 1; a lane lost later takes its link down.
+   Must be performed after one of the gxp_man_connect_*() operations and
+   before gxp_man_compute_rt(), with the same nlanes on all nodes.
+   
+   \param man    gxp interface instance
+   \param comm   node communicator instance
+   \param nlanes number of lanes per link (1 opens no extra connections)
+*/
+void
+gxp_man_connect_lanes(gxp_man_t man, dlfree_comm_node_t comm, int nlanes){
+  unsigned long *handles;
+  int idx, lane, i, nhandles = 0, dst_id;
+  int n, nfails = 0, tot_fails = 0;
+  inet_ep_t ep;
+
+  nlanes = Min(nlanes, COMM_MAX_LANES);
+  if(nlanes < 1)
+    nlanes = 1;
+  handles = std_calloc(man -> gxp_num_execs * nlanes, sizeof(unsigned long));
+
+  for(idx = 0; idx < man -> gxp_num_execs; idx++){
+    /* only the side that connected knows the listen endpoint of the peer */
+    if(man -> conn_mat[man -> gxp_idx][idx] == GXP_NO_RTT)
+      continue;
+
+    ep = man -> peer_eps[idx];
+    for(lane = 1; lane < nlanes; lane++){
+      handles[nhandles ++] = dlfree_comm_node_async_connect_lane(comm, idx, lane,
+								 inet_iface_in_addr_str(inet_ep_iface(ep)),
+								 inet_ep_port(ep));
+    }
+  }
+
+  for(i = 0; i < nhandles; i++){
+    if(dlfree_comm_node_connect_wait(comm, handles[i], &dst_id) != 0){
+      fprintf(stderr, "%d: connect lane fail\n", man -> gxp_idx);
+      nfails ++;
+    }
+  }
+  if(nhandles > 0 && man -> gxp_idx == 0){
+    printf("%d: opened %d lanes\n", man -> gxp_idx, nhandles);fflush(stdout);
+  }
+
+  /* routes may only take lanes that every link has, */
+  /* so if any failed to connect, none but lane 0 are used */
+  fprintf(man -> wfp, "%d\n", nfails);
+  fflush(man -> wfp);
+  for(i = 0; i < man -> gxp_num_execs; i++){
+    fscanf(man -> rfp, "%d", &n);
+    tot_fails += n;
+  }
+  if(tot_fails > 0){
+    nlanes = 1;
+    if(man -> gxp_idx == 0){
+      fprintf(stderr, "%d lanes failed to connect, routing without lanes\n", tot_fails);fflush(stderr);
+    }
+  }
+  man -> num_lanes = nlanes;
+
+  std_free(handles);
+}
+
 static void
 gxp_man_conn_stats(gxp_man_t man, const int **conn_mat){
   int src, dst;
@@ -698,6 +874,23 @@ gxp_man_rt_stats(gxp_man_t man, gxp_router_t router, overlay_rtable_t *rts){
   overlay_rtable_vector_destroy(rtable_vec);
 }
 
+/**
+   Let the next gxp_man_compute_rt() give each node up to npaths routes to
+   every destination, which share no link. Chunks of large messages are then
+   striped over them in proportion to their bandwidth. All routes follow the
+   level (and lane) order of the routing type, so they remain deadlock-free.
+   Must be set to the same value on all nodes.
+   
+   \param man    gxp interface instance
+   \param npaths max number of routes per destination (1 for single path routing)
+*/
+void
+gxp_man_set_multipath(gxp_man_t man, int npaths){
+  man -> num_paths = Min(npaths, COMM_MAX_PATHS);
+  if(man -> num_paths < 1)
+    man -> num_paths = 1;
+}
+
 /**
    GXP operation to collectively compute each nodes routing table, and exchange it among all nodes.
    
@@ -731,8 +924,495 @@ gxp_man_compute_rt(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filen
   gxp_man_sync(man);
 }
 
+static int
+xml_top_node_depth(xml_top_node_t node){
+  int depth;
+  for(depth = 0; node -> parent != NULL; node = node -> parent)
+    depth++;
+  return depth;
+}
+
+static xml_top_node_t
+xml_top_node_ancestor(xml_top_node_t node, int depth){
+  int d;
+  for(d = xml_top_node_depth(node); d > depth; d--)
+    node = node -> parent;
+  return node;
+}
+
+/**
+   GXP operation to split the group of all GXP nodes into clusters for the
+   dlfree_coll_hier_*() operations, from the XML topology file.
+   A cluster is a subtree under the highest switch at which the hosts of the job
+   part, e.g. a site for a multi-site job, or a switch for a job within one site.
+   The leader of a cluster is its host nearest the root of the subtree.
+   Nothing is done if the hosts do not part into several clusters of which
+   one has more than one host.
+   Must be performed after gxp_man_compute_rt().
+   
+   \param man          gxp interface instance
+   \param comm         node communicator instance
+   \param xml_filename XML topology filename
+*/
+void
+gxp_man_hier_create(gxp_man_t man, dlfree_comm_node_t comm, const char* xml_filename){
+  xml_topology_t xml_top;
+  xml_topology_parser_t parser = xml_topology_parser_create();
+  int n = man -> gxp_num_execs;
+  xml_top_node_t *hosts = std_malloc(sizeof(xml_top_node_t) * n);
+  xml_top_node_t *tops = std_malloc(sizeof(xml_top_node_t) * n);
+  int *clusters = std_malloc(sizeof(int) * n);
+  int *leaders = std_malloc(sizeof(int) * n);
+  int idx, c, nclusters, depth, d;
+
+  xml_top = xml_topology_parser_run(parser, xml_filename);
+  xml_topology_parser_destroy(parser);
+
+  /* depth of the lowest common ancestor of all hosts */
+  for(idx = 0; idx < n; idx++){
+    hosts[idx] = xml_topology_get_node(xml_top, man -> peer_hostnames[idx]);
+    assert(hosts[idx] != NULL);
+  }
+  depth = xml_top_node_depth(hosts[0]) - 1;
+  for(idx = 1; idx < n; idx++){
+    d = xml_top_node_depth(hosts[idx]) - 1;
+    if(d < depth)
+      depth = d;
+    while(xml_top_node_ancestor(hosts[0], depth) != xml_top_node_ancestor(hosts[idx], depth))
+      depth--;
+  }
+
+  /* clusters are the subtrees just below it */
+  for(nclusters = 0, idx = 0; idx < n; idx++){
+    tops[idx] = xml_top_node_ancestor(hosts[idx], depth + 1);
+    for(c = 0; c < nclusters && tops[leaders[c]] != tops[idx]; c++);
+    if(c == nclusters)
+      leaders[nclusters ++] = idx;
+    else if(xml_top_node_depth(hosts[idx]) < xml_top_node_depth(hosts[leaders[c]]))
+      leaders[c] = idx;
+    clusters[idx] = c;
+  }
+
+  if(nclusters > 1 && nclusters < n){
+    if(dlfree_coll_hier_create(comm, DLFREE_GROUP_ALL, clusters, nclusters, leaders) != 0)
+      fprintf(stderr, "%d: too many clusters (%d) for hierarchical collectives\n", man -> gxp_idx, nclusters);
+    else if(man -> gxp_idx == 0){
+      printf("gxp_man_hier_create: %d clusters\n", nclusters);fflush(stdout);
+    }
+  }
+
+  xml_topology_destroy(xml_top);
+  std_free(hosts);
+  std_free(tops);
+  std_free(clusters);
+  std_free(leaders);
+}
+
+/* answer the round trips and the bandwidth probe of gxp_man_probe() */
+static void
+gxp_man_serve_probe(sock_t sk, char *buff, long probe_len, int iter){
+  int it;
+
+  for(it = 0; it < iter; it++){
+    if(sock_recv_n(sk, buff, 1) != SOCK_RECV_OK || sock_send_n(sk, buff, 1) != SOCK_SEND_OK)
+      return;
+  }
+  if(probe_len > 0 && sock_recv_n(sk, buff, probe_len) == SOCK_RECV_OK)
+    sock_send_n(sk, buff, 1); /* just an ack */
+}
+
+/* RTT [us] as the fastest of iter round trips on sk, and bandwidth [Mbps] */
+/* from one probe_len message, less the RTT already in *rtt */
+static void
+gxp_man_probe_sock(sock_t sk, char *buff, long probe_len, int iter, float *rtt, float *band){
+  struct timeval tv0, tv1;
+  double dt, min_dt = -1.0;
+  int it;
+
+  for(it = 0; it < iter; it++){
+    assert(gettimeofday(&tv0, NULL) == 0);
+    if(sock_send_n(sk, buff, 1) != SOCK_SEND_OK || sock_recv_n(sk, buff, 1) != SOCK_RECV_OK)
+      return;
+    assert(gettimeofday(&tv1, NULL) == 0);
+    dt = timeval_diff(&tv0, &tv1);
+    if(min_dt < 0 || dt < min_dt)
+      min_dt = dt;
+  }
+  if(iter > 0)
+    *rtt = min_dt * 1e6;
+  if(probe_len == 0)
+    return;
+
+  assert(gettimeofday(&tv0, NULL) == 0);
+  if(sock_send_n(sk, buff, probe_len) != SOCK_SEND_OK || sock_recv_n(sk, buff, 1) != SOCK_RECV_OK)
+    return;
+  assert(gettimeofday(&tv1, NULL) == 0);
+  /* the ack takes about one RTT */
+  dt = timeval_diff(&tv0, &tv1);
+  if(*rtt > 0 && dt > 2 * *rtt * 1e-6)
+    dt -= *rtt * 1e-6;
+  *band = probe_len * 8 / dt / 1e6;
+}
+
+/* measure to the node listening at ep, introducing this node as my_idx */
+/* measuring at stage. what could not be measured is negative */
+static void
+gxp_man_probe(inet_ep_t ep, int my_idx, int stage, char *buff, long probe_len, int iter, float *rtt, float *band){
+  sock_t sk = connect_sock_create(inet_iface_in_addr_str(inet_ep_iface(ep)), inet_ep_port(ep));
+  struct timeval timeout = {GXP_PROBE_TIMEOUT, 0};
+  int hello[2] = {my_idx, stage};
+  fd_set writefd;
+
+  if(iter > 0)
+    *rtt = -1.0;
+  if(probe_len > 0)
+    *band = -1.0;
+  sock_set_io_timeout(sk, GXP_PROBE_TIMEOUT);
+  if(sock_connect(sk) == SOCK_CONNECT_OK){
+    FD_ZERO(&writefd);
+    FD_SET(sock_fileno(sk), &writefd);
+    if(std_select(sock_fileno(sk) + 1, NULL, &writefd, NULL, &timeout) > 0 &&
+       sock_connect_status(sk) == SOCK_CONNECT_OK &&
+       sock_send_n(sk, hello, sizeof(hello)) == SOCK_SEND_OK)
+      gxp_man_probe_sock(sk, buff, probe_len, iter, rtt, band);
+  }
+  sock_destroy(sk);
+}
+
+/* serve node peer measuring to this node at stage, unless it does not connect */
+/* in time. late connections of earlier measurements that failed are dropped, */
+/* also those of the same pair, which meets again for the bandwidth */
+static void
+gxp_man_serve(sock_t listen_sk, int peer, int stage, char *buff, long probe_len, int iter){
+  struct timeval timeout;
+  fd_set readfd;
+  sock_t sk;
+  int hello[2];
+
+  while(1){
+    FD_ZERO(&readfd);
+    FD_SET(sock_fileno(listen_sk), &readfd);
+    timeout.tv_sec = GXP_PROBE_TIMEOUT;
+    timeout.tv_usec = 0;
+    if(std_select(sock_fileno(listen_sk) + 1, &readfd, NULL, NULL, &timeout) <= 0)
+      return;
+
+    sk = sock_accept(listen_sk);
+    sock_set_io_timeout(sk, GXP_PROBE_TIMEOUT);
+    if(sock_recv_n(sk, hello, sizeof(hello)) == SOCK_RECV_OK && hello[0] == peer && hello[1] == stage){
+      gxp_man_serve_probe(sk, buff, probe_len, iter);
+      sock_destroy(sk);
+      return;
+    }
+    sock_destroy(sk);
+  }
+}
+
+/* partner of node idx in round r of a round-robin tournament among n nodes, */
+/* -1 if it sits the round out. every pair meets in one of n - 1 + n % 2 rounds */
+static int
+gxp_man_partner(int n, int r, int idx){
+  int m = n + n % 2; /* odd n: partner n is a bye */
+  int p;
+
+  if(idx == m - 1)
+    p = r;
+  else if(idx == r)
+    p = m - 1;
+  else
+    p = ((2 * r - idx) % (m - 1) + (m - 1)) % (m - 1);
+  return p < n ? p : -1;
+}
+
+/* measure with the partner of this node, the lower one of the two connects. */
+/* stage numbers the measurements made, the same on both */
+static void
+gxp_man_measure_partner(gxp_man_t man, sock_t listen_sk, inet_ep_t *eps, int peer, int stage,
+			char *buff, long probe_len, int iter, float **rtt, float **band){
+  int me = man -> gxp_idx;
+
+  if(peer < 0)
+    return;
+  if(me < peer)
+    gxp_man_probe(eps[peer], me, stage, buff, probe_len, iter, &rtt[me][peer], &band[me][peer]);
+  else
+    gxp_man_serve(listen_sk, peer, stage, buff, probe_len, iter);
+}
+
+/* have all nodes know the measurements of all */
+static void
+gxp_man_exchange_matrix(gxp_man_t man, float **rtt, float **band){
+  int i, src, dst;
+  float r, b;
+
+  for(dst = 0; dst < man -> gxp_num_execs; dst++){
+    fprintf(man -> wfp, "%d %d %.3f %.3f\n", man -> gxp_idx, dst,
+	    rtt[man -> gxp_idx][dst], band[man -> gxp_idx][dst]);
+  }
+  fflush(man -> wfp);
+  for(i = 0; i < man -> gxp_num_execs * man -> gxp_num_execs; i++){
+    fscanf(man -> rfp, "%d %d %f %f", &src, &dst, &r, &b);
+    rtt[src][dst] = r;
+    band[src][dst] = b;
+  }
+}
+
+static int
+xml_top_node_cmp(const void *a, const void *b){
+  uintptr_t x = (uintptr_t)*(const xml_top_node_t*)a;
+  uintptr_t y = (uintptr_t)*(const xml_top_node_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static gxp_probe_tree_t
+gxp_probe_tree_create(gxp_man_t man, float **rtt, float **band){
+  gxp_probe_tree_t tree = std_malloc(sizeof(gxp_probe_tree));
+  int i;
+
+  tree -> top = xml_topology_infer((const char**)man -> peer_hostnames, man -> gxp_num_execs, rtt, band);
+  tree -> nnodes = xml_top_node_vector_size(tree -> top -> nodes);
+  tree -> sorted = std_malloc(sizeof(xml_top_node_t) * tree -> nnodes);
+  for(i = 0; i < tree -> nnodes; i++)
+    tree -> sorted[i] = xml_top_node_vector_get(tree -> top -> nodes, i);
+  qsort(tree -> sorted, tree -> nnodes, sizeof(xml_top_node_t), xml_top_node_cmp);
+
+  tree -> hosts = std_malloc(sizeof(xml_top_node_t) * man -> gxp_num_execs);
+  for(i = 0; i < man -> gxp_num_execs; i++)
+    tree -> hosts[i] = xml_topology_get_node(tree -> top, man -> peer_hostnames[i]);
+  tree -> used = std_calloc(tree -> nnodes * 2, sizeof(int));
+  tree -> links = std_malloc(sizeof(int) * tree -> nnodes * 2);
+  tree -> stamp = 0;
+  return tree;
+}
+
+static void
+gxp_probe_tree_destroy(gxp_probe_tree_t tree){
+  xml_topology_destroy(tree -> top);
+  std_free(tree -> sorted);
+  std_free(tree -> hosts);
+  std_free(tree -> used);
+  std_free(tree -> links);
+  std_free(tree);
+}
+
+static int
+gxp_probe_tree_link(gxp_probe_tree_t tree, xml_top_node_t below, int down){
+  xml_top_node_t *p = bsearch(&below, tree -> sorted, tree -> nnodes, sizeof(xml_top_node_t), xml_top_node_cmp);
+  return (p - tree -> sorted) * 2 + down;
+}
+
+/* directed links on the path from host a to host b into tree -> links */
+static int
+gxp_probe_tree_path(gxp_probe_tree_t tree, int a, int b){
+  xml_top_node_t x = tree -> hosts[a], y = tree -> hosts[b];
+  int dx = xml_top_node_depth(x), dy = xml_top_node_depth(y);
+  int nlinks = 0;
+
+  for(; dx > dy; dx--, x = x -> parent)
+    tree -> links[nlinks ++] = gxp_probe_tree_link(tree, x, 0);
+  for(; dy > dx; dy--, y = y -> parent)
+    tree -> links[nlinks ++] = gxp_probe_tree_link(tree, y, 1);
+  for(; x != y; x = x -> parent, y = y -> parent){
+    tree -> links[nlinks ++] = gxp_probe_tree_link(tree, x, 0);
+    tree -> links[nlinks ++] = gxp_probe_tree_link(tree, y, 1);
+  }
+  return nlinks;
+}
+
+/* split the bandwidth probes of round r into turns, such that probes of one */
+/* turn take no directed link of the tree in common. turn[idx] is the turn of */
+/* the probe from node idx. returns the number of turns */
+static int
+gxp_probe_tree_turns(gxp_probe_tree_t tree, int n, int r, int *turn){
+  int idx, peer, i, nlinks, left = 0, nturns = 0;
+
+  for(idx = 0; idx < n; idx++){
+    turn[idx] = -1;
+    if(gxp_man_partner(n, r, idx) > idx)
+      left++;
+  }
+
+  while(left > 0){
+    tree -> stamp++;
+    for(idx = 0; idx < n; idx++){
+      peer = gxp_man_partner(n, r, idx);
+      if(peer < idx || turn[idx] != -1)
+	continue;
+
+      nlinks = gxp_probe_tree_path(tree, idx, peer);
+      for(i = 0; i < nlinks && tree -> used[tree -> links[i]] != tree -> stamp; i++);
+      if(i < nlinks)
+	continue;
+
+      for(i = 0; i < nlinks; i++)
+	tree -> used[tree -> links[i]] = tree -> stamp;
+      turn[idx] = nturns;
+      left--;
+    }
+    nturns++;
+  }
+  return nturns;
+}
+
+/* RTT [us] and bandwidth [Mbps] between all node pairs, in rtt[i][j] and */
+/* band[i][j] for i < j, negative if not measured. the pairs of a round of */
+/* a round-robin tournament are measured at once. for bandwidth, they are */
+/* split further so that no two probes share a link of the tree inferred */
+/* from the RTTs */
+static void
+gxp_man_measure(gxp_man_t man, long probe_len, int iter, float **rtt, float **band){
+  int n = man -> gxp_num_execs, me = man -> gxp_idx;
+  int nrounds = n - 1 + n % 2;
+  inet_ep_t *eps = std_calloc(n, sizeof(inet_ep_t));
+  char *buff = std_calloc(probe_len > 0 ? probe_len : 1, sizeof(char));
+  int *turn = std_malloc(sizeof(int) * n);
+  gxp_probe_tree_t tree;
+  sock_t listen_sk;
+  int i, j, r, t, nturns, peer;
+
+  for(i = 0; i < n; i++)
+    for(j = 0; j < n; j++)
+      rtt[i][j] = band[i][j] = -1.0;
+
+  listen_sk = listen_sock_create(0, n);
+  gxp_man_exchange_ports(man, sock_port(listen_sk), eps);
+
+  /* RTTs, disturbing each other little */
+  for(r = 0; r < nrounds; r++){
+    gxp_man_measure_partner(man, listen_sk, eps, gxp_man_partner(n, r, me), r, buff, 0, iter, rtt, band);
+    gxp_man_sync(man);
+  }
+  gxp_man_exchange_matrix(man, rtt, band);
+
+  /* bandwidths, every node computing the same turns */
+  if(probe_len > 0){
+    tree = gxp_probe_tree_create(man, rtt, band);
+    for(r = 0; r < nrounds; r++){
+      nturns = gxp_probe_tree_turns(tree, n, r, turn);
+      peer = gxp_man_partner(n, r, me);
+      for(t = 0; t < nturns; t++){
+	if(peer >= 0 && turn[me < peer ? me : peer] == t)
+	  gxp_man_measure_partner(man, listen_sk, eps, peer, nrounds + r, buff, probe_len, 0, rtt, band);
+	gxp_man_sync(man);
+      }
+    }
+    gxp_probe_tree_destroy(tree);
+    gxp_man_exchange_matrix(man, rtt, band);
+  }
+
+  sock_destroy(listen_sk);
+  for(i = 0; i < n; i++)
+    if(eps[i] != NULL)
+      inet_ep_destroy(eps[i]);
+  std_free(eps);
+  std_free(buff);
+  std_free(turn);
+}
+
+static float**
+gxp_man_matrix_create(int n){
+  float **m = std_malloc(sizeof(float*) * n);
+  int i;
+  for(i = 0; i < n; i++)
+    m[i] = std_malloc(sizeof(float) * n);
+  return m;
+}
+
+static void
+gxp_man_matrix_destroy(float **m, int n){
+  int i;
+  for(i = 0; i < n; i++)
+    std_free(m[i]);
+  std_free(m);
+}
+
+/**
+   GXP operation to measure RTT and bandwidth between all GXP node pairs,
+   each over a TCP connection of its own, and write them to a matrix file.
+   The pairs of a round of a round-robin tournament are measured at once, so
+   all pairs take N - 1 rounds rather than N^2 sequential measurements.
+   Bandwidth probes of a round are split further into turns whose paths share
+   no link, by the topology inferred from the RTTs.
+   The matrix file may be given wherever an XML topology file is taken, in
+   later runs or to the simulator; the topology is then inferred from it as
+   gxp_man_infer_topology() does.
+   
+   \param man             gxp interface instance
+   \param matrix_filename matrix file to write
+   \param probe_len       size of the bandwidth probe message [B], 0 for RTTs only
+   \param iter            number of round trips per node pair
+*/
+void
+gxp_man_measure_pairs(gxp_man_t man, const char* matrix_filename, long probe_len, int iter){
+  int n = man -> gxp_num_execs;
+  float **rtt = gxp_man_matrix_create(n);
+  float **band = gxp_man_matrix_create(n);
+  char tmpname[1024];
+
+  assert(probe_len >= 0 && iter > 0);
+  if(man -> gxp_idx == 0){
+    printf("gxp_man_measure_pairs: %ld [B] probes\n", probe_len);fflush(stdout);
+  }
+
+  gxp_man_measure(man, probe_len, iter, rtt, band);
+
+  /* the file may be shared, so it is replaced at once rather than written over */
+  snprintf(tmpname, sizeof(tmpname), "%s.%d", matrix_filename, man -> gxp_idx);
+  xml_topology_write_matrix(tmpname, (const char**)man -> peer_hostnames, n, rtt, band);
+  if(rename(tmpname, matrix_filename) != 0)
+    perror("gxp_man_measure_pairs: rename");
+  gxp_man_sync(man);
+
+  gxp_man_matrix_destroy(rtt, n);
+  gxp_man_matrix_destroy(band, n);
+}
+
+/**
+   GXP operation to write an XML topology file from measurements, for clusters
+   nobody has described by hand. Each node pair measures its RTT, the fastest of
+   iter round trips, and its bandwidth from one probe_len message, as in
+   gxp_man_measure_pairs(). Hosts are then grouped into switches by hierarchical
+   clustering of the RTT matrix, and each link is given the widest bandwidth
+   measured across it. The file may be given to any operation that takes an
+   XML topology file, e.g. gxp_man_connect_locality_aware().
+   
+   \param man          gxp interface instance
+   \param xml_filename XML topology file to write
+   \param probe_len    size of the bandwidth probe message [B]
+   \param iter         number of round trips per node pair
+*/
+void
+gxp_man_infer_topology(gxp_man_t man, const char* xml_filename, long probe_len, int iter){
+  int n = man -> gxp_num_execs;
+  float **rtt = gxp_man_matrix_create(n);
+  float **band = gxp_man_matrix_create(n);
+  char tmpname[1024];
+  xml_topology_t xml_top;
+
+  assert(probe_len > 0 && iter > 0);
+  if(man -> gxp_idx == 0){
+    printf("gxp_man_infer_topology: %ld [B] probes\n", probe_len);fflush(stdout);
+  }
+
+  gxp_man_measure(man, probe_len, iter, rtt, band);
+
+  /* every node infers the same tree. the file may be shared, */
+  /* so it is replaced at once rather than written over */
+  xml_top = xml_topology_infer((const char**)man -> peer_hostnames, n, rtt, band);
+  snprintf(tmpname, sizeof(tmpname), "%s.%d", xml_filename, man -> gxp_idx);
+  xml_topology_write(xml_top, tmpname);
+  if(rename(tmpname, xml_filename) != 0)
+    perror("gxp_man_infer_topology: rename");
+  xml_topology_destroy(xml_top);
+  gxp_man_sync(man);
+
+  gxp_man_matrix_destroy(rtt, n);
+  gxp_man_matrix_destroy(band, n);
+}
+
 /**
    GXP operation to collectively measure latency between all GXP node pairs.
+   gxp_man_compute_rt() must have been performed before.
    
    \param man  interface instance
    \param comm node communicator instance
@@ -755,7 +1435,7 @@ gxp_man_ping_pong(gxp_man_t man, dlfree_comm_node_t comm, long len, int iter){
 
   buff = std_calloc(len, sizeof(char));
 
-  gxp_man_sync(man);
+  dlfree_coll_barrier(comm, DLFREE_GROUP_ALL);
 
   for(src_idx = 0; src_idx < man -> gxp_num_execs; src_idx++){
     for(dst_idx = 0; dst_idx < man -> gxp_num_execs; dst_idx++){
@@ -786,7 +1466,7 @@ gxp_man_ping_pong(gxp_man_t man, dlfree_comm_node_t comm, long len, int iter){
 		src_idx, dst_idx, man -> peer_hostnames[src_idx], man -> peer_hostnames[dst_idx],
 		len / min_dt / (1000 * 1000), min_dt * 1000);fflush(stdout);
     }
-    gxp_man_sync(man);
+    dlfree_coll_barrier(comm, DLFREE_GROUP_ALL);
   }
   
   std_free(buff);
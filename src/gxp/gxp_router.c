@@ -68,32 +68,32 @@ gxp_router_run(gxp_router_t router, gxp_man_t gxpman, const int** conn_mat, int
   case GXP_RT_TYPE_UPDOWN_BFS:
     sptrees = router_graph_make_updown_tree(router -> graph,
 					    UPDOWN_ROUTER_BFS, seed);
-    dijk = leveled_dijkstra_create(router -> graph -> hosts, 2); /* levels: up-phase, down-phase */
+    dijk = leveled_dijkstra_create_with_lanes(router -> graph -> hosts, 2, gxpman -> num_lanes); /* levels: up-phase, down-phase */
     break;
   case GXP_RT_TYPE_UPDOWN_DFS:
     sptrees = router_graph_make_updown_tree(router -> graph,
 					    UPDOWN_ROUTER_DFS, seed);
-    dijk = leveled_dijkstra_create(router -> graph -> hosts, 2); /* levels: up-phase, down-phase */
+    dijk = leveled_dijkstra_create_with_lanes(router -> graph -> hosts, 2, gxpman -> num_lanes); /* levels: up-phase, down-phase */
     break;
   case GXP_RT_TYPE_ORDERED_RANDOM:
     sptrees = router_graph_make_spanning_trees(router -> graph, &levels,
 					       ORDERED_LINK_ROUTER_RANDOM, seed);
-    dijk = leveled_dijkstra_create(router -> graph -> hosts, levels);
+    dijk = leveled_dijkstra_create_with_lanes(router -> graph -> hosts, levels, gxpman -> num_lanes);
     break;
   case GXP_RT_TYPE_ORDERED_BAND:
     sptrees = router_graph_make_spanning_trees(router -> graph, &levels,
 					       ORDERED_LINK_ROUTER_BAND, seed);
-    dijk = leveled_dijkstra_create(router -> graph -> hosts, levels);
+    dijk = leveled_dijkstra_create_with_lanes(router -> graph -> hosts, levels, gxpman -> num_lanes);
     break;
   case GXP_RT_TYPE_ORDERED_HOPS:
     sptrees = router_graph_make_spanning_trees(router -> graph, &levels,
 					       ORDERED_LINK_ROUTER_HOPS, seed);
-    dijk = leveled_dijkstra_create(router -> graph -> hosts, levels);
+    dijk = leveled_dijkstra_create_with_lanes(router -> graph -> hosts, levels, gxpman -> num_lanes);
     break;
   case GXP_RT_TYPE_ORDERED_HUB:
     sptrees = router_graph_make_spanning_trees(router -> graph, &levels,
 					       ORDERED_LINK_ROUTER_HUB, seed);
-    dijk = leveled_dijkstra_create(router -> graph -> hosts, levels);
+    dijk = leveled_dijkstra_create_with_lanes(router -> graph -> hosts, levels, gxpman -> num_lanes);
     break;
   case GXP_RT_TYPE_ORDERED_BFS:
     /* first compute shortest path RT */
@@ -131,7 +131,7 @@ gxp_router_run(gxp_router_t router, gxp_man_t gxpman, const int** conn_mat, int
     sptrees = router_graph_make_bfs_spanning_trees(router -> graph, gxpman -> gxp_num_execs,
 					       avgdist_map, &levels, seed);
     std_free(avgdist_map);
-    dijk = leveled_dijkstra_create(router -> graph -> hosts, levels);
+    dijk = leveled_dijkstra_create_with_lanes(router -> graph -> hosts, levels, gxpman -> num_lanes);
     break;
   case GXP_RT_TYPE_DEADLOCK:
     sptrees = router_graph_make_deadlock_prone_links(router -> graph);
@@ -144,7 +144,7 @@ gxp_router_run(gxp_router_t router, gxp_man_t gxpman, const int** conn_mat, int
   }
 
   /* compute routing table */
-  rt = leveled_dijkstra_run(dijk, sptrees, nodes[gxpman -> gxp_idx], seed);
+  rt = leveled_dijkstra_run_multipath(dijk, sptrees, nodes[gxpman -> gxp_idx], seed, gxpman -> num_paths);
 
   /* clean up */
   std_free(nodes);
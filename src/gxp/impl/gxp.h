@@ -5,9 +5,11 @@
 #include <dlfree/gxp.h>
 
 #include <iface/ep.h>
+#include <xml/topology.h>
 
 #define GXP_NO_RTT (-1)
 #define GXP_CLUSTER_NAME_PREFIX (5)
+#define GXP_PROBE_TIMEOUT (10) // seconds to wait for a peer to measure to, or for its answers
 
 enum gxp_connect_status{
   GXP_CONNECT_NO,
@@ -29,11 +31,24 @@ struct gxp_man {
 
   int **conn_mat; /* mat[src_idx][dst_idx] == 1 if connected */
 
+  int num_lanes; /* virtual lanes per link that routing may use */
+  int num_paths; /* max routes per destination */
+
   /* to specify preferrence for endpoint inet address to declare */
   const char **ep_prio_pats;
   int ep_prio_count;
   
 };
 
+/* topology inferred from RTTs, to keep concurrent bandwidth probes apart */
+typedef struct gxp_probe_tree{
+  xml_topology_t top;
+  int nnodes;
+  xml_top_node_t *sorted; /* tree nodes by address, a link is named by the node below it */
+  xml_top_node_t *hosts;  /* [idx] */
+  int *used;  /* [link * 2 + downward] -> last turn that took it */
+  int *links; /* path being looked at */
+  int stamp;
+} gxp_probe_tree, *gxp_probe_tree_t;
 
 #endif // __IMPL_GXP_H__
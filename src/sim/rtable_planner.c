@@ -33,48 +33,43 @@ rtable_planner_destroy(rtable_planner_t planner){
   std_free(planner);
 }
 
-overlay_rtable_t
-rtable_planner_run(rtable_planner_t planner, const overlay_node_t srcnode, int rttype, int seed){
+/* links of the overlay graph with the levels given by rttype */
+router_graph_link_list_t
+rtable_planner_make_links(rtable_planner_t planner, int rttype, int seed, int* levels){
   int i, idx, nnodes;
   float avgdist, *avgdist_map;
-  router_graph_link_t link;
   router_graph_link_list_t sptrees;
   leveled_dijkstra_t dijk;
   overlay_rtable_t rt;
   overlay_rtable_entry_t rt_entry;
-  int levels;
 
   /* make spanning trees */
   switch(rttype){
   case RT_TYPE_UPDOWN_BFS:
     sptrees = router_graph_make_updown_tree(planner -> graph,
 					    UPDOWN_ROUTER_BFS, seed);
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, 2); /* levels: up-phase, down-phase */
+    *levels = 2; /* levels: up-phase, down-phase */
     break;
   case RT_TYPE_UPDOWN_DFS:
     sptrees = router_graph_make_updown_tree(planner -> graph,
 					    UPDOWN_ROUTER_DFS, seed);
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, 2); /* levels: up-phase, down-phase */
+    *levels = 2; /* levels: up-phase, down-phase */
     break;
   case RT_TYPE_ORDERED_RANDOM:
-    sptrees = router_graph_make_spanning_trees(planner -> graph, &levels,
+    sptrees = router_graph_make_spanning_trees(planner -> graph, levels,
 					       ORDERED_LINK_ROUTER_RANDOM, seed);
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, levels);
     break;
   case RT_TYPE_ORDERED_BAND:
-    sptrees = router_graph_make_spanning_trees(planner -> graph, &levels,
+    sptrees = router_graph_make_spanning_trees(planner -> graph, levels,
 					       ORDERED_LINK_ROUTER_BAND, seed);
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, levels);
     break;
   case RT_TYPE_ORDERED_HOPS:
-    sptrees = router_graph_make_spanning_trees(planner -> graph, &levels,
+    sptrees = router_graph_make_spanning_trees(planner -> graph, levels,
 					       ORDERED_LINK_ROUTER_HOPS, seed);
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, levels);
     break;
   case RT_TYPE_ORDERED_HUB:
-    sptrees = router_graph_make_spanning_trees(planner -> graph, &levels,
+    sptrees = router_graph_make_spanning_trees(planner -> graph, levels,
 					       ORDERED_LINK_ROUTER_HUB, seed);
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, levels);
     break;
   case RT_TYPE_ORDERED_BFS:
     nnodes = overlay_node_vector_size(planner -> graph -> hosts);
@@ -87,11 +82,7 @@ rtable_planner_run(rtable_planner_t planner, const overlay_node_t srcnode, int r
       rt = leveled_dijkstra_run(dijk, sptrees, overlay_node_vector_get(planner -> graph -> hosts, idx), seed);
 
       /* clear-up afterwards */
-      while(router_graph_link_list_size(sptrees)){
-	link = router_graph_link_list_popleft(sptrees);
-	router_graph_link_destroy(link);
-      }
-      router_graph_link_list_destroy(sptrees);
+      rtable_planner_destroy_links(sptrees);
       leveled_dijkstra_destroy(dijk);
       
       /* calculate avg. dist to all nodes from RT */
@@ -107,29 +98,44 @@ rtable_planner_run(rtable_planner_t planner, const overlay_node_t srcnode, int r
     }
 
     sptrees = router_graph_make_bfs_spanning_trees(planner -> graph, nnodes,
-					       avgdist_map, &levels, seed);
+					       avgdist_map, levels, seed);
     std_free(avgdist_map);
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, levels);
     break;
   case RT_TYPE_DEADLOCK:
     sptrees = router_graph_make_deadlock_prone_links(planner -> graph);
     /* deadlocking, so only 1 level for graph */
-    dijk = leveled_dijkstra_create(planner -> graph -> hosts, 1);
+    *levels = 1;
     break;
   default:
     fprintf(stderr, "unknown ROUTING_TYPE: %d\n", rttype);
     exit(1);
   }
 
+  return sptrees;
+}
+
+void
+rtable_planner_destroy_links(router_graph_link_list_t links){
+  while(router_graph_link_list_size(links))
+    router_graph_link_destroy(router_graph_link_list_popleft(links));
+  router_graph_link_list_destroy(links);
+}
+
+overlay_rtable_t
+rtable_planner_run(rtable_planner_t planner, const overlay_node_t srcnode, int rttype, int seed){
+  router_graph_link_list_t sptrees;
+  leveled_dijkstra_t dijk;
+  overlay_rtable_t rt;
+  int levels;
+
+  sptrees = rtable_planner_make_links(planner, rttype, seed, &levels);
+  dijk = leveled_dijkstra_create(planner -> graph -> hosts, levels);
+
   /* compute routing table */
   rt = leveled_dijkstra_run(dijk, sptrees, srcnode, seed);
 
   /* clean up */
-  while(router_graph_link_list_size(sptrees)){
-    link = router_graph_link_list_popleft(sptrees);
-    router_graph_link_destroy(link);
-  }
-  router_graph_link_list_destroy(sptrees);
+  rtable_planner_destroy_links(sptrees);
   leveled_dijkstra_destroy(dijk);
 
   return rt;
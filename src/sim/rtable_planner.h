@@ -2,6 +2,7 @@
 #define __RTABLE_PLANNER_H__
 #include <xml/topology.h>
 #include <graph/overlay.h>
+#include <graph/router.h>
 #include <struct/rtable.h>
 
 enum rtable_planner_rt_types {
@@ -22,6 +23,8 @@ typedef struct rtable_planner{
 
 rtable_planner_t rtable_planner_create(const char* filename, int seed);
 void rtable_planner_destroy(rtable_planner_t planner);
+router_graph_link_list_t rtable_planner_make_links(rtable_planner_t planner, int rttype, int seed, int* levels);
+void rtable_planner_destroy_links(router_graph_link_list_t links);
 overlay_rtable_t rtable_planner_run(rtable_planner_t planner, const overlay_node_t srcnode, int rttype, int seed);
 
 #endif // __RTABLE_PLANNER_H__
@@ -3,6 +3,8 @@
 #include <std/std.h>
 #include <struct/rtable.h>
 #include <graph/overlay.h>
+#include <graph/router.h>
+#include <graph/dijkstra.h>
 #include "sim/rtable_stat.h"
 #include "sim/rtable_sim.h"
 
@@ -63,9 +65,11 @@ rtable_simulator_run(rtable_simulator_t sim, int overlaytype, float param, int r
 overlay_rtable_vector_t
 rtable_simulator_run2(rtable_simulator_t sim, float density, int rttype, int seed){
   int i, j, nnodes;
-  overlay_node_t srcnode;
   overlay_rtable_t rtable;
-  overlay_rtable_vector_t rtable_vec = overlay_rtable_vector_create(1);
+  overlay_rtable_vector_t rtable_vec;
+  router_graph_link_list_t links;
+  leveled_dijkstra_t dijk;
+  int levels, new_levels;
   int **conn_req;
   int conns;
 
@@ -75,16 +79,14 @@ rtable_simulator_run2(rtable_simulator_t sim, float density, int rttype, int see
 /*   printf("simulator_run2: simulating overlay graph: ring\n"); */
 /*   overlay_graph_simulate_ring(sim -> planner -> graph, sim -> planner -> xml_top); */
 
-  while(1){
-    /* calculate rtable for each srcnode */
-    nnodes = overlay_node_vector_size(sim -> planner -> graph -> hosts);
-    for(i = 0; i < nnodes; i++){
-      srcnode = overlay_node_vector_get(sim -> planner -> graph -> hosts, i);
-      /* printf("simulator_run: computing routing table for: %s\n", srcnode -> name); */
-      rtable = rtable_planner_run(sim -> planner, srcnode, rttype, seed);
-      overlay_rtable_vector_add(rtable_vec, rtable);
-    }
+  /* calculate rtable for each srcnode, keeping the search trees */
+  nnodes = overlay_node_vector_size(sim -> planner -> graph -> hosts);
+  links = rtable_planner_make_links(sim -> planner, rttype, seed, &levels);
+  dijk = leveled_dijkstra_create(sim -> planner -> graph -> hosts, levels);
+  rtable_vec = leveled_dijkstra_run_all(dijk, links, seed);
+  rtable_planner_destroy_links(links);
 
+  while(1){
     /* assess bandwidth */
     overlay_rtable_stats_print_band_histo(rtable_vec, nnodes, sim -> planner -> xml_top, sim -> planner -> graph, 10);
     conn_req = overlay_rtable_stats_calc_band(rtable_vec, nnodes, sim -> planner -> xml_top, sim -> planner -> graph);
@@ -111,7 +113,23 @@ rtable_simulator_run2(rtable_simulator_t sim, float density, int rttype, int see
       rtable = overlay_rtable_vector_pop(rtable_vec);
       overlay_rtable_destroy(rtable);
     }
+    overlay_rtable_vector_destroy(rtable_vec);
+
+    /* repair the trees for the new links, or search again if the */
+    /* number of levels changed */
+    links = rtable_planner_make_links(sim -> planner, rttype, seed, &new_levels);
+    if(new_levels == levels){
+      printf("updated %d directed links\n", leveled_dijkstra_update(dijk, links));
+      rtable_vec = leveled_dijkstra_calc_all(dijk);
+    }else{
+      leveled_dijkstra_destroy(dijk);
+      levels = new_levels;
+      dijk = leveled_dijkstra_create(sim -> planner -> graph -> hosts, levels);
+      rtable_vec = leveled_dijkstra_run_all(dijk, links, seed);
+    }
+    rtable_planner_destroy_links(links);
   }
+  leveled_dijkstra_destroy(dijk);
 
   /* calculate statistics on hops */
   overlay_rtable_stats_calc_hops(rtable_vec, nnodes);
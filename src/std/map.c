@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <assert.h>
 #include "std.h"
 #include "map.h"
 
@@ -162,3 +163,112 @@ void hash_map_print(hash_map_t hash, void (*func)(const void*) ){
   }
   printf("}\n");
 }
+
+/*****************************/
+/*   Open-addressing Hash Map */
+/*****************************/
+
+open_map_t open_map_create(long size){
+  open_map_t map = (open_map_t) std_malloc(sizeof(open_map));
+  long n = 8;
+  while(n < size)
+    n <<= 1;
+  map -> cells = (open_map_cell_t) std_calloc(n, sizeof(open_map_cell));
+  map -> size = n;
+  map -> c = 0;
+  return map;
+}
+
+void open_map_destroy(open_map_t map){
+  std_free(map -> cells);
+  std_free(map);
+}
+
+long open_map_size(open_map_t map){
+  return map -> c;
+}
+
+/* fibonacci hashing, spreads keys that differ only in high bits (e.g. sids) */
+static long open_map_hash(open_map_t map, unsigned long key){
+  return (long)((key * 0x9E3779B97F4A7C15UL) >> 32) & (map -> size - 1);
+}
+
+static void open_map_insert(open_map_t map, unsigned long key, void *data){
+  long h = open_map_hash(map, key);
+  while(map -> cells[h].data != NULL)
+    h = (h + 1) & (map -> size - 1);
+  map -> cells[h].key = key;
+  map -> cells[h].data = data;
+}
+
+static void open_map_grow(open_map_t map){
+  open_map_cell_t old = map -> cells;
+  long h, oldsize = map -> size;
+
+  map -> size <<= 1;
+  map -> cells = (open_map_cell_t) std_calloc(map -> size, sizeof(open_map_cell));
+  for(h = 0; h < oldsize; h++){
+    if(old[h].data != NULL)
+      open_map_insert(map, old[h].key, old[h].data);
+  }
+  std_free(old);
+}
+
+void open_map_add(open_map_t map, unsigned long key, void *data){
+  assert(data != NULL);
+  /* keep load factor below 1/2 so that probe sequences stay short */
+  if((map -> c + 1) * 2 > map -> size)
+    open_map_grow(map);
+  open_map_insert(map, key, data);
+  map -> c++;
+}
+
+void* open_map_find(open_map_t map, unsigned long key){
+  long h = open_map_hash(map, key);
+  while(map -> cells[h].data != NULL){
+    if(map -> cells[h].key == key) /* match */
+      return map -> cells[h].data;
+    h = (h + 1) & (map -> size - 1);
+  }
+  return NULL; /* not found */
+}
+
+void* open_map_pop(open_map_t map, unsigned long key){
+  long mask = map -> size - 1;
+  long h = open_map_hash(map, key);
+  long i, home;
+  void* data;
+
+  while(map -> cells[h].data != NULL && map -> cells[h].key != key)
+    h = (h + 1) & mask;
+  if((data = map -> cells[h].data) == NULL)
+    return NULL; /* not found */
+
+  /* backward-shift deletion: move up later cells of the same probe run, */
+  /* so that no tombstones are needed */
+  for(i = (h + 1) & mask; map -> cells[i].data != NULL; i = (i + 1) & mask){
+    home = open_map_hash(map, map -> cells[i].key);
+    /* cell i can fill hole h only if its home is not in (h, i] */
+    if(((i - home) & mask) >= ((i - h) & mask)){
+      map -> cells[h] = map -> cells[i];
+      h = i;
+    }
+  }
+  map -> cells[h].data = NULL;
+  map -> c--;
+
+  return data;
+}
+
+void open_map_print(open_map_t map, void (*func)(const void*) ){
+  long h;
+  printf("OpenMap(%ld) {", map -> c);
+  for(h = 0; h < map -> size; h++){
+    if(map -> cells[h].data != NULL){
+      printf("%ld : ", map -> cells[h].key);
+      func(map -> cells[h].data);
+      printf(", ");
+    }
+  }
+  printf("}\n");
+}
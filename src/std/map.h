@@ -71,4 +71,58 @@ void TYPE ## _hash_map_print(TYPE ## _hash_map_t hash, void (*func)(const TYPE #
   hash_map_print((hash_map_t)hash, (void (*)(const void*))func); \
 }
 
+/* open-addressing hash map with linear probing, grows by doubling. */
+/* keys are unique, and data must not be NULL (NULL marks an empty slot) */
+typedef struct open_map_cell {
+  unsigned long key;
+  void* data;
+} open_map_cell, *open_map_cell_t;
+
+typedef struct open_map{
+  open_map_cell_t cells;
+  long size; /* number of slots, power of 2 */
+  long c;
+} open_map, *open_map_t;
+
+open_map_t open_map_create(long size);
+void open_map_destroy(open_map_t map);
+long open_map_size(open_map_t map);
+void open_map_add(open_map_t map, unsigned long key, void *data);
+void* open_map_pop(open_map_t map, unsigned long key);
+void* open_map_find(open_map_t map, unsigned long key);
+void open_map_print(open_map_t map, void (*func)(const void*) );
+
+#define OPENMAP_MAKE_TYPE_INTERFACE(TYPE) \
+typedef open_map_t TYPE ## _open_map_t; \
+TYPE ## _open_map_t TYPE ## _open_map_create(long size); \
+void TYPE ## _open_map_destroy(TYPE ## _open_map_t map); \
+long TYPE ## _open_map_size(TYPE ## _open_map_t map); \
+void TYPE ## _open_map_add(TYPE ## _open_map_t map, unsigned long key, TYPE ## _t data); \
+TYPE ## _t TYPE ## _open_map_pop(TYPE ## _open_map_t map, unsigned long key); \
+TYPE ## _t TYPE ## _open_map_find(TYPE ## _open_map_t map, unsigned long key); \
+void TYPE ## _open_map_print(TYPE ## _open_map_t map, void (*func)(const TYPE ## _t) );
+
+#define OPENMAP_MAKE_TYPE_IMPLEMENTATION(TYPE) \
+TYPE ## _open_map_t TYPE ## _open_map_create(long size){ \
+  return (TYPE ## _open_map_t)open_map_create(size); \
+} \
+void TYPE ## _open_map_destroy(TYPE ## _open_map_t map){ \
+  open_map_destroy((open_map_t)map); \
+} \
+long TYPE ## _open_map_size(TYPE ## _open_map_t map){ \
+  return open_map_size((open_map_t)map); \
+} \
+void TYPE ## _open_map_add(TYPE ## _open_map_t map, unsigned long key, TYPE ## _t data){ \
+  open_map_add((open_map_t)map, key, (void*)data); \
+} \
+TYPE ## _t TYPE ## _open_map_pop(TYPE ## _open_map_t map, unsigned long key){ \
+  return (TYPE ## _t)open_map_pop((open_map_t)map, key); \
+} \
+TYPE ## _t TYPE ## _open_map_find(TYPE ## _open_map_t map, unsigned long key){ \
+  return (TYPE ## _t)open_map_find((open_map_t)map, key); \
+} \
+void TYPE ## _open_map_print(TYPE ## _open_map_t map, void (*func)(const TYPE ## _t) ){ \
+  open_map_print((open_map_t)map, (void (*)(const void*))func); \
+}
+
 #endif // __MAP_H__
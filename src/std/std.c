@@ -361,6 +361,18 @@ std_pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex){
   }
 }
 
+/* returns ETIMEDOUT if abstime passed */
+int
+std_pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime){
+  int ret = pthread_cond_timedwait(cond, mutex, abstime);
+  if(ret != 0 && ret != ETIMEDOUT){
+    errno = ret;
+    perror("pthread_cond_timedwait");
+    exit(1);
+  }
+  return ret;
+}
+
 void
 std_pthread_cond_broadcast(pthread_cond_t *cond){
   if(pthread_cond_broadcast(cond)){
@@ -369,6 +381,30 @@ std_pthread_cond_broadcast(pthread_cond_t *cond){
   }
 }
 
+void
+std_pthread_key_create(pthread_key_t *key, void (*destructor)(void*)){
+  if(pthread_key_create(key, destructor)){
+    perror("pthread_key_create");
+    exit(1);
+  }
+}
+
+void
+std_pthread_key_delete(pthread_key_t key){
+  if(pthread_key_delete(key)){
+    perror("pthread_key_delete");
+    exit(1);
+  }
+}
+
+void
+std_pthread_setspecific(pthread_key_t key, const void *value){
+  if(pthread_setspecific(key, value)){
+    perror("pthread_setspecific");
+    exit(1);
+  }
+}
+
 
 void
 std_getsockname(int s, struct sockaddr *name, socklen_t *namelen){
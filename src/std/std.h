@@ -52,8 +52,13 @@ void std_pthread_mutex_unlock(pthread_mutex_t *mutex);
 void std_pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
 void std_pthread_cond_destroy(pthread_cond_t *cond);
 void std_pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int std_pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime);
 void std_pthread_cond_broadcast(pthread_cond_t *cond);
 
+void std_pthread_key_create(pthread_key_t *key, void (*destructor)(void*));
+void std_pthread_key_delete(pthread_key_t key);
+void std_pthread_setspecific(pthread_key_t key, const void *value);
+
 void std_getsockname(int s, struct sockaddr *name, socklen_t *namelen);
 void std_inet_aton(const char* dst_addr, struct in_addr *inp); // DEPRECATED
 char* std_inet_ntoa(struct in_addr in); // DEPRECATED
@@ -16,13 +16,49 @@ overlay_rtable_entry_create(int dst_pid, int *path, int hops, int metric, int wi
   entry -> width = width;
   entry -> path = (int*)std_malloc(sizeof(int) * (hops + 1));
   std_memcpy(entry -> path, path, sizeof(int) * (hops + 1));
+  entry -> lanes = (int*)std_calloc(hops + 1, sizeof(int)); /* all on lane 0 */
+  entry -> alt = NULL;
   
   return entry;
 }
 
+void
+overlay_rtable_entry_set_lanes(overlay_rtable_entry_t entry, const int *lanes){
+  std_memcpy(entry -> lanes, lanes, sizeof(int) * entry -> hops);
+}
+
+/* append a further route to the same destination */
+void
+overlay_rtable_entry_add_alt(overlay_rtable_entry_t entry, overlay_rtable_entry_t alt){
+  assert(alt -> dst_pid == entry -> dst_pid);
+  while(entry -> alt != NULL)
+    entry = entry -> alt;
+  entry -> alt = alt;
+}
+
+int
+overlay_rtable_entry_npaths(overlay_rtable_entry_t entry){
+  int n;
+  for(n = 0; entry != NULL; entry = entry -> alt)
+    n ++;
+  return n;
+}
+
+/* route number 'path' to the destination, the first one if there are not that many */
+overlay_rtable_entry_t
+overlay_rtable_entry_get_path(overlay_rtable_entry_t entry, int path){
+  overlay_rtable_entry_t e = entry;
+  while(path -- > 0 && e != NULL)
+    e = e -> alt;
+  return e != NULL ? e : entry;
+}
+
 void
 overlay_rtable_entry_destroy(overlay_rtable_entry_t entry){
+  if(entry -> alt != NULL)
+    overlay_rtable_entry_destroy(entry -> alt);
   std_free(entry -> path);
+  std_free(entry -> lanes);
   std_free(entry);
 }
 
@@ -35,6 +71,11 @@ overlay_rtable_entry_pack(overlay_rtable_entry_t entry, void**pp){
   pack_int(pp, entry -> width);
   for(i = 0; i < entry -> hops + 1; i++)
     pack_int(pp, entry -> path[i]);
+  for(i = 0; i < entry -> hops; i++)
+    pack_int(pp, entry -> lanes[i]);
+  pack_int(pp, entry -> alt != NULL);
+  if(entry -> alt != NULL)
+    overlay_rtable_entry_pack(entry -> alt, pp);
 }
 
 int
@@ -45,6 +86,10 @@ overlay_rtable_entry_pack_len(overlay_rtable_entry_t entry){
   c += sizeof(int); /* metric */
   c += sizeof(int); /* width */
   c += (sizeof(int) * (entry -> hops + 1)); /* path */
+  c += (sizeof(int) * entry -> hops); /* lanes */
+  c += sizeof(int); /* has alt */
+  if(entry -> alt != NULL)
+    c += overlay_rtable_entry_pack_len(entry -> alt);
   return c;
 }
 
@@ -60,6 +105,10 @@ overlay_rtable_entry_create_by_unpack(const void**pp){
   for(i = 0; i < hops + 1; i++)
     path[i] = unpack_int(pp);
   entry = overlay_rtable_entry_create(dst_pid, path, hops, metric, width);
+  for(i = 0; i < hops; i++)
+    entry -> lanes[i] = unpack_int(pp);
+  if(unpack_int(pp))
+    entry -> alt = overlay_rtable_entry_create_by_unpack(pp);
   std_free(path);
   return entry;
 }
@@ -73,6 +122,10 @@ overlay_rtable_entry_print(overlay_rtable_entry_t entry){
     printf("%d, ", entry -> path[i]);
   }
   printf("])");
+  if(entry -> alt != NULL){
+    printf(" ");
+    overlay_rtable_entry_print(entry -> alt);
+  }
 }
 
 void
@@ -84,6 +137,10 @@ overlay_rtable_entry_print_with_name(overlay_rtable_entry_t entry, const char**
     printf("%s, ", hostnames[entry -> path[i]]);
   }
   printf("])");
+  if(entry -> alt != NULL){
+    printf(" ");
+    overlay_rtable_entry_print_with_name(entry -> alt, hostnames);
+  }
 }
 
 overlay_rtable_t
@@ -96,6 +153,8 @@ overlay_rtable_create(int srcpid, int nentry){
   for(pid = 0; pid < nentry; pid++){
     rt -> entries[pid] = NULL;
   }
+  rt -> old_entries = NULL;
+  rt -> nold = 0;
   return rt;
 }
 
@@ -110,6 +169,10 @@ overlay_rtable_destroy(overlay_rtable_t rt){
     }
   }
   std_free(rt -> entries);
+  for(pid = 0; pid < rt -> nold; pid++)
+    std_free(rt -> old_entries[pid]);
+  if(rt -> old_entries != NULL)
+    std_free(rt -> old_entries);
   std_free(rt);
 }
 
@@ -118,6 +181,26 @@ overlay_rtable_size(overlay_rtable_t rt){
   return rt -> nentry;
 }
 
+/* make room for destinations up to nentry - 1, for a node that joined. */
+/* the old array is kept until the table is destroyed, since lookups do not lock */
+void
+overlay_rtable_grow(overlay_rtable_t rt, int nentry){
+  overlay_rtable_entry_t* entries;
+  int pid;
+
+  if(nentry <= rt -> nentry)
+    return;
+  entries = (overlay_rtable_entry_t*) std_malloc(sizeof(overlay_rtable_entry_t) * nentry);
+  for(pid = 0; pid < nentry; pid++)
+    entries[pid] = pid < rt -> nentry ? rt -> entries[pid] : NULL;
+
+  rt -> old_entries = std_realloc(rt -> old_entries, sizeof(overlay_rtable_entry_t*) * (rt -> nold + 1));
+  rt -> old_entries[rt -> nold ++] = rt -> entries;
+  rt -> entries = entries;
+  __sync_synchronize();
+  rt -> nentry = nentry;
+}
+
 void
 overlay_rtable_add_entry(overlay_rtable_t rt, overlay_rtable_entry_t entry){
   assert(rt -> entries[entry -> dst_pid] == NULL);
@@ -7,25 +7,35 @@
 typedef struct overlay_rtable_entry {
   int dst_pid;
   int* path;
+  int* lanes; /* [i] -> virtual lane of the hop path[i] -> path[i+1] */
   int hops;
   int metric;
   int width;
+  struct overlay_rtable_entry* alt; /* next route to the same destination, NULL if none */
 } overlay_rtable_entry, *overlay_rtable_entry_t;
 
 typedef struct overlay_rtable {
   int srcpid;
   int nentry;
   overlay_rtable_entry_t* entries;
+  overlay_rtable_entry_t** old_entries; /* arrays replaced by overlay_rtable_grow() */
+  int nold;
 } overlay_rtable, *overlay_rtable_t;
 
 VECTOR_MAKE_TYPE_INTERFACE(overlay_rtable)
 
 overlay_rtable_entry_t overlay_rtable_entry_create(int dst_pid, int *path, int hops, int metric, int width);
+void overlay_rtable_entry_destroy(overlay_rtable_entry_t entry);
+void overlay_rtable_entry_set_lanes(overlay_rtable_entry_t entry, const int *lanes);
+void overlay_rtable_entry_add_alt(overlay_rtable_entry_t entry, overlay_rtable_entry_t alt);
+int overlay_rtable_entry_npaths(overlay_rtable_entry_t entry);
+overlay_rtable_entry_t overlay_rtable_entry_get_path(overlay_rtable_entry_t entry, int path);
 void overlay_rtable_entry_print_with_name(overlay_rtable_entry_t entry, const char** hostnames);
 
 overlay_rtable_t overlay_rtable_create(int srcpid, int nentry);
 void overlay_rtable_destroy(overlay_rtable_t rt);
 int overlay_rtable_size(overlay_rtable_t rt);
+void overlay_rtable_grow(overlay_rtable_t rt, int nentry);
 void overlay_rtable_add_entry(overlay_rtable_t rt, overlay_rtable_entry_t entry);
 overlay_rtable_entry_t overlay_rtable_get_entry(overlay_rtable_t rt, int pid);
 void overlay_rtable_print(overlay_rtable_t rt);
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <std/std.h>
+#include "xml/parser.h"
+#include "xml/infer.h"
+
+/* dendrogram of the hosts: nodes [0, n) are the hosts, */
+/* node n + k is merge k of left[k] and right[k] at RTT height[k] */
+typedef struct xml_infer{
+  xml_topology_t top;
+  const char** hostnames;
+  int n;
+  float** band;
+  float max_band;
+
+  int* left;
+  int* right;
+  float* height;
+
+  char* below; /* [host] under the dendrogram node looked at */
+  int switch_id;
+} xml_infer, *xml_infer_t;
+
+/* mean of the RTTs measured both ways, max if neither was */
+static float
+infer_rtt(float** rtt, int i, int j, float max){
+  if(rtt[i][j] >= 0 && rtt[j][i] >= 0)
+    return (rtt[i][j] + rtt[j][i]) / 2;
+  if(rtt[i][j] >= 0)
+    return rtt[i][j];
+  if(rtt[j][i] >= 0)
+    return rtt[j][i];
+  return max;
+}
+
+/* average linkage clustering of the RTT matrix */
+static void
+infer_cluster(xml_infer_t inf, float** rtt){
+  int n = inf -> n;
+  float** d = (float**) std_malloc(sizeof(float*) * n);
+  int* id = (int*) std_malloc(sizeof(int) * n);
+  int* size = (int*) std_malloc(sizeof(int) * n);
+  char* alive = (char*) std_malloc(n);
+  float max = 0.0;
+  int i, j, k, m, mi, mj;
+
+  for(i = 0; i < n; i++)
+    for(j = 0; j < n; j++)
+      if(i != j && rtt[i][j] > max)
+	max = rtt[i][j];
+
+  for(i = 0; i < n; i++){
+    d[i] = (float*) std_malloc(sizeof(float) * n);
+    for(j = 0; j < n; j++)
+      d[i][j] = i == j ? 0.0 : infer_rtt(rtt, i, j, max);
+    id[i] = i;
+    size[i] = 1;
+    alive[i] = 1;
+  }
+
+  for(k = 0; k < n - 1; k++){
+    /* closest pair of clusters left */
+    mi = mj = -1;
+    for(i = 0; i < n; i++){
+      if(!alive[i])
+	continue;
+      for(j = i + 1; j < n; j++)
+	if(alive[j] && (mi == -1 || d[i][j] < d[mi][mj])){
+	  mi = i; mj = j;
+	}
+    }
+
+    inf -> left[k] = id[mi];
+    inf -> right[k] = id[mj];
+    inf -> height[k] = d[mi][mj];
+
+    /* mi becomes the merged cluster */
+    for(m = 0; m < n; m++){
+      if(!alive[m] || m == mi || m == mj)
+	continue;
+      d[mi][m] = d[m][mi] = (size[mi] * d[mi][m] + size[mj] * d[mj][m]) / (size[mi] + size[mj]);
+    }
+    size[mi] += size[mj];
+    alive[mj] = 0;
+    id[mi] = n + k;
+  }
+
+  for(i = 0; i < n; i++)
+    std_free(d[i]);
+  std_free(d);
+  std_free(id);
+  std_free(size);
+  std_free(alive);
+}
+
+static void
+infer_mark_below(xml_infer_t inf, int c){
+  if(c < inf -> n){
+    inf -> below[c] = 1;
+    return;
+  }
+  infer_mark_below(inf, inf -> left[c - inf -> n]);
+  infer_mark_below(inf, inf -> right[c - inf -> n]);
+}
+
+/* widest bandwidth measured between hosts under dendrogram node c and */
+/* the others, a lower bound on the width of the link above c. */
+/* links nothing was measured across are taken to be no bottleneck */
+static float
+infer_width(xml_infer_t inf, int c){
+  float width = -1.0;
+  int i, j;
+
+  memset(inf -> below, 0, inf -> n);
+  infer_mark_below(inf, c);
+  for(i = 0; i < inf -> n; i++){
+    if(!inf -> below[i])
+      continue;
+    for(j = 0; j < inf -> n; j++){
+      if(inf -> below[j])
+	continue;
+      if(inf -> band[i][j] > width)
+	width = inf -> band[i][j];
+      if(inf -> band[j][i] > width)
+	width = inf -> band[j][i];
+    }
+  }
+  return width > 0 ? width : inf -> max_band;
+}
+
+/* hang dendrogram node c under switch sw, which merges hosts at RTT h. */
+/* merges not much lower than h are part of sw rather than switches below it */
+static void
+infer_add(xml_infer_t inf, xml_top_node_t sw, float h, int c){
+  char nodename[20];
+  xml_top_node_t child;
+  int k = c - inf -> n;
+
+  if(c < inf -> n){
+    xml_topology_add_edge(inf -> top, sw, inf -> hostnames[c], 1.0f, infer_width(inf, c));
+    return;
+  }
+
+  if(h <= inf -> height[k] * XML_TOPOLOGY_INFER_RATIO){
+    infer_add(inf, sw, h, inf -> left[k]);
+    infer_add(inf, sw, h, inf -> right[k]);
+    return;
+  }
+
+  sprintf(nodename, "%s:%d", XML_SWITCH_NAME_PREFIX, inf -> switch_id ++);
+  child = xml_topology_add_edge(inf -> top, sw, nodename, 1.0f, infer_width(inf, c));
+  infer_add(inf, child, inf -> height[k], inf -> left[k]);
+  infer_add(inf, child, inf -> height[k], inf -> right[k]);
+}
+
+/* topology tree of n hosts from their RTTs (rtt[i][j], negative if not measured), */
+/* like one parsed from a hand-written XML file. hosts are grouped into switches */
+/* by hierarchical clustering of the RTTs, and each link is as wide as the widest */
+/* bandwidth measured across it (band[i][j] in Mbps, negative if not measured) */
+xml_topology_t
+xml_topology_infer(const char** hostnames, int n, float** rtt, float** band){
+  xml_infer inf;
+  xml_top_node_t root, sw;
+  char nodename[20];
+  int i, j;
+
+  assert(n > 0);
+  inf.top = xml_topology_create();
+  inf.hostnames = hostnames;
+  inf.n = n;
+  inf.band = band;
+  inf.max_band = -1.0;
+  for(i = 0; i < n; i++)
+    for(j = 0; j < n; j++)
+      if(band[i][j] > inf.max_band)
+	inf.max_band = band[i][j];
+
+  inf.left = (int*) std_malloc(sizeof(int) * n);
+  inf.right = (int*) std_malloc(sizeof(int) * n);
+  inf.height = (float*) std_malloc(sizeof(float) * n);
+  inf.below = (char*) std_malloc(n);
+  inf.switch_id = 0;
+
+  infer_cluster(&inf, rtt);
+
+  /* same shape as the parser makes: root, then the top switch */
+  root = xml_topology_add_node(inf.top, XML_ROOT_NAME_PREFIX, NULL);
+  sprintf(nodename, "%s:%d", XML_SWITCH_NAME_PREFIX, inf.switch_id ++);
+  sw = xml_topology_add_edge(inf.top, root, nodename, 1.0f, -1.0f);
+  if(n == 1)
+    infer_add(&inf, sw, 0.0, 0);
+  else
+    infer_add(&inf, sw, inf.height[n - 2], 2 * n - 2);
+
+  std_free(inf.left);
+  std_free(inf.right);
+  std_free(inf.height);
+  std_free(inf.below);
+  return inf.top;
+}
+
+static void
+write_node(FILE* fp, xml_top_node_t node, float width, int depth){
+  xml_top_edge_t edge;
+  xml_top_node_t child;
+  int i;
+
+  fprintf(fp, "%*s", 2 * depth, "");
+  if(node -> parent == NULL)
+    fprintf(fp, "<%s>\n", XML_CLUSTER_ELEMENT);
+  else if(strncmp(node -> name, XML_SWITCH_NAME_PREFIX, strlen(XML_SWITCH_NAME_PREFIX)) == 0)
+    fprintf(fp, "<%s bandwidth=\"%.1f\">\n", XML_SWITCH_ELEMENT, width);
+  else{
+    fprintf(fp, "<%s bandwidth=\"%.1f\" hostname=\"%s\" />\n", XML_NODE_ELEMENT, width, node -> name);
+    return;
+  }
+
+  for(i = 0; i < xml_top_edge_vector_size(node -> edges); i++){
+    edge = xml_top_edge_vector_get(node -> edges, i);
+    child = edge -> n0 == node ? edge -> n1 : edge -> n0;
+    if(child != node -> parent)
+      write_node(fp, child, edge -> width, depth + 1);
+  }
+
+  fprintf(fp, "%*s", 2 * depth, "");
+  fprintf(fp, "</%s>\n", node -> parent == NULL ? XML_CLUSTER_ELEMENT : XML_SWITCH_ELEMENT);
+}
+
+/* write top in the format xml_topology_parser_run() reads */
+void
+xml_topology_write(xml_topology_t top, const char* filename){
+  FILE *fp = std_fopen(filename, "w");
+
+  assert(xml_top_node_vector_size(top -> nodes) > 0);
+  write_node(fp, xml_top_node_vector_get(top -> nodes, 0), -1.0, 0);
+  fclose(fp);
+}
+
+/* matrix file: the number of hosts, a line "idx hostname" per host, */
+/* then a line "src dst rtt band" per measured pair */
+void
+xml_topology_write_matrix(const char* filename, const char** hostnames, int n, float** rtt, float** band){
+  FILE *fp = std_fopen(filename, "w");
+  int i, j;
+
+  fprintf(fp, "%d\n", n);
+  for(i = 0; i < n; i++)
+    fprintf(fp, "%d %s\n", i, hostnames[i]);
+  for(i = 0; i < n; i++)
+    for(j = 0; j < n; j++)
+      if(rtt[i][j] >= 0 || band[i][j] >= 0)
+	fprintf(fp, "%d %d %.3f %.3f\n", i, j, rtt[i][j], band[i][j]);
+  fclose(fp);
+}
+
+/* topology inferred from a matrix file of xml_topology_write_matrix() */
+xml_topology_t
+xml_topology_infer_file(const char* filename){
+  FILE *fp = std_fopen(filename, "r");
+  char name[XML_PARSER_BUFF_SIZE];
+  char** hostnames;
+  float **rtt, **band, r, b;
+  xml_topology_t top;
+  int n, i, j, idx;
+
+  if(fscanf(fp, "%d", &n) != 1 || n <= 0){
+    fprintf(stderr, "xml_topology_infer_file: %s: no host count\n", filename);
+    exit(1);
+  }
+
+  hostnames = (char**) std_malloc(sizeof(char*) * n);
+  rtt = (float**) std_malloc(sizeof(float*) * n);
+  band = (float**) std_malloc(sizeof(float*) * n);
+  for(i = 0; i < n; i++){
+    if(fscanf(fp, "%d %1023s", &idx, name) != 2 || idx != i){
+      fprintf(stderr, "xml_topology_infer_file: %s: bad hostname of %d\n", filename, i);
+      exit(1);
+    }
+    hostnames[i] = (char*) std_malloc(strlen(name) + 1);
+    strcpy(hostnames[i], name);
+    rtt[i] = (float*) std_malloc(sizeof(float) * n);
+    band[i] = (float*) std_malloc(sizeof(float) * n);
+    for(j = 0; j < n; j++)
+      rtt[i][j] = band[i][j] = -1.0;
+  }
+  while(fscanf(fp, "%d %d %f %f", &i, &j, &r, &b) == 4){
+    if(i < 0 || i >= n || j < 0 || j >= n)
+      continue;
+    rtt[i][j] = r;
+    band[i][j] = b;
+  }
+  fclose(fp);
+
+  top = xml_topology_infer((const char**)hostnames, n, rtt, band);
+
+  for(i = 0; i < n; i++){
+    std_free(hostnames[i]);
+    std_free(rtt[i]);
+    std_free(band[i]);
+  }
+  std_free(hostnames);
+  std_free(rtt);
+  std_free(band);
+  return top;
+}
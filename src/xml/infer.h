@@ -0,0 +1,13 @@
+#ifndef __XML_INFER_H__
+#define __XML_INFER_H__
+
+#include "topology.h"
+
+#define XML_TOPOLOGY_INFER_RATIO (1.5) // a merge at most this times lower than the switch above it joins that switch
+
+xml_topology_t xml_topology_infer(const char** hostnames, int n, float** rtt, float** band);
+void xml_topology_write(xml_topology_t top, const char* filename);
+void xml_topology_write_matrix(const char* filename, const char** hostnames, int n, float** rtt, float** band);
+xml_topology_t xml_topology_infer_file(const char* filename);
+
+#endif // __XML_INFER_H__
@@ -6,6 +6,7 @@
 
 #include <std/std.h>
 #include "xml/parser.h"
+#include "xml/infer.h"
 
 xml_topology_parser_t
 xml_topology_parser_create(){
@@ -79,6 +80,8 @@ xml_topology_parser_endElem(void *userdata, const XML_Char *name){
   xml_top_node_vector_pop(parser -> node_stack);
 }
 
+/* topology of an XML file, or inferred from a matrix file of */
+/* xml_topology_write_matrix(), which starts with a number rather than a tag */
 xml_topology_t
 xml_topology_parser_run(xml_topology_parser_t parser, const char* filename){
   char buff[XML_PARSER_BUFF_SIZE];
@@ -86,7 +89,15 @@ xml_topology_parser_run(xml_topology_parser_t parser, const char* filename){
   int done = 0;
   int len;
   int stat;
-  xml_topology_t topology = xml_topology_create();
+  char c;
+  xml_topology_t topology;
+
+  if(fscanf(fp, " %c", &c) == 1 && c != '<'){
+    fclose(fp);
+    return xml_topology_infer_file(filename);
+  }
+  rewind(fp);
+  topology = xml_topology_create();
   
   /* setup parser */
   XML_Parser p = XML_ParserCreate(NULL);
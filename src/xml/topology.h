@@ -35,6 +35,7 @@ typedef struct xml_topology{
 xml_topology_t xml_topology_create();
 void xml_topology_destroy(xml_topology_t top);
 xml_top_node_t xml_topology_add_node(xml_topology_t top, const char* nodename, xml_top_node_t parent);
+xml_top_node_t xml_topology_get_node(xml_topology_t top, const char* nodename);
 xml_top_node_t xml_topology_add_edge(xml_topology_t top, const xml_top_node_t parent, const char* nodename, float len, float width);
 void xml_topology_randomize_edge_width(xml_topology_t top, int seed);
 int xml_topology_traverse(xml_topology_t top, const char* srcname, const char* dstname, xml_top_node_vector_t path, float *len, float *width);